@@ -29,9 +29,17 @@ extern "C" {
 
 #include "maa/pwm.h"
 #include "maa/aio.h"
+#include "maa/ring.h"
 #include "maa/gpio.h"
+#include "maa/loopback.h"
 #include "maa/spi.h"
 #include "maa/i2c.h"
+#include "maa/program.h"
+#include "maa/stats.h"
+#include "maa/trace.h"
+#include "maa/log.h"
+#include "maa/pool.h"
+#include "maa/client.h"
 
 #ifdef __cplusplus
 }
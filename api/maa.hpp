@@ -30,3 +30,4 @@
 #include "maa/gpio.hpp"
 #include "maa/i2c.hpp"
 #include "maa/spi.hpp"
+#include "maa/program.hpp"
@@ -43,6 +43,7 @@ extern "C" {
 
 #include "common.h"
 #include "gpio.h"
+#include "ring.h"
 
 #define ADC_RAW_RESOLUTION_BITS         (12)
 #define ADC_SUPPORTED_RESOLUTION_BITS   (10)
@@ -53,6 +54,15 @@ extern "C" {
  */
 typedef struct _aio* maa_aio_context;
 
+/**
+ * A sample as published by maa_aio_export()
+ */
+typedef struct {
+    struct timespec timestamp; /**< CLOCK_MONOTONIC time of the read */
+    uint16_t value; /**< as returned by maa_aio_read() */
+    uint16_t failed; /**< nonzero when the read failed and value means nothing */
+} maa_aio_sample_t;
+
 /**
  * Initialise an Analog input device, connected to the specified pin
  *
@@ -69,6 +79,27 @@ maa_aio_context maa_aio_init(unsigned int pin);
  */
 uint16_t maa_aio_read(maa_aio_context dev);
 
+/**
+ * Sample the input from a thread at a fixed interval and publish every
+ * sample to a ring, so other processes can share one acquisition. The ring
+ * must have maa_aio_sample_t sized records. Do not call maa_aio_read()
+ * while exporting.
+ *
+ * @param dev The AIO context
+ * @param ring ring created with maa_ring_create()
+ * @param interval_us microseconds between samples, at least 1
+ * @return Result of operation
+ */
+maa_result_t maa_aio_export(maa_aio_context dev, maa_ring_context ring, unsigned int interval_us);
+
+/**
+ * Stop the sampling thread started by maa_aio_export()
+ *
+ * @param dev The AIO context
+ * @return Result of operation
+ */
+maa_result_t maa_aio_export_stop(maa_aio_context dev);
+
 /**
  * Close the analog input context, this will free the memory for the context
  *
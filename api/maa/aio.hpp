@@ -25,6 +25,7 @@
 #pragma once
 
 #include "aio.h"
+#include "span.hpp"
 
 namespace maa {
 
@@ -50,8 +51,34 @@ class Aio {
          * Aio destructor
          */
         ~Aio() {
-            maa_aio_close(m_aio);
+            if (m_aio != NULL)
+                maa_aio_close(m_aio);
         }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a context
+         *
+         * @param other Aio to take the context from
+         */
+        Aio(Aio&& other) noexcept : m_aio(other.m_aio) {
+            other.m_aio = NULL;
+        }
+        /**
+         * Move assignment, closes our current context first
+         *
+         * @param other Aio to take the context from
+         * @return this object
+         */
+        Aio& operator=(Aio&& other) noexcept {
+            if (this != &other) {
+                if (m_aio != NULL)
+                    maa_aio_close(m_aio);
+                m_aio = other.m_aio;
+                other.m_aio = NULL;
+            }
+            return *this;
+        }
+#endif
         /**
          * Read a value from the AIO pin. Note this value can never be outside
          * of the bounds of an unsigned short
@@ -62,7 +89,24 @@ class Aio {
             // Use basic types to make swig code generation simpler
             return (int) maa_aio_read(m_aio);
         }
+#ifndef SWIG
+        /**
+         * Take consecutive samples into a caller provided buffer
+         *
+         * @param samples Buffer to fill, one sample per element
+         * @return number of samples taken
+         */
+        int read(Span<uint16_t> samples) {
+            size_t i;
+            for (i = 0; i < samples.size(); i++)
+                samples.data()[i] = maa_aio_read(m_aio);
+            return (int) i;
+        }
+#endif
     private:
+        // not copyable, two objects would close the same context
+        Aio(const Aio&);
+        Aio& operator=(const Aio&);
         maa_aio_context m_aio;
 };
 
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Client of the maad hardware broker
+ *
+ * When several unprivileged processes need the same hardware, the maad
+ * daemon can own every context and serve them over a unix socket. This API
+ * mirrors the gpio, aio, i2c and spi calls with a maa_client_ prefix, taking
+ * handles returned by the daemon instead of contexts. Calls made between
+ * maa_client_batch_begin() and maa_client_batch_flush() that return nothing
+ * but a result are queued and sent to the daemon as one message; calls that
+ * return data flush the batch first. Gpio interrupts are delivered through a
+ * ring shared with the daemon, see maa_client_gpio_events(), and analog
+ * inputs can be streamed through a ring, see maa_client_aio_stream(). Bus
+ * transactions always go over the socket.
+ *
+ * @snippet maad_client.c Interesting
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "common.h"
+#include "gpio.h"
+#include "ring.h"
+
+/**
+ * Opaque pointer definition to the internal struct _client
+ */
+typedef struct _client* maa_client_context;
+
+/**
+ * Connect to maad
+ *
+ * @param path socket of the daemon, NULL for the MAAD_SOCKET environment
+ * variable or /run/maad.sock
+ * @return client context or NULL
+ */
+maa_client_context maa_client_connect(const char* path);
+
+/**
+ * Disconnect, the daemon closes every handle of this client
+ *
+ * @param client The client context
+ * @return Result of operation
+ */
+maa_result_t maa_client_close(maa_client_context client);
+
+/**
+ * Start queueing calls instead of sending each one
+ *
+ * @param client The client context
+ * @return Result of operation
+ */
+maa_result_t maa_client_batch_begin(maa_client_context client);
+
+/**
+ * Send queued calls as one message and stop queueing
+ *
+ * @param client The client context
+ * @return MAA_SUCCESS or the first failure among the queued calls
+ */
+maa_result_t maa_client_batch_flush(maa_client_context client);
+
+/**
+ * Initialise a gpio in the daemon
+ *
+ * @param client The client context
+ * @param pin Pin number read from the board, i.e IO3 is 3
+ * @return handle or -1 on failure
+ */
+int maa_client_gpio_init(maa_client_context client, int pin);
+
+/**
+ * Set Gpio direction
+ *
+ * @param client The client context
+ * @param gpio Handle from maa_client_gpio_init()
+ * @param dir The direction of the Gpio
+ * @return Result of operation
+ */
+maa_result_t maa_client_gpio_dir(maa_client_context client, int gpio, gpio_dir_t dir);
+
+/**
+ * Read the Gpio value
+ *
+ * @param client The client context
+ * @param gpio Handle from maa_client_gpio_init()
+ * @return Gpio value or -1 on failure
+ */
+int maa_client_gpio_read(maa_client_context client, int gpio);
+
+/**
+ * Write to the Gpio value
+ *
+ * @param client The client context
+ * @param gpio Handle from maa_client_gpio_init()
+ * @param value Integer value to write
+ * @return Result of operation
+ */
+maa_result_t maa_client_gpio_write(maa_client_context client, int gpio, int value);
+
+/**
+ * Have the daemon report edges of the Gpio in the event ring
+ *
+ * @param client The client context
+ * @param gpio Handle from maa_client_gpio_init()
+ * @param edge The edge mode to set the gpio into
+ * @return Result of operation
+ */
+maa_result_t maa_client_gpio_isr(maa_client_context client, int gpio, gpio_edge_t edge);
+
+/**
+ * Take pending gpio events out of the ring without blocking. The index of
+ * each event is the handle of the gpio.
+ *
+ * @param client The client context
+ * @param events filled with up to max events
+ * @param max size of events
+ * @return number of events taken, -1 if no isr was set
+ */
+int maa_client_gpio_events(maa_client_context client, maa_gpio_event_t* events, int max);
+
+/**
+ * File descriptor that becomes readable when events are pushed to the ring,
+ * for use with poll(). Read 8 bytes from it to clear it.
+ *
+ * @param client The client context
+ * @return eventfd or -1 if no isr was set
+ */
+int maa_client_gpio_event_fd(maa_client_context client);
+
+/**
+ * Close a Gpio handle
+ *
+ * @param client The client context
+ * @param gpio Handle from maa_client_gpio_init()
+ * @return Result of operation
+ */
+maa_result_t maa_client_gpio_close(maa_client_context client, int gpio);
+
+/**
+ * Initialise an analog input in the daemon
+ *
+ * @param client The client context
+ * @param channel Analog input channel
+ * @return handle or -1 on failure
+ */
+int maa_client_aio_init(maa_client_context client, unsigned int channel);
+
+/**
+ * Read an analog input
+ *
+ * @param client The client context
+ * @param aio Handle from maa_client_aio_init()
+ * @return sample, 0 on failure
+ */
+uint16_t maa_client_aio_read(maa_client_context client, int aio);
+
+/**
+ * Have the daemon sample an analog input at a fixed interval into a ring
+ * shared with every client, see maa_aio_export(). maa_client_aio_read() fails
+ * on the handle while it streams.
+ *
+ * @param client The client context
+ * @param aio Handle from maa_client_aio_init()
+ * @param interval_us microseconds between samples
+ * @return ring of maa_aio_sample_t attached as a reader, close it with
+ * maa_ring_close(), or NULL on failure
+ */
+maa_ring_context maa_client_aio_stream(maa_client_context client, int aio, unsigned int interval_us);
+
+/**
+ * Close an analog input handle
+ *
+ * @param client The client context
+ * @param aio Handle from maa_client_aio_init()
+ * @return Result of operation
+ */
+maa_result_t maa_client_aio_close(maa_client_context client, int aio);
+
+/**
+ * Initialise an i2c bus in the daemon
+ *
+ * @param client The client context
+ * @param bus Bus to use, as listed in the platform definition
+ * @return handle or -1 on failure
+ */
+int maa_client_i2c_init(maa_client_context client, int bus);
+
+/**
+ * Set the slave address
+ *
+ * @param client The client context
+ * @param i2c Handle from maa_client_i2c_init()
+ * @param address The address of the slave
+ * @return Result of operation
+ */
+maa_result_t maa_client_i2c_address(maa_client_context client, int i2c, int address);
+
+/**
+ * Read from the slave
+ *
+ * @param client The client context
+ * @param i2c Handle from maa_client_i2c_init()
+ * @param data Buffer to fill
+ * @param length Bytes to read, at most 256
+ * @return length of the read or 0 if failed
+ */
+int maa_client_i2c_read(maa_client_context client, int i2c, uint8_t* data, int length);
+
+/**
+ * Write to the slave
+ *
+ * @param client The client context
+ * @param i2c Handle from maa_client_i2c_init()
+ * @param data Buffer to write
+ * @param length Bytes to write, at most 256
+ * @return Result of operation
+ */
+maa_result_t maa_client_i2c_write(maa_client_context client, int i2c, const uint8_t* data, int length);
+
+/**
+ * Close an i2c handle
+ *
+ * @param client The client context
+ * @param i2c Handle from maa_client_i2c_init()
+ * @return Result of operation
+ */
+maa_result_t maa_client_i2c_close(maa_client_context client, int i2c);
+
+/**
+ * Initialise an spi bus in the daemon
+ *
+ * @param client The client context
+ * @param bus Bus to use, as listed in the platform definition
+ * @return handle or -1 on failure
+ */
+int maa_client_spi_init(maa_client_context client, int bus);
+
+/**
+ * Transfer a buffer, receiving into rxbuf
+ *
+ * @param client The client context
+ * @param spi Handle from maa_client_spi_init()
+ * @param data Buffer to send
+ * @param rxbuf Buffer receiving length bytes
+ * @param length Bytes to transfer, at most 256
+ * @return Result of operation
+ */
+maa_result_t maa_client_spi_transfer(maa_client_context client, int spi, const uint8_t* data, uint8_t* rxbuf, int length);
+
+/**
+ * Close an spi handle
+ *
+ * @param client The client context
+ * @param spi Handle from maa_client_spi_init()
+ * @return Result of operation
+ */
+maa_result_t maa_client_spi_close(maa_client_context client, int spi);
+
+#ifdef __cplusplus
+}
+#endif
@@ -193,6 +193,46 @@ maa_result_t maa_init();
  */
 maa_boolean_t maa_pin_mode_test(int pin, maa_pinmodes_t mode);
 
+/**
+ * Check what a pin is currently used for by this process. A pin can be held
+ * by several contexts of the same kind but inits that would use it for
+ * another function fail until they are closed.
+ *
+ * @param pin Physical Pin to be checked.
+ * @param mode set to the function the pin is used for, when in use
+ * @return number of open contexts using the pin, 0 when free, -1 when the pin
+ * is invalid
+ */
+int maa_pin_claims(int pin, maa_pinmodes_t* mode);
+
+/**
+ * Keep pin claims, mux state, bus locks and gpio shadows in a shared memory
+ * segment so that processes using libmaa at the same time see each other's
+ * setup and serialise bus transactions. The segment is created by the first
+ * process and only needs the same name in the others. Setting the MAA_SHM
+ * environment variable attaches to the segment it names during maa_init().
+ * Claims of a process that crashes stay in the segment until it is removed.
+ * A new segment gets mode 0660, or the octal mode in MAA_SHM_MODE, and the
+ * group named or numbered by MAA_SHM_GROUP when set, so only processes of
+ * that group can attach. While attached every i2c and spi transfer holds its
+ * bus lock.
+ *
+ * @param name shm_open() name such as "/maa", NULL or "" for the default
+ * @return Result of operation, must be called before any pin is used
+ */
+maa_result_t maa_shm_attach(const char* name);
+
+/**
+ * Resolve every sysfs and /dev path under another directory, so libmaa can
+ * run against a simulated device tree for testing and benchmarking. The
+ * MAA_SYSFS_ROOT environment variable sets it during maa_init(). Mux lines
+ * set up under the previous root are forgotten.
+ *
+ * @param root directory standing in for /, NULL or "" for the real one
+ * @return Result of operation, must be called before any context is opened
+ */
+maa_result_t maa_set_sysfs_root(const char* root);
+
 #ifdef __cplusplus
 }
 #endif
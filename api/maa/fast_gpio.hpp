@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "gpio.hpp"
+
+namespace maa {
+
+/**
+ * Compile time board descriptions used by FastGpio. Each board lists its
+ * memory mapped gpio pins as specialisations of Board::pin, pins without a
+ * specialisation are not memory mapped and are rejected at compile time.
+ * These tables must match the runtime ones in src/intel_galileo_*.c.
+ */
+namespace board {
+
+/**
+ * A list of multiplexer gpios and the value each one has to be set to,
+ * applied in order
+ */
+template <unsigned int... PinValues>
+struct Mux;
+
+template <>
+struct Mux<> {
+    enum { total = 0 };
+    static bool apply() {
+        return true;
+    }
+};
+
+template <unsigned int MuxPin, unsigned int MuxValue, unsigned int... Rest>
+struct Mux<MuxPin, MuxValue, Rest...> {
+    enum { total = 1 + Mux<Rest...>::total };
+    static bool apply() {
+        maa_gpio_context mux = maa_gpio_init_raw(MuxPin);
+        if (mux == NULL)
+            return false;
+        // leave the mux exported and set when we go away
+        maa_gpio_owner(mux, 0);
+        bool ok = maa_gpio_dir(mux, MAA_GPIO_OUT) == MAA_SUCCESS &&
+                  maa_gpio_write(mux, MuxValue) == MAA_SUCCESS;
+        maa_gpio_close(mux);
+        return ok && Mux<Rest...>::apply();
+    }
+};
+
+/**
+ * Intel Galileo Gen 1 (Rev D), fast gpio lives on the Quark SoC gpio block
+ * exposed through /dev/uio0
+ */
+struct GalileoGen1 {
+    static const char* memDev() {
+        return "/dev/uio0";
+    }
+    enum { mem_sz = 0x1000 };
+
+    template <int Pin>
+    struct pin;
+};
+
+template <>
+struct GalileoGen1::pin<2> {
+    enum { pinmap = 14, reg_offset = 0, bit_pos = 6 };
+    typedef Mux<31, 0, 14, 0> mux;
+};
+
+template <>
+struct GalileoGen1::pin<3> {
+    enum { pinmap = 15, reg_offset = 0, bit_pos = 7 };
+    typedef Mux<30, 0, 15, 0> mux;
+};
+
+}
+
+/**
+ * @brief Zero overhead access to a memory mapped gpio
+ *
+ * Pinmap, muxes, register offset and bit are resolved at compile time from
+ * the board tables in maa::board so write() and read() inline to a masked
+ * access of the gpio register, with no call into libmaa and no runtime
+ * check. Only pins the board memory maps can be instantiated. Register
+ * updates are atomic as the register is shared with other pins.
+ *
+ * @snippet FastGpio-toggle.cpp Interesting
+ */
+template <typename Board, int Pin>
+class FastGpio {
+        typedef typename Board::template pin<Pin> info;
+    public:
+        /** Bit of this pin in the gpio register */
+        static const uint32_t mask = 1u << info::bit_pos;
+
+        /**
+         * Set up the muxes and map the gpio register. Check valid() before
+         * use.
+         */
+        FastGpio() : m_base(MAP_FAILED), m_reg(NULL) {
+            m_gpio = maa_gpio_init_raw(info::pinmap);
+            if (m_gpio == NULL || !info::mux::apply())
+                return;
+            int fd = open(Board::memDev(), O_RDWR);
+            if (fd == -1)
+                return;
+            m_base = mmap(NULL, Board::mem_sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (m_base != MAP_FAILED)
+                m_reg = (volatile uint32_t*) ((char*) m_base + info::reg_offset);
+        }
+        /**
+         * Unmap the register, the pin is unexported if we exported it
+         */
+        ~FastGpio() {
+            if (m_base != MAP_FAILED)
+                munmap(m_base, Board::mem_sz);
+            if (m_gpio != NULL)
+                maa_gpio_close(m_gpio);
+        }
+        /**
+         * Whether the register could be mapped
+         *
+         * @return true if read() and write() can be used
+         */
+        bool valid() const {
+            return m_reg != NULL;
+        }
+        /**
+         * Change Gpio direction, goes through sysfs
+         *
+         * @param dir The direction to change the gpio into
+         * @return Result of operation
+         */
+        maa_result_t dir(Dir dir) {
+            return maa_gpio_dir(m_gpio, (gpio_dir_t) dir);
+        }
+        /**
+         * Write value to the gpio register
+         *
+         * @param value Value to write
+         */
+        void write(int value) {
+            if (value)
+                __sync_fetch_and_or(m_reg, mask);
+            else
+                __sync_fetch_and_and(m_reg, ~mask);
+        }
+        /**
+         * Set and clear several bits of the gpio register in one atomic
+         * update. Masks of other pins in the same register, such as
+         * FastGpio<Board, 3>::mask, can be combined.
+         *
+         * @param set mask of the pins to drive high
+         * @param clear mask of the pins to drive low
+         */
+        void update(uint32_t set, uint32_t clear) {
+            uint32_t old, val;
+            do {
+                old = *m_reg;
+                val = (old & ~clear) | set;
+            } while (__sync_val_compare_and_swap(m_reg, old, val) != old);
+        }
+        /**
+         * Read value from the gpio register
+         *
+         * @return Gpio value
+         */
+        int read() const {
+            return (*m_reg & mask) ? 1 : 0;
+        }
+    private:
+        FastGpio(const FastGpio&);
+        FastGpio& operator=(const FastGpio&);
+
+        maa_gpio_context m_gpio;
+        void* m_base;
+        volatile uint32_t* m_reg;
+};
+
+}
@@ -41,12 +41,9 @@
 extern "C" {
 #endif
 
-#ifdef SWIGPYTHON
-#include <Python.h>
-#endif
-
 #include <stdio.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "common.h"
 
@@ -55,6 +52,11 @@ extern "C" {
  */
 typedef struct _gpio* maa_gpio_context;
 
+/**
+ * Opaque pointer definition to the internal struct _gpio_multi
+ */
+typedef struct _gpio_multi* maa_gpio_multi_context;
+
 /**
  * Gpio Output modes
  */
@@ -83,9 +85,22 @@ typedef enum {
     MAA_GPIO_EDGE_FALLING = 3  /**< Interupt on falling only */
 } gpio_edge_t;
 
+/**
+ * How Gpio interrupts are delivered
+ */
+typedef enum {
+    MAA_GPIO_ISR_SYSFS = 0, /**< Thread per pin polling the sysfs value file */
+    MAA_GPIO_ISR_UIO   = 1, /**< Shared thread blocking on the uio device, mmaped pins only */
+    MAA_GPIO_ISR_BUSY_POLL = 2 /**< Thread spinning on the input register, mmaped pins only */
+} gpio_isr_mode_t;
+
 /**
  * Initialise gpio_context, based on board number
  *
+ * Every call returns a context of its own that has to be closed. When this
+ * process already has the pin set up as gpio the mux lines are reused as they
+ * are, only the export of the pin is checked again.
+ *
  *  @param pin Pin number read from the board, i.e IO3 is 3
  *  @returns gpio context or NULL
  */
@@ -120,9 +135,54 @@ maa_result_t maa_gpio_edge_mode(maa_gpio_context dev, gpio_edge_t mode);
  */
 maa_result_t maa_gpio_isr(maa_gpio_context dev, gpio_edge_t edge, void (*fptr)(void *), void * args);
 
+/**
+ * Edge reported to a maa_gpio_isr_multi() callback
+ */
+typedef struct {
+    unsigned int index; /**< index of the gpio in the registered array */
+    int pin; /**< pin of the gpio, as given to init or init_raw */
+    gpio_edge_t edge; /**< MAA_GPIO_EDGE_RISING or MAA_GPIO_EDGE_FALLING */
+    struct timespec timestamp; /**< CLOCK_MONOTONIC time the edge was seen */
+} maa_gpio_event_t;
+
+/**
+ * Callback type of maa_gpio_isr_multi()
+ */
+typedef void (*maa_gpio_multi_isr_t)(const maa_gpio_event_t* event, void* user);
+
+/**
+ * Set an interupt on several pins at once, with one callback and one thread
+ * waiting on all of them. The callback is given which pin saw which edge and
+ * when. Pins of the group cannot have their own isr and must stay open until
+ * maa_gpio_isr_multi_exit() is called.
+ *
+ * @snippet isr_buttons.c Interesting
+ *
+ * @param devs The Gpio contexts, the array is copied
+ * @param n Number of contexts
+ * @param edge The edge mode to set the gpios into
+ * @param cb Function called for every edge
+ * @param user Passed back to cb
+ * @return handle of the group or NULL on failure
+ */
+maa_gpio_multi_context maa_gpio_isr_multi(maa_gpio_context* devs, unsigned int n,
+                                          gpio_edge_t edge, maa_gpio_multi_isr_t cb,
+                                          void* user);
+
+/**
+ * Stop the interupt watcher of a group of Gpios, set their edge mode to
+ * MAA_GPIO_EDGE_NONE and free the group. When called from the callback the
+ * group is released as soon as the callback returns.
+ *
+ * @param multi The group returned by maa_gpio_isr_multi()
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_isr_multi_exit(maa_gpio_multi_context multi);
+
 /**
  * Stop the current interupt watcher on this Gpio, and set the Gpio edge mode
- * to MAA_GPIO_EDGE_NONE
+ * to MAA_GPIO_EDGE_NONE. Waits for an isr that is running to return, so the
+ * isr arguments can be freed afterwards. May be called from the isr itself.
  *
  * @param dev The Gpio context
  * @return Result of operation
@@ -191,6 +251,61 @@ maa_result_t maa_gpio_owner(maa_gpio_context dev, maa_boolean_t owner);
  */
 maa_result_t maa_gpio_use_mmaped(maa_gpio_context dev, maa_boolean_t mmap);
 
+/**
+ * Select how interrupts of this Gpio are delivered by maa_gpio_isr(). With
+ * MAA_GPIO_ISR_UIO the pin must have mmap enabled when maa_gpio_isr() is
+ * called; one thread then blocks on the uio device for all such pins, reads
+ * the interrupt status register and runs the callback of each pin that
+ * fired, bypassing gpiolib and sysfs. Callbacks of different pins are run
+ * one after the other on that thread.
+ *
+ * With MAA_GPIO_ISR_BUSY_POLL the pin must also be mmaped; a dedicated thread
+ * spins reading the input register and runs the callback when the level
+ * changes on the requested edge. This reacts within microseconds at the cost
+ * of a whole core, see maa_gpio_busy_poll_config().
+ *
+ * @param dev The Gpio context
+ * @param mode The delivery mode, cannot change while an isr is set
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_isr_mode(maa_gpio_context dev, gpio_isr_mode_t mode);
+
+/**
+ * Configure the busy poll thread used by MAA_GPIO_ISR_BUSY_POLL. Takes effect
+ * on the next maa_gpio_isr() call.
+ *
+ * @param dev The Gpio context
+ * @param cpu cpu to pin the thread to, ideally an isolated one, -1 to not pin
+ * @param yield_every number of polls between calls to sched_yield(), 0 to
+ * spin without ever yielding
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_busy_poll_config(maa_gpio_context dev, int cpu, unsigned int yield_every);
+
+/**
+ * Keep a cached level of an input up to date from its edge interrupt, reads
+ * then return the cached level instead of going through sysfs. Uses the isr
+ * thread of the context so it cannot be combined with maa_gpio_isr(), and
+ * maa_gpio_isr_exit() also stops the cache. Until the first level has been
+ * seen reads still go through sysfs.
+ *
+ * @param dev The Gpio context
+ * @param cache Enable the cache
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_input_cache(maa_gpio_context dev, maa_boolean_t cache);
+
+/**
+ * Keep a shadow of the last level written. Writes that would not change the
+ * level are then skipped and reads of an output are answered from the shadow
+ * without touching sysfs. Only enable it when nothing else drives the pin.
+ *
+ * @param dev The Gpio context
+ * @param shadow Enable the shadow
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_shadow(maa_gpio_context dev, maa_boolean_t shadow);
+
 #ifdef __cplusplus
 }
 #endif
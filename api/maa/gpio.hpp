@@ -58,6 +58,15 @@ typedef enum {
     EDGE_FALLING = 3  /**< Interupt on falling only */
 } Edge;
 
+/**
+ * Gpio interrupt delivery modes
+ */
+typedef enum {
+    ISR_SYSFS = 0, /**< Thread per pin polling the sysfs value file */
+    ISR_UIO   = 1, /**< Shared thread blocking on the uio device, mmaped pins only */
+    ISR_BUSY_POLL = 2 /**< Thread spinning on the input register, mmaped pins only */
+} IsrMode;
+
 /**
  * @brief C++ API to General Purpose IO
  *
@@ -80,6 +89,9 @@ class Gpio {
          * you so this may not always work as expected.
          */
         Gpio(int pin, bool owner=true, bool raw=false) {
+#if defined(SWIGPYTHON)
+            m_isr = NULL;
+#endif
             if (raw)
                 m_gpio = maa_gpio_init_raw(pin);
             else
@@ -92,8 +104,47 @@ class Gpio {
          * the owner
          */
         ~Gpio() {
-            maa_gpio_close(m_gpio);
+            if (m_gpio != NULL) {
+#if defined(SWIGPYTHON)
+                // closing joins the isr thread, which needs the GIL
+                isrExit();
+#endif
+                maa_gpio_close(m_gpio);
+            }
+        }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a context
+         *
+         * @param other Gpio to take the context from
+         */
+        Gpio(Gpio&& other) noexcept : m_gpio(other.m_gpio) {
+            other.m_gpio = NULL;
+#if defined(SWIGPYTHON)
+            m_isr = other.m_isr;
+            other.m_isr = NULL;
+#endif
         }
+        /**
+         * Move assignment, closes our current context first
+         *
+         * @param other Gpio to take the context from
+         * @return this object
+         */
+        Gpio& operator=(Gpio&& other) noexcept {
+            if (this != &other) {
+                if (m_gpio != NULL)
+                    maa_gpio_close(m_gpio);
+                m_gpio = other.m_gpio;
+                other.m_gpio = NULL;
+#if defined(SWIGPYTHON)
+                m_isr = other.m_isr;
+                other.m_isr = NULL;
+#endif
+            }
+            return *this;
+        }
+#endif
         /**
          * Set the edge mode for ISR
          *
@@ -105,7 +156,19 @@ class Gpio {
         }
 #if defined(SWIGPYTHON)
         maa_result_t isr(Edge mode, PyObject *pyfunc, PyObject* args) {
-            return maa_gpio_isr(m_gpio, (gpio_edge_t) mode, (void (*) (void *)) pyfunc, (void *) args);
+            if (m_isr != NULL)
+                return MAA_ERROR_NO_RESOURCES;
+            // one object holding both references, it does not move with us
+            PyObject* isr = Py_BuildValue("(OO)", pyfunc, args);
+            if (isr == NULL)
+                return MAA_ERROR_NO_RESOURCES;
+            maa_result_t ret = maa_gpio_isr(m_gpio, (gpio_edge_t) mode, pythonIsr, isr);
+            if (ret != MAA_SUCCESS) {
+                Py_DECREF(isr);
+                return ret;
+            }
+            m_isr = isr;
+            return ret;
         }
 #else
         /**
@@ -122,13 +185,44 @@ class Gpio {
         }
 #endif
         /**
-         * Exits callback - this call will not kill the isr thread imediatlu
-         * but only when it is out of it's critical section
+         * Select how interrupts are delivered, must be called before isr()
+         *
+         * @param mode The delivery mode
+         * @return Result of operation
+         */
+        maa_result_t isrMode(IsrMode mode) {
+            return maa_gpio_isr_mode(m_gpio, (gpio_isr_mode_t) mode);
+        }
+        /**
+         * Configure the thread used by ISR_BUSY_POLL, must be called before
+         * isr()
+         *
+         * @param cpu cpu to pin the thread to, -1 to not pin
+         * @param yieldEvery polls between sched_yield(), 0 to never yield
+         * @return Result of operation
+         */
+        maa_result_t busyPollConfig(int cpu, unsigned int yieldEvery=0) {
+            return maa_gpio_busy_poll_config(m_gpio, cpu, yieldEvery);
+        }
+        /**
+         * Exits callback - waits for a callback that is running to return,
+         * may be called from the callback itself
          *
          * @return Result of operation
          */
         maa_result_t isrExit() {
+#if defined(SWIGPYTHON)
+            maa_result_t ret;
+            // a running callback may be waiting for the GIL we hold
+            Py_BEGIN_ALLOW_THREADS
+            ret = maa_gpio_isr_exit(m_gpio);
+            Py_END_ALLOW_THREADS
+            Py_XDECREF(m_isr);
+            m_isr = NULL;
+            return ret;
+#else
             return maa_gpio_isr_exit(m_gpio);
+#endif
         }
         /**
          * Change Gpio mode
@@ -165,8 +259,69 @@ class Gpio {
         maa_result_t write(int value) {
             return maa_gpio_write(m_gpio, value);
         }
+        /**
+         * Keep the level of an input cached from its edge interrupt so
+         * reads do not go through sysfs. Cannot be used with isr()
+         *
+         * @param enable Use the cache
+         * @return Result of operation
+         */
+        maa_result_t inputCache(bool enable) {
+            return maa_gpio_input_cache(m_gpio, (maa_boolean_t) enable);
+        }
+        /**
+         * Enable use of memory mapped io instead of sysfs
+         *
+         * @param enable Use mmap
+         * @return Result of operation
+         */
+        maa_result_t useMmaped(bool enable) {
+            return maa_gpio_use_mmaped(m_gpio, (maa_boolean_t) enable);
+        }
+        /**
+         * Keep a shadow of the last written level, skipping writes that
+         * would not change it and answering reads of outputs from it
+         *
+         * @param enable Use the shadow
+         * @return Result of operation
+         */
+        maa_result_t shadow(bool enable) {
+            return maa_gpio_shadow(m_gpio, (maa_boolean_t) enable);
+        }
     private:
+        // not copyable, two objects would close the same context
+        Gpio(const Gpio&);
+        Gpio& operator=(const Gpio&);
+        friend class Program;
         maa_gpio_context m_gpio;
+#if defined(SWIGPYTHON)
+        /*
+         * Python callbacks run on the isr thread and need the GIL
+         * (Global Interpreter Lock) before touching any python object
+         */
+        static void pythonIsr(void* arg) {
+            PyGILState_STATE gilstate = PyGILState_Ensure();
+            PyObject* isr = (PyObject*) arg;
+            // the callback may call isrExit() and drop our reference
+            Py_INCREF(isr);
+            PyObject* arglist = Py_BuildValue("(O)", PyTuple_GET_ITEM(isr, 1));
+            if (arglist == NULL) {
+                fprintf(stdout, "Py_BuildValue NULL\n");
+            } else {
+                PyObject* ret = PyObject_CallObject(PyTuple_GET_ITEM(isr, 0), arglist);
+                if (ret == NULL) {
+                    fprintf(stdout, "PyEval_CallObject failed\n");
+                    PyErr_Print();
+                } else {
+                    Py_DECREF(ret);
+                }
+                Py_DECREF(arglist);
+            }
+            Py_DECREF(isr);
+            PyGILState_Release(gilstate);
+        }
+        PyObject* m_isr; /**< (callback, args) while an isr is set */
+#endif
 };
 
 }
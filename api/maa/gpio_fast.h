@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Inline fast path for memory mapped Gpio
+ *
+ * Optional header for tight loops on memory mapped pins. Once a context has
+ * been switched to mmap with maa_gpio_use_mmaped() the register pointer and
+ * bitmask can be fetched once, after which the helpers below compile down to
+ * a single load/store without a call into the library or the mmap check
+ * maa_gpio_write() does on every call. The handle stays valid until mmap is
+ * disabled or the context is closed.
+ *
+ * The gpio register is shared by several pins and the Quark SoC has no set
+ * or clear registers, so every update is an atomic read-modify-write and
+ * threads driving different pins of the same register do not lose each
+ * other's writes. All mmaped contexts share one mapping, so pins in the same
+ * register get the same reg pointer and their masks can be combined with
+ * maa_gpio_fast_update().
+ *
+ * @snippet mmap-io2.c Interesting
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "gpio.h"
+
+/**
+ * Register and bit of a memory mapped gpio
+ */
+typedef struct {
+    volatile uint32_t* reg; /**< data register the pin lives in */
+    uint32_t mask; /**< bit of the pin in reg */
+} maa_gpio_fast_t;
+
+/**
+ * Get the register pointer and bitmask of a memory mapped gpio
+ *
+ * @param dev The Gpio context, mmap must be enabled
+ * @param fast filled with the register and mask of the pin
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_get_fast(maa_gpio_context dev, maa_gpio_fast_t* fast);
+
+/**
+ * Drive the pin high
+ *
+ * @param fast handle from maa_gpio_get_fast()
+ */
+static inline void
+maa_gpio_fast_set(const maa_gpio_fast_t* fast)
+{
+    __sync_fetch_and_or(fast->reg, fast->mask);
+}
+
+/**
+ * Drive the pin low
+ *
+ * @param fast handle from maa_gpio_get_fast()
+ */
+static inline void
+maa_gpio_fast_clear(const maa_gpio_fast_t* fast)
+{
+    __sync_fetch_and_and(fast->reg, ~fast->mask);
+}
+
+/**
+ * Invert the level the pin is driven at
+ *
+ * @param fast handle from maa_gpio_get_fast()
+ */
+static inline void
+maa_gpio_fast_toggle(const maa_gpio_fast_t* fast)
+{
+    __sync_fetch_and_xor(fast->reg, fast->mask);
+}
+
+/**
+ * Read the level the pin is driven at
+ *
+ * @param fast handle from maa_gpio_get_fast()
+ * @return 1 or 0
+ */
+static inline int
+maa_gpio_fast_read(const maa_gpio_fast_t* fast)
+{
+    return (*fast->reg & fast->mask) ? 1 : 0;
+}
+
+/**
+ * Set and clear several bits of a gpio register in one atomic update, bits
+ * in neither mask are left alone
+ *
+ * @param reg register of the pins, from maa_gpio_get_fast()
+ * @param set mask of the pins to drive high
+ * @param clear mask of the pins to drive low
+ */
+static inline void
+maa_gpio_fast_update(volatile uint32_t* reg, uint32_t set, uint32_t clear)
+{
+    uint32_t old, val;
+    do {
+        old = *reg;
+        val = (old & ~clear) | set;
+    } while (__sync_val_compare_and_swap(reg, old, val) != old);
+}
+
+#ifdef __cplusplus
+}
+#endif
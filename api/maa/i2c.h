@@ -127,6 +127,26 @@ maa_result_t maa_i2c_write_byte(maa_i2c_context dev, const uint8_t data);
  */
 maa_result_t maa_i2c_address(maa_i2c_context dev, int address);
 
+/**
+ * Take the bus for a transaction spanning several calls, such as setting
+ * the address then writing and reading a register. Other threads, and other
+ * processes when maa_shm_attach() is used, block in maa_i2c_lock() until
+ * maa_i2c_unlock(). With maa_shm_attach() each single transfer also holds
+ * the bus, so a transaction is only needed for sequences of calls.
+ *
+ * @param dev The i2c context
+ * @return Result of operation
+ */
+maa_result_t maa_i2c_lock(maa_i2c_context dev);
+
+/**
+ * Release the bus taken with maa_i2c_lock()
+ *
+ * @param dev The i2c context
+ * @return Result of operation
+ */
+maa_result_t maa_i2c_unlock(maa_i2c_context dev);
+
 /**
  * De-inits an maa_i2c_context device
  *
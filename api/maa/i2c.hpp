@@ -25,6 +25,7 @@
 #pragma once
 
 #include "i2c.h"
+#include "span.hpp"
 
 namespace maa {
 
@@ -57,8 +58,34 @@ class I2c {
          * slaves.
          */
         ~I2c() {
-            maa_i2c_stop(m_i2c);
+            if (m_i2c != NULL)
+                maa_i2c_stop(m_i2c);
         }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a context
+         *
+         * @param other I2c to take the context from
+         */
+        I2c(I2c&& other) noexcept : m_i2c(other.m_i2c) {
+            other.m_i2c = NULL;
+        }
+        /**
+         * Move assignment, closes our current context first
+         *
+         * @param other I2c to take the context from
+         * @return this object
+         */
+        I2c& operator=(I2c&& other) noexcept {
+            if (this != &other) {
+                if (m_i2c != NULL)
+                    maa_i2c_stop(m_i2c);
+                m_i2c = other.m_i2c;
+                other.m_i2c = NULL;
+            }
+            return *this;
+        }
+#endif
         /**
          * Sets the i2c Frequency for communication. Your board may not support
          * the set frequency. Anyone can change this at any time and this will
@@ -80,6 +107,22 @@ class I2c {
         maa_result_t address(int address) {
             return maa_i2c_address(m_i2c, address);
         }
+        /**
+         * Take the bus for a transaction spanning several calls
+         *
+         * @return Result of operation
+         */
+        maa_result_t lock() {
+            return maa_i2c_lock(m_i2c);
+        }
+        /**
+         * Release the bus taken with lock()
+         *
+         * @return Result of operation
+         */
+        maa_result_t unlock() {
+            return maa_i2c_unlock(m_i2c);
+        }
         /**
          * Read exactly one byte from the bus
          *
@@ -98,6 +141,26 @@ class I2c {
         int read(unsigned char * data, int length) {
             return maa_i2c_read(m_i2c, data, length);
         }
+#ifndef SWIG
+        /**
+         * Read from the bus into a caller provided buffer
+         *
+         * @param data Buffer to fill, its size is the length of the read
+         * @return length of the read or 0 if failed
+         */
+        int read(Span<uint8_t> data) {
+            return maa_i2c_read(m_i2c, data.data(), (int) data.size());
+        }
+        /**
+         * Write a caller provided buffer to the bus
+         *
+         * @param data Buffer to send
+         * @return Result of operation
+         */
+        maa_result_t write(Span<const uint8_t> data) {
+            return maa_i2c_write(m_i2c, data.data(), (int) data.size());
+        }
+#endif
         /**
          * Write one byte to the bus
          *
@@ -131,6 +194,10 @@ class I2c {
             return maa_i2c_write_byte(m_i2c, data);
         }
     private:
+        // not copyable, two objects would close the same context
+        I2c(const I2c&);
+        I2c& operator=(const I2c&);
+        friend class Program;
         maa_i2c_context m_i2c;
 };
 
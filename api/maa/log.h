@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Error reporting
+ *
+ * Failing calls record what went wrong in a per thread last error that
+ * stays until the next failure of that thread, see maa_last_error(). The
+ * record is filled without allocating or formatting anything. Messages
+ * are passed to a log sink, stderr by default, after being filtered by
+ * level and rate limited. A sensor that keeps failing cannot flood the
+ * log or slow down every call with console writes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+
+/**
+ * Severity of a log message
+ */
+typedef enum {
+    MAA_LOG_ERROR = 0, /**< an operation failed */
+    MAA_LOG_WARNING = 1, /**< an operation worked around a problem */
+    MAA_LOG_INFO = 2, /**< informational */
+    MAA_LOG_DEBUG = 3 /**< verbose detail */
+} maa_log_level_t;
+
+/**
+ * Last error of a thread
+ */
+typedef struct {
+    /*@{*/
+    maa_result_t code; /**< result returned by the failing call */
+    int sys_errno; /**< errno when the failure was recorded, 0 if none */
+    const char* function; /**< libmaa function that failed */
+    const char* message; /**< what failed, unformatted */
+    /*@}*/
+} maa_error_t;
+
+/**
+ * Receives log messages
+ *
+ * @param level severity of the message
+ * @param message the formatted message, valid during the call only
+ * @param user as given to maa_log_set_sink()
+ */
+typedef void (*maa_log_sink_t)(maa_log_level_t level, const char* message, void* user);
+
+/**
+ * Last failure recorded by the calling thread
+ *
+ * @return the record, code is MAA_SUCCESS if nothing failed yet
+ */
+const maa_error_t* maa_last_error();
+
+/**
+ * Forget the last failure of the calling thread
+ */
+void maa_clear_error();
+
+/**
+ * Send log messages to a function of the application instead of stderr
+ *
+ * @param sink function called for each message, NULL for stderr
+ * @param user passed to the sink
+ * @return Result of operation
+ */
+maa_result_t maa_log_set_sink(maa_log_sink_t sink, void* user);
+
+/**
+ * Drop messages less severe than level, MAA_LOG_ERROR by default
+ *
+ * @param level most verbose level passed to the sink
+ * @return Result of operation
+ */
+maa_result_t maa_log_set_level(maa_log_level_t level);
+
+/**
+ * Limit how many messages reach the sink each second, 10 by default. The
+ * number of messages dropped is appended to the next one that passes.
+ *
+ * @param per_second messages per second, 0 for no limit
+ * @return Result of operation
+ */
+maa_result_t maa_log_set_rate(unsigned int per_second);
+
+#ifdef __cplusplus
+}
+#endif
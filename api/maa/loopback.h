@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Gpio loopback latency measurement
+ *
+ * Drives a Gpio output wired to a Gpio input and measures the time from the
+ * write to the interrupt callback for each edge. The distribution comes back
+ * as a histogram together with percentiles and jitter. A simulated tree
+ * (see maa_set_sysfs_root()) can stand in for the hardware. The same isr
+ * paths are then driven through FIFOs and the mapped register file, so a
+ * board can be compared with what the library and the kernel alone cost.
+ *
+ * @snippet gpio_loopback.c Interesting
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "gpio.h"
+
+/** Buckets of a loopback histogram, the last one counts everything above */
+#define MAA_LOOPBACK_BUCKETS 64
+
+/**
+ * Latency distribution of a loopback run
+ */
+typedef struct {
+    /*@{*/
+    unsigned int samples; /**< edges whose callback was seen */
+    unsigned int missed; /**< edges without a callback within 100ms */
+    uint64_t min_ns; /**< fastest edge */
+    uint64_t max_ns; /**< slowest edge */
+    uint64_t mean_ns; /**< average latency */
+    uint64_t jitter_ns; /**< standard deviation of the latency */
+    uint64_t p50_ns; /**< median latency */
+    uint64_t p99_ns; /**< 99th percentile latency */
+    uint64_t p999_ns; /**< 99.9th percentile latency */
+    uint32_t bucket_ns; /**< width of a histogram bucket */
+    uint32_t histogram[MAA_LOOPBACK_BUCKETS]; /**< edges per bucket */
+    /*@}*/
+} maa_loopback_result_t;
+
+/**
+ * Measure edge to callback latency over a wire from out to in. The isr of
+ * in is set up in the given mode for the run and removed afterwards, mmap
+ * is enabled on in for the modes that need it.
+ *
+ * @param out output Gpio context
+ * @param in input Gpio context, wired to out
+ * @param mode isr delivery to measure
+ * @param samples edges to generate
+ * @param bucket_ns histogram bucket width, 0 for 1us
+ * @param result filled with the distribution
+ * @return Result of operation
+ */
+maa_result_t maa_gpio_loopback(maa_gpio_context out, maa_gpio_context in, gpio_isr_mode_t mode,
+                               unsigned int samples, unsigned int bucket_ns,
+                               maa_loopback_result_t* result);
+
+/**
+ * Same measurement on a pin of the simulated tree set with MAA_SYSFS_ROOT
+ * or maa_set_sysfs_root(). The isr of the pin is set up as usual. For sysfs
+ * its value file, and for uio the uio device, is replaced by a FIFO for the
+ * run. Edges are generated by writing levels or interrupt counts to the
+ * FIFO and, for uio and busy poll, by updating the mapped registers.
+ *
+ * @param pin board pin, uio and busy poll need one that can be mmaped
+ * @param mode isr delivery to measure
+ * @param samples edges to generate
+ * @param bucket_ns histogram bucket width, 0 for 1us
+ * @param result filled with the distribution
+ * @return Result of operation, MAA_ERROR_INVALID_RESOURCE without a
+ * simulated tree
+ */
+maa_result_t maa_gpio_loopback_sim(int pin, gpio_isr_mode_t mode, unsigned int samples,
+                                   unsigned int bucket_ns, maa_loopback_result_t* result);
+
+/**
+ * Print a result as a text histogram, skipping empty buckets
+ *
+ * @param result as returned by a loopback run
+ * @param out stream to print to
+ * @return Result of operation
+ */
+maa_result_t maa_loopback_print(const maa_loopback_result_t* result, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
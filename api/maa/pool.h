@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Preallocated context pools
+ *
+ * By default every maa_*_init() allocates its context on the heap and the
+ * matching close frees it. maa_pool_init() instead reserves a fixed number of
+ * contexts of each type in a single allocation at startup. From then on
+ * contexts are taken from and returned to the pool, and an init fails with
+ * MAA_ERROR_NO_RESOURCES once its type is used up, so the application's
+ * contexts are never allocated one by one.
+ *
+ * The pool only covers the contexts handed to the application. These still
+ * use the heap while a pool is in use:
+ * - contexts the library opens for itself: one per mux line, kept open from
+ *   the first pin that needs it, and a short-lived one in every
+ *   maa_pwm_init() of a pin that is also a gpio and every maa_gpio_dir() of
+ *   a Galileo Gen 2 pin with an output enable line
+ * - the table of mux lines, grown the first time each mux line is used
+ * - maa_gpio_isr() in MAA_GPIO_ISR_BUSY_POLL mode, once per isr started
+ * - maa_gpio_isr_multi(), once per call
+ * - maa_spi_write_buf(), which returns a buffer the caller frees. Use
+ *   maa_spi_transfer_buf() with a preallocated receive buffer instead.
+ * - the node.js binding, whose async calls take their request from a few
+ *   spares kept per object and allocate when those are in use
+ *
+ * Apart from those, opening and closing contexts and transferring data do
+ * not allocate once each mux line has been used.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+
+/**
+ * Context types held by the pool
+ */
+typedef enum {
+    MAA_POOL_GPIO = 0, /**< maa_gpio_context */
+    MAA_POOL_PWM = 1, /**< maa_pwm_context */
+    MAA_POOL_AIO = 2, /**< maa_aio_context */
+    MAA_POOL_I2C = 3, /**< maa_i2c_context */
+    MAA_POOL_SPI = 4, /**< maa_spi_context */
+    MAA_POOL_TYPES = 5 /**< number of context types */
+} maa_pool_type_t;
+
+/**
+ * Contexts to reserve per type
+ */
+typedef struct {
+    /*@{*/
+    unsigned int count[MAA_POOL_TYPES]; /**< contexts per maa_pool_type_t */
+    /*@}*/
+} maa_pool_config_t;
+
+/**
+ * Reserve the contexts, call before opening any context. Types given a
+ * count of 0 cannot be opened while the pool is in use.
+ *
+ * @param config contexts to reserve per type
+ * @return Result of operation, MAA_ERROR_INVALID_RESOURCE if a pool is
+ * already in use
+ */
+maa_result_t maa_pool_init(const maa_pool_config_t* config);
+
+/**
+ * Contexts of a type that can still be opened from the pool
+ *
+ * @param type the context type
+ * @return free contexts, 0 when no pool is in use
+ */
+unsigned int maa_pool_available(maa_pool_type_t type);
+
+/**
+ * Free the pool and go back to heap allocated contexts
+ *
+ * @return Result of operation, MAA_ERROR_INVALID_RESOURCE while contexts
+ * taken from the pool are still open
+ */
+maa_result_t maa_pool_release();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief I/O programs
+ *
+ * An I/O program is a list of primitive operations (gpio write/read, waits,
+ * spi and i2c transfers, loops and branches on the last value read) that is
+ * built once and then executed entirely in C on a dedicated thread. Anything
+ * read during execution is appended to a single result buffer. This lets
+ * bindings like python or javascript drive bit or byte level protocols
+ * without paying interpreter overhead on every operation.
+ *
+ * @snippet program_pulse.c Interesting
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "common.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "spi.h"
+
+/**
+ * Maximum number of devices of each type a program can refer to
+ */
+#define MAA_PROGRAM_MAX_DEVICES 16
+
+/**
+ * Opaque pointer definition to the internal struct _program
+ */
+typedef struct _program* maa_program_context;
+
+/**
+ * Create a new, empty, I/O program
+ *
+ * @return program context or NULL
+ */
+maa_program_context maa_program_init();
+
+/**
+ * Register a gpio with the program, the context must outlive the program
+ *
+ * @param prog The program context
+ * @param dev The Gpio context
+ * @return slot to use for gpio operations or -1 on error
+ */
+int maa_program_add_gpio(maa_program_context prog, maa_gpio_context dev);
+
+/**
+ * Register a spi device with the program, the context must outlive the program
+ *
+ * @param prog The program context
+ * @param dev The Spi context
+ * @return slot to use for spi operations or -1 on error
+ */
+int maa_program_add_spi(maa_program_context prog, maa_spi_context dev);
+
+/**
+ * Register an i2c device with the program, the context must outlive the
+ * program. The slave address has to be set on the context beforehand.
+ *
+ * @param prog The program context
+ * @param dev The i2c context
+ * @return slot to use for i2c operations or -1 on error
+ */
+int maa_program_add_i2c(maa_program_context prog, maa_i2c_context dev);
+
+/**
+ * Index the next appended operation will get, use it as target for loops
+ * and branches
+ *
+ * @param prog The program context
+ * @return number of operations in the program
+ */
+int maa_program_size(maa_program_context prog);
+
+/**
+ * Append a gpio write
+ *
+ * @param prog The program context
+ * @param slot Gpio slot as returned by maa_program_add_gpio()
+ * @param value Value to write
+ * @return Result of operation
+ */
+maa_result_t maa_program_gpio_write(maa_program_context prog, int slot, int value);
+
+/**
+ * Append a gpio read, the value read is appended to the results as one byte
+ *
+ * @param prog The program context
+ * @param slot Gpio slot as returned by maa_program_add_gpio()
+ * @return Result of operation
+ */
+maa_result_t maa_program_gpio_read(maa_program_context prog, int slot);
+
+/**
+ * Append a wait. Short waits are busy waited to keep timing accurate.
+ *
+ * @param prog The program context
+ * @param us Microseconds to wait
+ * @return Result of operation
+ */
+maa_result_t maa_program_wait_us(maa_program_context prog, unsigned int us);
+
+/**
+ * Append a spi transfer, the bytes received are appended to the results
+ *
+ * @param prog The program context
+ * @param slot Spi slot as returned by maa_program_add_spi()
+ * @param data Bytes to send, copied into the program
+ * @param length Number of bytes to send
+ * @return Result of operation
+ */
+maa_result_t maa_program_spi_transfer(maa_program_context prog, int slot, const uint8_t* data, int length);
+
+/**
+ * Append an i2c write
+ *
+ * @param prog The program context
+ * @param slot i2c slot as returned by maa_program_add_i2c()
+ * @param data Bytes to send, copied into the program
+ * @param length Number of bytes to send
+ * @return Result of operation
+ */
+maa_result_t maa_program_i2c_write(maa_program_context prog, int slot, const uint8_t* data, int length);
+
+/**
+ * Append an i2c read, the bytes read are appended to the results
+ *
+ * @param prog The program context
+ * @param slot i2c slot as returned by maa_program_add_i2c()
+ * @param length Number of bytes to read
+ * @return Result of operation
+ */
+maa_result_t maa_program_i2c_read(maa_program_context prog, int slot, int length);
+
+/**
+ * Append a loop, execution jumps back to target until the operations from
+ * target up to this one have run count times in total
+ *
+ * @param prog The program context
+ * @param target Index of the first operation of the loop body
+ * @param count Total number of times the loop body is executed
+ * @return Result of operation
+ */
+maa_result_t maa_program_loop(maa_program_context prog, int target, unsigned int count);
+
+/**
+ * Append a conditional branch, execution jumps to target if the last value
+ * read (gpio level or last byte of a transfer) equals value
+ *
+ * @param prog The program context
+ * @param target Index of the operation to jump to
+ * @param value Value to compare the last read value with
+ * @return Result of operation
+ */
+maa_result_t maa_program_branch(maa_program_context prog, int target, int value);
+
+/**
+ * Execute the program on a dedicated thread and wait for it to finish.
+ * Previous results are discarded.
+ *
+ * @param prog The program context
+ * @param priority SCHED_FIFO priority of the thread, 0 to inherit the
+ * scheduling policy of the caller
+ * @return Result of operation, execution stops at the first failing operation.
+ * MAA_ERROR_NO_RESOURCES when a branch jumping backwards made the program
+ * read more than the result buffer sized while it was built.
+ */
+maa_result_t maa_program_run(maa_program_context prog, unsigned int priority);
+
+/**
+ * Get the results of the last run
+ *
+ * @param prog The program context
+ * @param length Set to the number of bytes in the result buffer
+ * @return the result buffer, owned by the program
+ */
+const uint8_t* maa_program_results(maa_program_context prog, int* length);
+
+/**
+ * Free the program, registered contexts are left untouched
+ *
+ * @param prog The program context
+ * @return Result of operation
+ */
+maa_result_t maa_program_close(maa_program_context prog);
+
+#ifdef __cplusplus
+}
+#endif
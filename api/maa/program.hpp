@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "program.h"
+#include "gpio.hpp"
+#include "spi.hpp"
+#include "i2c.hpp"
+
+namespace maa {
+
+/**
+ * @brief C++ API to I/O programs
+ *
+ * Build a list of operations once and run it natively, see program.h for
+ * details on the semantics of each operation.
+ *
+ * @snippet Program-pulse.cpp Interesting
+ */
+class Program {
+    public:
+        /**
+         * Create an empty program
+         */
+        Program() {
+            m_prog = maa_program_init();
+        }
+        /**
+         * Free the program, registered devices are left untouched
+         */
+        ~Program() {
+            if (m_prog != NULL)
+                maa_program_close(m_prog);
+        }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a program
+         *
+         * @param other Program to take the program from
+         */
+        Program(Program&& other) noexcept : m_prog(other.m_prog) {
+            other.m_prog = NULL;
+        }
+        /**
+         * Move assignment, closes our current program first
+         *
+         * @param other Program to take the program from
+         * @return this object
+         */
+        Program& operator=(Program&& other) noexcept {
+            if (this != &other) {
+                if (m_prog != NULL)
+                    maa_program_close(m_prog);
+                m_prog = other.m_prog;
+                other.m_prog = NULL;
+            }
+            return *this;
+        }
+#endif
+        /**
+         * Register a Gpio, it must outlive the program
+         *
+         * @param gpio Gpio to use in the program
+         * @return slot to use for gpio operations or -1
+         */
+        int addGpio(Gpio& gpio) {
+            return maa_program_add_gpio(m_prog, gpio.m_gpio);
+        }
+        /**
+         * Register a Spi device, it must outlive the program
+         *
+         * @param spi Spi device to use in the program
+         * @return slot to use for spi operations or -1
+         */
+        int addSpi(Spi& spi) {
+            return maa_program_add_spi(m_prog, spi.m_spi);
+        }
+        /**
+         * Register an I2c device, it must outlive the program
+         *
+         * @param i2c I2c device to use in the program, address already set
+         * @return slot to use for i2c operations or -1
+         */
+        int addI2c(I2c& i2c) {
+            return maa_program_add_i2c(m_prog, i2c.m_i2c);
+        }
+        /**
+         * Index of the next operation, use it as loop or branch target
+         *
+         * @return number of operations in the program
+         */
+        int size() {
+            return maa_program_size(m_prog);
+        }
+        /**
+         * Append a gpio write
+         *
+         * @param slot Gpio slot
+         * @param value Value to write
+         * @return Result of operation
+         */
+        maa_result_t gpioWrite(int slot, int value) {
+            return maa_program_gpio_write(m_prog, slot, value);
+        }
+        /**
+         * Append a gpio read, adds one byte to the results
+         *
+         * @param slot Gpio slot
+         * @return Result of operation
+         */
+        maa_result_t gpioRead(int slot) {
+            return maa_program_gpio_read(m_prog, slot);
+        }
+        /**
+         * Append a wait
+         *
+         * @param us Microseconds to wait
+         * @return Result of operation
+         */
+        maa_result_t waitUs(unsigned int us) {
+            return maa_program_wait_us(m_prog, us);
+        }
+        /**
+         * Append a spi transfer, adds length bytes to the results
+         *
+         * @param slot Spi slot
+         * @param data Bytes to send
+         * @param length Number of bytes to send
+         * @return Result of operation
+         */
+        maa_result_t spiTransfer(int slot, const uint8_t* data, int length) {
+            return maa_program_spi_transfer(m_prog, slot, data, length);
+        }
+        /**
+         * Append an i2c write
+         *
+         * @param slot I2c slot
+         * @param data Bytes to send
+         * @param length Number of bytes to send
+         * @return Result of operation
+         */
+        maa_result_t i2cWrite(int slot, const uint8_t* data, int length) {
+            return maa_program_i2c_write(m_prog, slot, data, length);
+        }
+        /**
+         * Append an i2c read, adds length bytes to the results
+         *
+         * @param slot I2c slot
+         * @param length Number of bytes to read
+         * @return Result of operation
+         */
+        maa_result_t i2cRead(int slot, int length) {
+            return maa_program_i2c_read(m_prog, slot, length);
+        }
+        /**
+         * Append a loop running the operations from target up to here count
+         * times in total
+         *
+         * @param target First operation of the loop body
+         * @param count Total number of iterations
+         * @return Result of operation
+         */
+        maa_result_t loop(int target, unsigned int count) {
+            return maa_program_loop(m_prog, target, count);
+        }
+        /**
+         * Append a branch to target taken if the last value read equals value
+         *
+         * @param target Operation to jump to
+         * @param value Value to compare with
+         * @return Result of operation
+         */
+        maa_result_t branch(int target, int value) {
+            return maa_program_branch(m_prog, target, value);
+        }
+        /**
+         * Run the program on a dedicated thread and wait for completion
+         *
+         * @param priority SCHED_FIFO priority, 0 to inherit the caller's
+         * @return Result of operation
+         */
+        maa_result_t run(unsigned int priority=0) {
+            return maa_program_run(m_prog, priority);
+        }
+        /**
+         * Number of bytes produced by the last run
+         *
+         * @return size of the results
+         */
+        int resultLength() {
+            int length = 0;
+            maa_program_results(m_prog, &length);
+            return length;
+        }
+        /**
+         * Get one byte of the results of the last run
+         *
+         * @param index Position in the results
+         * @return the byte or -1 if index is out of range
+         */
+        int result(int index) {
+            int length = 0;
+            const uint8_t* res = maa_program_results(m_prog, &length);
+            if (index < 0 || index >= length)
+                return -1;
+            return res[index];
+        }
+    private:
+        // not copyable, two objects would close the same program
+        Program(const Program&);
+        Program& operator=(const Program&);
+        maa_program_context m_prog;
+};
+
+}
@@ -58,8 +58,34 @@ class Pwm {
          * Pwm destructor
          */
         ~Pwm() {
-            maa_pwm_close(m_pwm);
+            if (m_pwm != NULL)
+                maa_pwm_close(m_pwm);
         }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a context
+         *
+         * @param other Pwm to take the context from
+         */
+        Pwm(Pwm&& other) noexcept : m_pwm(other.m_pwm) {
+            other.m_pwm = NULL;
+        }
+        /**
+         * Move assignment, closes our current context first
+         *
+         * @param other Pwm to take the context from
+         * @return this object
+         */
+        Pwm& operator=(Pwm&& other) noexcept {
+            if (this != &other) {
+                if (m_pwm != NULL)
+                    maa_pwm_close(m_pwm);
+                m_pwm = other.m_pwm;
+                other.m_pwm = NULL;
+            }
+            return *this;
+        }
+#endif
         /**
          * Set the output duty-cycle percentage, as a float
          *
@@ -151,6 +177,9 @@ class Pwm {
                 return maa_pwm_enable(m_pwm, 0);
         }
     private:
+        // not copyable, two objects would close the same context
+        Pwm(const Pwm&);
+        Pwm& operator=(const Pwm&);
         maa_pwm_context m_pwm;
 };
 
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Shared memory sample rings
+ *
+ * A ring lets one process acquire samples and any number of other processes
+ * read them. The producer creates a named ring in shared memory and
+ * publishes fixed size records into it, each tagged with a 32 bit sequence
+ * number that wraps around.
+ * Readers attach to the ring by name and copy records out without a system
+ * call per record. Every reader keeps its own position. A reader that falls
+ * more than a ring behind skips the overwritten records and they are counted
+ * as lost.
+ *
+ * Aio samples can be published with maa_aio_export(), and gpio events by
+ * passing maa_ring_gpio_event() to maa_gpio_isr_multi().
+ *
+ * @snippet ring_export.c Interesting
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "common.h"
+#include "gpio.h"
+
+/**
+ * Opaque pointer definition to the internal struct _ring
+ */
+typedef struct _ring* maa_ring_context;
+
+/**
+ * Create a named ring and become its producer. Fails with errno set to
+ * EEXIST when an object of that name already exists, a ring left behind by
+ * a producer that crashed must be removed with shm_unlink() first.
+ *
+ * @param name name of the shared memory object, starting with /
+ * @param record_size bytes in one record
+ * @param capacity records the ring holds, rounded up to a power of two
+ * @return ring context or NULL
+ */
+maa_ring_context maa_ring_create(const char* name, unsigned int record_size, unsigned int capacity);
+
+/**
+ * Attach to a ring created by another process as a reader. The reader
+ * starts at the oldest record still in the ring.
+ *
+ * @param name name the ring was created with
+ * @return ring context or NULL
+ */
+maa_ring_context maa_ring_attach(const char* name);
+
+/**
+ * Publish a record, only the producer may do so
+ *
+ * @param ring The ring context
+ * @param record record_size bytes to publish
+ * @return Result of operation
+ */
+maa_result_t maa_ring_publish(maa_ring_context ring, const void* record);
+
+/**
+ * Copy the records published since the last call into records. The records
+ * returned always have consecutive sequence numbers.
+ *
+ * @param ring The ring context
+ * @param records buffer for max records
+ * @param max records the buffer holds
+ * @param seq if not NULL, set to the sequence number of the first record
+ * @return records copied, -1 on error
+ */
+int maa_ring_read(maa_ring_context ring, void* records, int max, uint32_t* seq);
+
+/**
+ * Records this reader missed because the producer overwrote them
+ *
+ * @param ring The ring context
+ * @return records lost
+ */
+uint64_t maa_ring_lost(maa_ring_context ring);
+
+/**
+ * Size of the records of a ring
+ *
+ * @param ring The ring context
+ * @return bytes in one record
+ */
+unsigned int maa_ring_record_size(maa_ring_context ring);
+
+/**
+ * Callback for maa_gpio_isr_multi() publishing each event to the ring given
+ * as user data. The ring must have maa_gpio_event_t sized records.
+ *
+ * @param event the event
+ * @param ring The ring context
+ */
+void maa_ring_gpio_event(const maa_gpio_event_t* event, void* ring);
+
+/**
+ * Detach from the ring. The shared memory object is removed when its
+ * producer closes it, attached readers keep their mapping.
+ *
+ * @param ring The ring context
+ * @return Result of operation
+ */
+maa_result_t maa_ring_close(maa_ring_context ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace maa {
+
+/**
+ * @brief Non owning view of a caller provided buffer
+ *
+ * Used by the buffer APIs of the C++ classes so that reads and transfers go
+ * straight to and from memory the caller already owns. Can be built from a
+ * pointer and a size, a C array or any container with data() and size()
+ * such as std::vector or std::array.
+ */
+template <typename T>
+class Span {
+    public:
+        /**
+         * View size elements starting at data
+         *
+         * @param data first element
+         * @param size number of elements
+         */
+        Span(T* data, size_t size) : m_data(data), m_size(size) {}
+        /**
+         * View a whole C array
+         *
+         * @param arr the array
+         */
+        template <size_t N>
+        Span(T (&arr)[N]) : m_data(arr), m_size(N) {}
+        /**
+         * View a contiguous container
+         *
+         * @param c container providing data() and size()
+         */
+        template <typename Container>
+        Span(Container& c) : m_data(c.data()), m_size(c.size()) {}
+        /**
+         * @return pointer to the first element
+         */
+        T* data() const {
+            return m_data;
+        }
+        /**
+         * @return number of elements
+         */
+        size_t size() const {
+            return m_size;
+        }
+    private:
+        T* m_data;
+        size_t m_size;
+};
+
+}
@@ -91,6 +91,18 @@ uint8_t maa_spi_write(maa_spi_context dev, uint8_t data);
  */
 uint8_t* maa_spi_write_buf(maa_spi_context dev, uint8_t* data, int length);
 
+/** Transfer a buffer of bytes to the SPI device, receiving into a caller
+ * provided buffer. Nothing is allocated.
+ *
+ * @param dev The Spi context
+ * @param data to send
+ * @param rxbuf buffer receiving the data from the miso line, at least length
+ * bytes, may be the same as data
+ * @param length elements within buffer, Max 4096
+ * @return Result of operation
+ */
+maa_result_t maa_spi_transfer_buf(maa_spi_context dev, const uint8_t* data, uint8_t* rxbuf, int length);
+
 /**
  * Change the SPI lsb mode
  *
@@ -109,6 +121,25 @@ maa_result_t maa_spi_lsbmode(maa_spi_context dev, maa_boolean_t lsb);
  */
 maa_result_t maa_spi_bit_per_word(maa_spi_context dev, unsigned int bits);
 
+/**
+ * Take the bus for a transaction spanning several calls. Other threads, and
+ * other processes when maa_shm_attach() is used, block in maa_spi_lock()
+ * until maa_spi_unlock(). With maa_shm_attach() each single transfer also
+ * holds the bus, so a transaction is only needed for sequences of calls.
+ *
+ * @param dev The Spi context
+ * @return Result of operation
+ */
+maa_result_t maa_spi_lock(maa_spi_context dev);
+
+/**
+ * Release the bus taken with maa_spi_lock()
+ *
+ * @param dev The Spi context
+ * @return Result of operation
+ */
+maa_result_t maa_spi_unlock(maa_spi_context dev);
+
 /**
  * De-inits an maa_spi_context device
  *
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "spi.h"
+#include "span.hpp"
 
 namespace maa {
 
@@ -49,8 +50,34 @@ class Spi {
          * Closes spi bus
          */
         ~Spi() {
-            maa_spi_stop(m_spi);
+            if (m_spi != NULL)
+                maa_spi_stop(m_spi);
         }
+#if __cplusplus >= 201103L
+        /**
+         * Move constructor, other is left without a context
+         *
+         * @param other Spi to take the context from
+         */
+        Spi(Spi&& other) noexcept : m_spi(other.m_spi) {
+            other.m_spi = NULL;
+        }
+        /**
+         * Move assignment, closes our current context first
+         *
+         * @param other Spi to take the context from
+         * @return this object
+         */
+        Spi& operator=(Spi&& other) noexcept {
+            if (this != &other) {
+                if (m_spi != NULL)
+                    maa_spi_stop(m_spi);
+                m_spi = other.m_spi;
+                other.m_spi = NULL;
+            }
+            return *this;
+        }
+#endif
         /**
          * Set the SPI device mode. see spidev0-3
          *
@@ -88,6 +115,31 @@ class Spi {
         unsigned char* write(uint8_t* data, int length) {
             return (unsigned char*) maa_spi_write_buf(m_spi, data, length);
         }
+#ifndef SWIG
+        /**
+         * Transfer a buffer to the SPI device, receiving into a caller
+         * provided buffer. Nothing is allocated.
+         *
+         * @param tx buffer to send
+         * @param rx buffer receiving the miso line, at least as big as tx,
+         * may view the same memory as tx
+         * @return Result of operation
+         */
+        maa_result_t transfer(Span<const uint8_t> tx, Span<uint8_t> rx) {
+            if (rx.size() < tx.size())
+                return MAA_ERROR_INVALID_PARAMETER;
+            return maa_spi_transfer_buf(m_spi, tx.data(), rx.data(), (int) tx.size());
+        }
+        /**
+         * Transfer a buffer in place, what is received replaces what is sent
+         *
+         * @param buf buffer to send and receive into
+         * @return Result of operation
+         */
+        maa_result_t transfer(Span<uint8_t> buf) {
+            return maa_spi_transfer_buf(m_spi, buf.data(), buf.data(), (int) buf.size());
+        }
+#endif
         /**
          * Change the SPI lsb mode
          *
@@ -106,7 +158,28 @@ class Spi {
         maa_result_t bitPerWord(unsigned int bits) {
             return maa_spi_bit_per_word(m_spi, bits);
         }
-            private:
-                maa_spi_context m_spi;
-        };
+        /**
+         * Take the bus for a transaction spanning several calls
+         *
+         * @return Result of operation
+         */
+        maa_result_t lock() {
+            return maa_spi_lock(m_spi);
+        }
+        /**
+         * Release the bus taken with lock()
+         *
+         * @return Result of operation
+         */
+        maa_result_t unlock() {
+            return maa_spi_unlock(m_spi);
+        }
+    private:
+        // not copyable, two objects would close the same context
+        Spi(const Spi&);
+        Spi& operator=(const Spi&);
+        friend class Program;
+        maa_spi_context m_spi;
+};
+
 }
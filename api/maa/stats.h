@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Performance counters
+ *
+ * When enabled, the library counts every operation of each context type:
+ * calls, system calls issued, bytes moved, errors, and a latency histogram.
+ * Counting is off by default and costs a single branch per call while
+ * off. Setting the MAA_STATS environment variable enables it at
+ * maa_init() and prints a report to stderr when the process exits.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/** Histogram buckets, bucket i counts latencies below 2^(i+1) ns */
+#define MAA_STATS_BUCKETS 28
+
+/**
+ * Operations that are counted
+ */
+typedef enum {
+    MAA_STATS_GPIO_READ = 0, /**< maa_gpio_read() */
+    MAA_STATS_GPIO_WRITE = 1, /**< maa_gpio_write() */
+    MAA_STATS_GPIO_DIR = 2, /**< maa_gpio_dir() */
+    MAA_STATS_AIO_READ = 3, /**< maa_aio_read() */
+    MAA_STATS_PWM_WRITE = 4, /**< maa_pwm_write() */
+    MAA_STATS_I2C_READ = 5, /**< maa_i2c_read() and maa_i2c_read_byte() */
+    MAA_STATS_I2C_WRITE = 6, /**< maa_i2c_write() and maa_i2c_write_byte() */
+    MAA_STATS_SPI_TRANSFER = 7, /**< maa_spi_write() and maa_spi_transfer_buf() */
+    MAA_STATS_OPS = 8 /**< number of counted operations */
+} maa_stats_op_t;
+
+/**
+ * Counters of one operation
+ */
+typedef struct {
+    /*@{*/
+    uint64_t ops; /**< calls */
+    uint64_t syscalls; /**< system calls issued by the calls */
+    uint64_t bytes; /**< payload bytes read or written */
+    uint64_t errors; /**< calls that failed */
+    uint64_t total_ns; /**< time spent in the calls */
+    uint64_t max_ns; /**< slowest call */
+    uint32_t histogram[MAA_STATS_BUCKETS]; /**< calls per latency bucket */
+    /*@}*/
+} maa_stats_t;
+
+/**
+ * Turn counting on or off, counters keep their values
+ *
+ * @param enable 1 to count
+ * @return Result of operation
+ */
+maa_result_t maa_stats_enable(maa_boolean_t enable);
+
+/**
+ * Copy the counters of one operation
+ *
+ * @param op the operation
+ * @param stats filled with the counters
+ * @return Result of operation
+ */
+maa_result_t maa_stats_get(maa_stats_op_t op, maa_stats_t* stats);
+
+/**
+ * Clear all counters
+ */
+void maa_stats_reset();
+
+/**
+ * Print a table of every operation that was called, with its average, 50th
+ * and 99th percentile latency. Percentiles are the upper bound of their
+ * histogram bucket.
+ *
+ * @param out stream to print to
+ * @return Result of operation
+ */
+maa_result_t maa_stats_dump(FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Event tracer
+ *
+ * The tracer records every counted operation (see stats.h) and every gpio
+ * interrupt wakeup into an in-process ring buffer. The application can add
+ * its own marks and spans. The buffer is written out as Chrome trace event
+ * JSON, which chrome://tracing or Perfetto can open offline. Setting the
+ * MAA_TRACE environment variable to a file name starts the tracer in
+ * maa_init() and writes that file when the process exits.
+ *
+ * When libmaa is built with sys/sdt.h available, the same points are also
+ * USDT probes in the maa provider: entry and exit (function name, failed)
+ * and isr (pin), for use with perf, bpftrace or SystemTap.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <time.h>
+
+#include "common.h"
+
+/**
+ * Start recording, discarding anything recorded before. When more events
+ * than capacity are recorded the oldest are overwritten.
+ *
+ * @param capacity events kept, rounded up to a power of two
+ * @return Result of operation
+ */
+maa_result_t maa_trace_start(unsigned int capacity);
+
+/**
+ * Stop recording, the recorded events are kept for maa_trace_dump()
+ *
+ * @return Result of operation
+ */
+maa_result_t maa_trace_stop();
+
+/**
+ * Record an instant event from the application
+ *
+ * @param name event name, copied and cut to 31 bytes
+ * @return Result of operation
+ */
+maa_result_t maa_trace_mark(const char* name);
+
+/**
+ * Record a span of application work that started at start and ends now
+ *
+ * @param name span name, copied and cut to 31 bytes
+ * @param start CLOCK_MONOTONIC time the work started
+ * @return Result of operation
+ */
+maa_result_t maa_trace_span(const char* name, const struct timespec* start);
+
+/**
+ * Write the recorded events as Chrome trace event JSON, oldest first
+ *
+ * @param out stream to write to
+ * @return Result of operation
+ */
+maa_result_t maa_trace_dump(FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "benchmark/benchmark.h"
+#include "maa.h"
+#include "sim_root.hpp"
+
+/*
+ * Every benchmark reports ops/sec through items_per_second, and per call
+ * latency percentiles as counters. Call latency is measured around each
+ * call and the cost of reading the clock is subtracted.
+ */
+
+static const int GPIO_PIN = 8;
+static const int FAST_GPIO_PIN = 2;
+static const int PWM_PIN = 3;
+static const int AIO_CHANNEL = 0;
+static const int I2C_BUS = 0;
+static const int I2C_ADDRESS = 0x1e;
+static const int SPI_BUS = 0;
+
+static bool simulated = false;
+static uint64_t clock_overhead_ns = 0;
+
+static inline uint64_t
+nowNs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+ * Collects call latencies and publishes their percentiles as counters
+ */
+class Latency {
+    public:
+        explicit Latency(benchmark::State& state) : m_state(state) {
+            m_samples.reserve(1 << 16);
+        }
+        void add(uint64_t start, uint64_t end) {
+            uint64_t ns = end - start;
+            m_samples.push_back(ns > clock_overhead_ns ? ns - clock_overhead_ns : 0);
+        }
+        ~Latency() {
+            m_state.SetItemsProcessed(m_state.iterations());
+            if (m_samples.empty())
+                return;
+            std::sort(m_samples.begin(), m_samples.end());
+            m_state.counters["p50_ns"] = (double) percentile(50);
+            m_state.counters["p99_ns"] = (double) percentile(99);
+            m_state.counters["max_ns"] = (double) m_samples.back();
+        }
+    private:
+        uint64_t percentile(unsigned int p) {
+            size_t index = (m_samples.size() - 1) * p / 100;
+            return m_samples[index];
+        }
+        benchmark::State& m_state;
+        std::vector<uint64_t> m_samples;
+};
+
+/* Time one call per iteration, stop the benchmark on the first failure */
+#define TIMED_LOOP(state, call, ok) \
+    Latency latency(state); \
+    for (auto _ : state) { \
+        decltype(call) result; \
+        uint64_t start = nowNs(); \
+        benchmark::DoNotOptimize(result = (call)); \
+        latency.add(start, nowNs()); \
+        if (!(ok)) { \
+            state.SkipWithError("operation failed"); \
+            break; \
+        } \
+    }
+
+static void
+BM_GpioRead(benchmark::State& state)
+{
+    maa_gpio_context gpio = maa_gpio_init(GPIO_PIN);
+    if (gpio == NULL) {
+        state.SkipWithError("gpio init failed");
+        return;
+    }
+    maa_gpio_dir(gpio, MAA_GPIO_IN);
+    TIMED_LOOP(state, maa_gpio_read(gpio), result >= 0);
+    maa_gpio_close(gpio);
+}
+BENCHMARK(BM_GpioRead);
+
+static void
+BM_GpioWrite(benchmark::State& state)
+{
+    maa_gpio_context gpio = maa_gpio_init(GPIO_PIN);
+    if (gpio == NULL) {
+        state.SkipWithError("gpio init failed");
+        return;
+    }
+    maa_gpio_dir(gpio, MAA_GPIO_OUT);
+    int level = 0;
+    TIMED_LOOP(state, maa_gpio_write(gpio, level ^= 1), result == MAA_SUCCESS);
+    maa_gpio_close(gpio);
+}
+BENCHMARK(BM_GpioWrite);
+
+static void
+BM_GpioWriteMmap(benchmark::State& state)
+{
+    maa_gpio_context gpio = maa_gpio_init(FAST_GPIO_PIN);
+    if (gpio == NULL || maa_gpio_use_mmaped(gpio, 1) != MAA_SUCCESS) {
+        state.SkipWithError("mmap gpio unavailable");
+        if (gpio != NULL)
+            maa_gpio_close(gpio);
+        return;
+    }
+    int level = 0;
+    TIMED_LOOP(state, maa_gpio_write(gpio, level ^= 1), result == MAA_SUCCESS);
+    maa_gpio_close(gpio);
+}
+BENCHMARK(BM_GpioWriteMmap);
+
+static void
+BM_GpioInitClose(benchmark::State& state)
+{
+    Latency latency(state);
+    for (auto _ : state) {
+        uint64_t start = nowNs();
+        maa_gpio_context gpio = maa_gpio_init(GPIO_PIN);
+        if (gpio == NULL) {
+            state.SkipWithError("gpio init failed");
+            break;
+        }
+        maa_gpio_close(gpio);
+        latency.add(start, nowNs());
+    }
+}
+BENCHMARK(BM_GpioInitClose);
+
+static void
+BM_PwmWrite(benchmark::State& state)
+{
+    maa_pwm_context pwm = maa_pwm_init(PWM_PIN);
+    if (pwm == NULL) {
+        state.SkipWithError("pwm init failed");
+        return;
+    }
+    float duty = 0.25f;
+    TIMED_LOOP(state, maa_pwm_write(pwm, duty = 0.75f - duty + 0.25f), result == MAA_SUCCESS);
+    maa_pwm_close(pwm);
+}
+BENCHMARK(BM_PwmWrite);
+
+static void
+BM_AioRead(benchmark::State& state)
+{
+    maa_aio_context aio = maa_aio_init(AIO_CHANNEL);
+    if (aio == NULL) {
+        state.SkipWithError("aio init failed");
+        return;
+    }
+    maa_clear_error();
+    TIMED_LOOP(state, maa_aio_read(aio), maa_last_error()->code == MAA_SUCCESS);
+    maa_aio_close(aio);
+}
+BENCHMARK(BM_AioRead);
+
+static void
+BM_I2cRead(benchmark::State& state)
+{
+    maa_i2c_context i2c = maa_i2c_init(I2C_BUS);
+    if (i2c == NULL) {
+        state.SkipWithError("i2c init failed");
+        return;
+    }
+    // the simulated bus has no slave to address
+    if (maa_i2c_address(i2c, I2C_ADDRESS) != MAA_SUCCESS && !simulated) {
+        state.SkipWithError("no i2c slave");
+        maa_i2c_stop(i2c);
+        return;
+    }
+    std::vector<uint8_t> data(state.range(0));
+    int length = (int) data.size();
+    TIMED_LOOP(state, maa_i2c_read(i2c, data.data(), length), result == length);
+    state.SetBytesProcessed(state.iterations() * length);
+    maa_i2c_stop(i2c);
+}
+BENCHMARK(BM_I2cRead)->Arg(1)->Arg(8)->Arg(32);
+
+static void
+BM_I2cWrite(benchmark::State& state)
+{
+    maa_i2c_context i2c = maa_i2c_init(I2C_BUS);
+    if (i2c == NULL) {
+        state.SkipWithError("i2c init failed");
+        return;
+    }
+    if (maa_i2c_address(i2c, I2C_ADDRESS) != MAA_SUCCESS) {
+        state.SkipWithError("no i2c slave");
+        maa_i2c_stop(i2c);
+        return;
+    }
+    std::vector<uint8_t> data(state.range(0));
+    int length = (int) data.size();
+    TIMED_LOOP(state, maa_i2c_write(i2c, data.data(), length), result == MAA_SUCCESS);
+    state.SetBytesProcessed(state.iterations() * length);
+    maa_i2c_stop(i2c);
+}
+BENCHMARK(BM_I2cWrite)->Arg(2)->Arg(8)->Arg(32);
+
+static void
+BM_SpiTransfer(benchmark::State& state)
+{
+    maa_spi_context spi = maa_spi_init(SPI_BUS);
+    if (spi == NULL) {
+        state.SkipWithError("spi init failed");
+        return;
+    }
+    std::vector<uint8_t> tx(state.range(0)), rx(state.range(0));
+    int length = (int) tx.size();
+    TIMED_LOOP(state, maa_spi_transfer_buf(spi, tx.data(), rx.data(), length), result == MAA_SUCCESS);
+    state.SetBytesProcessed(state.iterations() * length);
+    maa_spi_stop(spi);
+}
+BENCHMARK(BM_SpiTransfer)->Arg(1)->Arg(16)->Arg(64)->Arg(256);
+
+static void
+isrStamp(void* arg)
+{
+    *(volatile uint64_t*) arg = nowNs();
+}
+
+/*
+ * Edge to callback latency needs an output wired to an input, given as
+ * MAA_BENCH_LOOPBACK=out,in
+ */
+static void
+BM_IsrLatency(benchmark::State& state)
+{
+    int out_pin, in_pin;
+    const char* loop = getenv("MAA_BENCH_LOOPBACK");
+    if (simulated || loop == NULL || sscanf(loop, "%d,%d", &out_pin, &in_pin) != 2) {
+        state.SkipWithError("needs MAA_BENCH_LOOPBACK=out,in on a board");
+        return;
+    }
+    maa_gpio_context out = maa_gpio_init(out_pin);
+    maa_gpio_context in = maa_gpio_init(in_pin);
+    volatile uint64_t fired = 0;
+    if (out == NULL || in == NULL || maa_gpio_dir(out, MAA_GPIO_OUT) != MAA_SUCCESS ||
+        maa_gpio_dir(in, MAA_GPIO_IN) != MAA_SUCCESS ||
+        maa_gpio_isr(in, MAA_GPIO_EDGE_BOTH, isrStamp, (void*) &fired) != MAA_SUCCESS) {
+        state.SkipWithError("loopback setup failed");
+    } else {
+        Latency latency(state);
+        int level = 0;
+        for (auto _ : state) {
+            fired = 0;
+            uint64_t start = nowNs();
+            maa_gpio_write(out, level ^= 1);
+            while (fired == 0 && nowNs() - start < 100000000ULL)
+                ;
+            if (fired == 0) {
+                state.SkipWithError("edge not seen, check the wiring");
+                break;
+            }
+            latency.add(start, fired);
+        }
+        maa_gpio_isr_exit(in);
+    }
+    if (in != NULL)
+        maa_gpio_close(in);
+    if (out != NULL)
+        maa_gpio_close(out);
+}
+BENCHMARK(BM_IsrLatency)->UseRealTime();
+
+static uint64_t
+measureClockOverhead()
+{
+    std::vector<uint64_t> samples;
+    for (int i = 0; i < 1001; i++) {
+        uint64_t start = nowNs();
+        samples.push_back(nowNs() - start);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+int
+main(int argc, char** argv)
+{
+    bool force_sim = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sim") == 0) {
+            force_sim = true;
+            // hide it from google benchmark
+            for (int j = i; j < argc - 1; j++)
+                argv[j] = argv[j + 1];
+            argc--;
+            break;
+        }
+    }
+
+    std::string root;
+    if (force_sim || (getenv("MAA_SYSFS_ROOT") == NULL && access("/sys/class/gpio/export", W_OK) != 0)) {
+        root = maa_bench::createSimRoot();
+        if (root.empty() || maa_set_sysfs_root(root.c_str()) != MAA_SUCCESS) {
+            fprintf(stderr, "Failed to create a simulated device tree\n");
+            return 1;
+        }
+        simulated = true;
+    }
+    simulated = simulated || getenv("MAA_SYSFS_ROOT") != NULL;
+
+    // keep failures out of the timings
+    maa_log_set_sink([](maa_log_level_t, const char*, void*) {}, NULL);
+    clock_overhead_ns = measureClockOverhead();
+
+    benchmark::AddCustomContext("maa_version", maa_get_version());
+    benchmark::AddCustomContext("maa_backend", simulated ? "simulated" : "hardware");
+    benchmark::AddCustomContext("maa_clock_overhead_ns", std::to_string(clock_overhead_ns));
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    maa_bench::removeSimRoot(root);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sim_root.hpp"
+
+namespace maa_bench {
+
+static bool
+writeFile(const std::string& path, const char* content, size_t size = 0)
+{
+    FILE* fh = fopen(path.c_str(), "w");
+    if (fh == NULL)
+        return false;
+    fputs(content, fh);
+    if (size > 0)
+        ftruncate(fileno(fh), size);
+    fclose(fh);
+    return true;
+}
+
+static bool
+makeDirs(const std::string& path)
+{
+    std::string::size_type pos = 0;
+    while ((pos = path.find('/', pos + 1)) != std::string::npos)
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    return mkdir(path.c_str(), 0755) == 0;
+}
+
+std::string
+createSimRoot()
+{
+    char tmpl[] = "/tmp/maa-sim-XXXXXX";
+    if (mkdtemp(tmpl) == NULL)
+        return "";
+    std::string root(tmpl);
+
+    std::string gpio = root + "/sys/class/gpio";
+    makeDirs(gpio);
+    writeFile(gpio + "/export", "");
+    writeFile(gpio + "/unexport", "");
+    // every gpio already exported, so contexts never wait for udev
+    for (int i = 0; i < 64; i++) {
+        std::string dir = gpio + "/gpio" + std::to_string(i);
+        makeDirs(dir);
+        writeFile(dir + "/direction", "in\n");
+        writeFile(dir + "/value", "0\n");
+        writeFile(dir + "/edge", "none\n");
+        writeFile(dir + "/drive", "strong\n");
+    }
+
+    std::string pwm = root + "/sys/class/pwm/pwmchip0";
+    makeDirs(pwm);
+    writeFile(pwm + "/export", "");
+    writeFile(pwm + "/unexport", "");
+    for (int i = 0; i < 8; i++) {
+        std::string dir = pwm + "/pwm" + std::to_string(i);
+        makeDirs(dir);
+        writeFile(dir + "/period", "1000000\n");
+        writeFile(dir + "/duty_cycle", "0\n");
+        writeFile(dir + "/enable", "0\n");
+    }
+
+    std::string iio = root + "/sys/bus/iio/devices/iio:device0";
+    makeDirs(iio);
+    for (int i = 0; i < 8; i++)
+        writeFile(iio + "/in_voltage" + std::to_string(i) + "_raw", "2048\n");
+
+    std::string dev = root + "/dev";
+    makeDirs(dev);
+    writeFile(dev + "/uio0", "", 0x1000);
+    const char* buses[] = { "i2c-0", "spidev1.0", "spidev0.0" };
+    for (const char* bus : buses)
+        symlink("/dev/zero", (dev + "/" + bus).c_str());
+
+    return root;
+}
+
+void
+removeSimRoot(const std::string& root)
+{
+    if (root.empty() || root.compare(0, 13, "/tmp/maa-sim-") != 0)
+        return;
+    std::string cmd = "rm -rf '" + root + "'";
+    if (system(cmd.c_str()) != 0)
+        fprintf(stderr, "Failed to remove %s\n", root.c_str());
+}
+
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "maa.hpp"
+#include "maa/fast_gpio.hpp"
+
+int main (int argc, char **argv)
+{
+//! [Interesting]
+    maa::FastGpio<maa::board::GalileoGen1, 2> io2;
+    if (!io2.valid()) {
+        fprintf(stderr, "Failed to map IO2\n");
+        return MAA_ERROR_INVALID_RESOURCE;
+    }
+    io2.dir(maa::DIR_OUT);
+
+    // each write is a masked access of the register, no library call
+    for (;;) {
+        io2.write(1);
+        io2.write(0);
+    }
+//! [Interesting]
+    return MAA_SUCCESS;
+}
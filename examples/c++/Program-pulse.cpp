@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "maa.hpp"
+
+int main (int argc, char **argv)
+{
+//! [Interesting]
+    maa::Gpio clk(8);
+    maa::Gpio dat(6);
+    clk.dir(maa::DIR_OUT);
+    dat.dir(maa::DIR_IN);
+
+    // clock in 8 bits, sampling the data line on each falling edge
+    maa::Program prog;
+    int c = prog.addGpio(clk);
+    int d = prog.addGpio(dat);
+    int body = prog.size();
+    prog.gpioWrite(c, 1);
+    prog.waitUs(10);
+    prog.gpioWrite(c, 0);
+    prog.gpioRead(d);
+    prog.waitUs(10);
+    prog.loop(body, 8);
+
+    maa_result_t response = prog.run(50);
+    for (int i = 0; i < prog.resultLength(); i++) {
+        printf("%d", prog.result(i));
+    }
+    printf("\n");
+//! [Interesting]
+    return response;
+}
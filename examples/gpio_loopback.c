@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maa.h"
+
+/*
+ * Wire an output to an input and run "gpio_loopback <out> <in> [edges]" to
+ * get the edge to callback latency of every isr mode the pins support, or
+ * "MAA_SYSFS_ROOT=<tree> gpio_loopback --sim <in> [edges]" for the same
+ * measurement on a simulated tree.
+ */
+static const char* modes[] = { "sysfs", "uio", "busy poll" };
+
+int
+main(int argc, char** argv)
+{
+    int sim = argc > 1 && strcmp(argv[1], "--sim") == 0;
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <out> <in> [edges] | --sim <in> [edges]\n", argv[0]);
+        return 1;
+    }
+    unsigned int edges = 1000;
+    if (argc > 3)
+        edges = atoi(argv[3]);
+
+    maa_init();
+    maa_gpio_context out = NULL, in = NULL;
+    if (!sim) {
+        out = maa_gpio_init(atoi(argv[1]));
+        in = maa_gpio_init(atoi(argv[2]));
+        if (out == NULL || in == NULL)
+            return 1;
+    }
+
+//! [Interesting]
+    int mode;
+    for (mode = MAA_GPIO_ISR_SYSFS; mode <= MAA_GPIO_ISR_BUSY_POLL; mode++) {
+        maa_loopback_result_t result;
+        maa_result_t ret;
+        if (sim)
+            ret = maa_gpio_loopback_sim(atoi(argv[2]), (gpio_isr_mode_t) mode, edges, 0, &result);
+        else
+            ret = maa_gpio_loopback(out, in, (gpio_isr_mode_t) mode, edges, 0, &result);
+
+        fprintf(stdout, "== %s%s\n", modes[mode], sim ? " (simulated)" : "");
+        if (ret != MAA_SUCCESS) {
+            fprintf(stdout, "not available\n\n");
+            continue;
+        }
+        maa_loopback_print(&result, stdout);
+        fprintf(stdout, "\n");
+    }
+//! [Interesting]
+
+    if (!sim) {
+        maa_gpio_close(in);
+        maa_gpio_close(out);
+    }
+    return MAA_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "maa.h"
+
+#define BUTTONS 4
+
+static const int pins[BUTTONS] = { 4, 5, 6, 7 };
+
+void
+pressed(const maa_gpio_event_t* event, void* user)
+{
+    fprintf(stdout, "button on IO%d %s at %ld.%09ld\n", event->pin,
+            event->edge == MAA_GPIO_EDGE_FALLING ? "pressed" : "released",
+            (long) event->timestamp.tv_sec, event->timestamp.tv_nsec);
+}
+
+int
+main()
+{
+    maa_init();
+//! [Interesting]
+    maa_gpio_context buttons[BUTTONS];
+    int i;
+    for (i = 0; i < BUTTONS; i++) {
+        buttons[i] = maa_gpio_init(pins[i]);
+        if (buttons[i] == NULL)
+            return 1;
+        maa_gpio_dir(buttons[i], MAA_GPIO_IN);
+    }
+
+    // one thread and one callback for all the buttons
+    maa_gpio_multi_context group;
+    group = maa_gpio_isr_multi(buttons, BUTTONS, MAA_GPIO_EDGE_BOTH, &pressed, NULL);
+    if (group == NULL)
+        return 1;
+
+    sleep(60);
+
+    maa_gpio_isr_multi_exit(group);
+//! [Interesting]
+    for (i = 0; i < BUTTONS; i++)
+        maa_gpio_close(buttons[i]);
+
+    return MAA_SUCCESS;
+}
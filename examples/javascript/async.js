@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+var m = require("maajs")
+
+// none of these calls block the event loop, they run on the libuv threadpool
+var compass = new m.I2c(0)
+compass.address(0x1E)
+m.i2cWriteAsync(compass, new Buffer([0x02, 0x00])).then(function() {
+    return m.i2cReadAsync(compass, 6)
+}).then(function(data) {
+    console.log("compass raw: " + data.toString("hex"))
+})
+
+var a0 = new m.Aio(0)
+m.aioReadAsync(a0).then(function(value) {
+    console.log("A0: " + value)
+})
+
+// isr callbacks are delivered on the event loop
+var button = new m.Gpio(6)
+button.dir(m.DIR_IN)
+m.gpioIsr(button, m.EDGE_BOTH, function() {
+    m.gpioReadAsync(button).then(function(value) {
+        console.log("IO6 is now " + value)
+    })
+})
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+var m = require("maa_napi")
+
+var led = new m.Gpio(8)
+led.dir(m.DIR_OUT)
+led.write(1)
+
+// Buffers are handed to libmaa in place, rx may be the same Buffer as tx
+var spi = new m.Spi(0)
+var tx = new Buffer([0x00, 0x80])
+var rx = new Buffer(2)
+spi.transferAsync(tx, rx).then(function() {
+    console.log("spi received " + rx.toString("hex"))
+})
+
+var a0 = new m.Aio(0)
+a0.readAsync().then(function(value) {
+    console.log("A0: " + value)
+    a0.close()
+})
+
+// the callback runs on the javascript thread after each edge
+var button = new m.Gpio(3)
+button.dir(m.DIR_IN)
+button.isr(m.EDGE_BOTH, function() {
+    console.log("button: " + button.read())
+})
+setTimeout(function() {
+    button.isrExit()
+}, 10000)
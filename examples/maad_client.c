@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "maa.h"
+
+int
+main()
+{
+//! [Interesting]
+    maa_client_context client = maa_client_connect(NULL);
+    if (client == NULL) {
+        fprintf(stderr, "maad is not running\n");
+        return 1;
+    }
+
+    int led = maa_client_gpio_init(client, 13);
+    int button = maa_client_gpio_init(client, 6);
+    if (led == -1 || button == -1)
+        return 1;
+
+    // both calls go to the daemon in one message
+    maa_client_batch_begin(client);
+    maa_client_gpio_dir(client, led, MAA_GPIO_OUT);
+    maa_client_gpio_dir(client, button, MAA_GPIO_IN);
+    if (maa_client_batch_flush(client) != MAA_SUCCESS)
+        return 1;
+
+    maa_client_gpio_isr(client, button, MAA_GPIO_EDGE_BOTH);
+    struct pollfd pfd = { maa_client_gpio_event_fd(client), POLLIN, 0 };
+    int presses = 0;
+    while (presses < 10 && poll(&pfd, 1, -1) > 0) {
+        uint64_t count;
+        if (read(pfd.fd, &count, sizeof(count)) != sizeof(count))
+            continue;
+        maa_gpio_event_t events[8];
+        int i, n = maa_client_gpio_events(client, events, 8);
+        for (i = 0; i < n; i++) {
+            int pressed = events[i].edge == MAA_GPIO_EDGE_FALLING;
+            maa_client_gpio_write(client, led, pressed);
+            presses += pressed;
+        }
+    }
+    maa_client_close(client);
+//! [Interesting]
+
+    return MAA_SUCCESS;
+}
@@ -26,6 +26,7 @@
 #include <unistd.h>
 
 #include "maa.h"
+#include "maa/gpio_fast.h"
 
 int
 main(int argc, char **argv)
@@ -37,10 +38,16 @@ main(int argc, char **argv)
 
     maa_gpio_use_mmaped(gpio, 1);
 
+    maa_gpio_fast_t fast;
+    if (maa_gpio_get_fast(gpio, &fast) != MAA_SUCCESS) {
+        fprintf(stderr, "IO2 is not memory mapped\n");
+        return 1;
+    }
+
     for (;;) {
-        maa_gpio_write(gpio , 1);
+        maa_gpio_fast_set(&fast);
         usleep(50000);
-        maa_gpio_write(gpio, 0);
+        maa_gpio_fast_clear(&fast);
         usleep(50000);
     }
 //! [Interesting]
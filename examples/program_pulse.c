@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "maa.h"
+
+int
+main(int argc, char **argv)
+{
+    maa_init();
+//! [Interesting]
+    maa_gpio_context clk = maa_gpio_init(8);
+    maa_gpio_context dat = maa_gpio_init(6);
+    if (clk == NULL || dat == NULL) {
+        fprintf(stderr, "Failed to initialise IO8 and IO6\n");
+        return MAA_ERROR_UNSPECIFIED;
+    }
+    maa_gpio_dir(clk, MAA_GPIO_OUT);
+    maa_gpio_dir(dat, MAA_GPIO_IN);
+
+    // clock in 8 bits, sampling the data line on each falling edge
+    maa_program_context prog = maa_program_init();
+    int c = maa_program_add_gpio(prog, clk);
+    int d = maa_program_add_gpio(prog, dat);
+    int body = maa_program_size(prog);
+    maa_program_gpio_write(prog, c, 1);
+    maa_program_wait_us(prog, 10);
+    maa_program_gpio_write(prog, c, 0);
+    maa_program_gpio_read(prog, d);
+    maa_program_wait_us(prog, 10);
+    maa_program_loop(prog, body, 8);
+
+    maa_result_t r = maa_program_run(prog, 50);
+    if (r != MAA_SUCCESS) {
+        maa_result_print(r);
+    }
+
+    int length, i;
+    const uint8_t* bits = maa_program_results(prog, &length);
+    for (i = 0; i < length; i++) {
+        fprintf(stdout, "%d", bits[i]);
+    }
+    fprintf(stdout, "\n");
+
+    maa_program_close(prog);
+//! [Interesting]
+    maa_gpio_close(clk);
+    maa_gpio_close(dat);
+
+    return r;
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2014 Intel Corporation.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+
+# Compares the toggle rate of the swig generated Gpio with the hand written
+# pymaa_fast.Gpio, both drive the same pin through the same libmaa calls so
+# the difference is the python binding overhead per call.
+
+import sys
+import timeit
+
+import pymaa as maa
+import pymaa_fast
+
+pin = 8
+count = 100000
+if len(sys.argv) > 1:
+    pin = int(sys.argv[1])
+
+def bench(name, write, read):
+    w = timeit.timeit(lambda: write(1), number=count)
+    r = timeit.timeit(read, number=count)
+    print("%-12s write %8.0f ops/s %6.2f us/op   read %8.0f ops/s %6.2f us/op" %
+          (name, count / w, w * 1e6 / count, count / r, r * 1e6 / count))
+
+swig = maa.Gpio(pin)
+swig.dir(maa.DIR_OUT)
+bench("swig", swig.write, swig.read)
+del swig
+
+fast = pymaa_fast.Gpio(pin)
+fast.dir(pymaa_fast.DIR_OUT)
+bench("pymaa_fast", fast.write, fast.read)
+
+# memory mapped io makes the binding overhead the dominating cost
+if fast.useMmaped(True) == 0:
+    bench("fast+mmap", fast.write, fast.read)
@@ -0,0 +1,44 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2014 Intel Corporation.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+import pymaa as maa
+
+clk = maa.Gpio(8)
+dat = maa.Gpio(6)
+clk.dir(maa.DIR_OUT)
+dat.dir(maa.DIR_IN)
+
+# built once in python, the bit banging itself runs natively
+prog = maa.Program()
+c = prog.addGpio(clk)
+d = prog.addGpio(dat)
+body = prog.size()
+prog.gpioWrite(c, 1)
+prog.waitUs(10)
+prog.gpioWrite(c, 0)
+prog.gpioRead(d)
+prog.waitUs(10)
+prog.loop(body, 8)
+
+prog.run(50)
+print("".join(str(prog.result(i)) for i in range(prog.resultLength())))
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "maa.h"
+
+/*
+ * Run "ring_export" once to sample A0 into a ring, and "ring_export read"
+ * from as many other processes as needed to follow the same samples.
+ */
+int
+main(int argc, char** argv)
+{
+    maa_init();
+//! [Interesting]
+    if (argc > 1) {
+        maa_ring_context ring = maa_ring_attach("/maa-a0");
+        if (ring == NULL)
+            return 1;
+        for (;;) {
+            maa_aio_sample_t samples[64];
+            uint32_t seq;
+            int i, n = maa_ring_read(ring, samples, 64, &seq);
+            for (i = 0; i < n; i++)
+                if (!samples[i].failed)
+                    fprintf(stdout, "%u: %u\n", seq + i, samples[i].value);
+            usleep(10000);
+        }
+    }
+
+    maa_aio_context adc = maa_aio_init(0);
+    maa_ring_context ring = maa_ring_create("/maa-a0", sizeof(maa_aio_sample_t), 4096);
+    if (adc == NULL || ring == NULL)
+        return 1;
+    // 1 kHz, however many readers there are
+    maa_aio_export(adc, ring, 1000);
+    sleep(60);
+    maa_aio_close(adc);
+    maa_ring_close(ring);
+//! [Interesting]
+
+    return MAA_SUCCESS;
+}
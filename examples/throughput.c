@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "maa.h"
+#include "maa/gpio_fast.h"
+
+/*
+ * Measure how fast every access method the library offers can drive a board
+ * and print them side by side, e.g. "throughput --gpio 2 --pwm 3 --i2c 0:0x1e".
+ * Pass --csv to save a run and --baseline <file> to compare against one:
+ * rows more than 10% slower are flagged and the exit status is 2.
+ */
+
+#define MAX_ROWS 16
+#define BLOCK 32
+
+struct options {
+    int gpio;
+    int pwm;
+    int aio;
+    int i2c_bus;
+    int i2c_address;
+    int spi;
+    int duration_ms;
+};
+
+struct row {
+    const char* subsystem;
+    const char* method;
+    const char* unit;
+    double rate;
+    int available;
+};
+
+static struct row rows[MAX_ROWS];
+static int nrows;
+
+static double
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+add_row(const char* subsystem, const char* method, const char* unit, double rate, int available)
+{
+    if (nrows == MAX_ROWS)
+        return;
+    rows[nrows].subsystem = subsystem;
+    rows[nrows].method = method;
+    rows[nrows].unit = unit;
+    rows[nrows].rate = rate;
+    rows[nrows].available = available;
+    nrows++;
+}
+
+/*
+ * Run op in batches of 64 until duration_ms has passed and store operations
+ * per second in rate, or -1 if op returned false. A macro rather than a
+ * callback so the fast register row is not measuring an indirect call.
+ */
+#define MEASURE(rate, duration_ms, op)                                        \
+    do {                                                                      \
+        double start_ = now(), end_ = start_ + (duration_ms) / 1000.0, t_;    \
+        unsigned long n_ = 0;                                                 \
+        int failed_ = 0, i_;                                                  \
+        do {                                                                  \
+            for (i_ = 0; i_ < 64 && !failed_; i_++, n_++)                     \
+                failed_ = !(op);                                              \
+            t_ = now();                                                       \
+        } while (t_ < end_ && !failed_);                                      \
+        rate = failed_ ? -1.0 : n_ / (t_ - start_);                           \
+    } while (0)
+
+static void
+bench_gpio(const struct options* opt)
+{
+    int level = 0;
+    double rate;
+    maa_gpio_context gpio = maa_gpio_init(opt->gpio);
+    if (gpio == NULL || maa_gpio_dir(gpio, MAA_GPIO_OUT) != MAA_SUCCESS) {
+        add_row("gpio", "sysfs", "Hz", 0, 0);
+        add_row("gpio", "mmap", "Hz", 0, 0);
+        add_row("gpio", "fast register", "Hz", 0, 0);
+        if (gpio != NULL)
+            maa_gpio_close(gpio);
+        return;
+    }
+
+    /* A full toggle period is two writes */
+    MEASURE(rate, opt->duration_ms, maa_gpio_write(gpio, level ^= 1) == MAA_SUCCESS);
+    add_row("gpio", "sysfs", "Hz", rate / 2, rate > 0);
+
+    if (maa_gpio_use_mmaped(gpio, 1) == MAA_SUCCESS) {
+        MEASURE(rate, opt->duration_ms, maa_gpio_write(gpio, level ^= 1) == MAA_SUCCESS);
+        add_row("gpio", "mmap", "Hz", rate / 2, rate > 0);
+
+        maa_gpio_fast_t fast;
+        if (maa_gpio_get_fast(gpio, &fast) == MAA_SUCCESS) {
+            MEASURE(rate, opt->duration_ms, (maa_gpio_fast_toggle(&fast), 1));
+            add_row("gpio", "fast register", "Hz", rate / 2, 1);
+        } else {
+            add_row("gpio", "fast register", "Hz", 0, 0);
+        }
+        maa_gpio_use_mmaped(gpio, 0);
+    } else {
+        add_row("gpio", "mmap", "Hz", 0, 0);
+        add_row("gpio", "fast register", "Hz", 0, 0);
+    }
+    maa_gpio_close(gpio);
+}
+
+static void
+bench_pwm(const struct options* opt)
+{
+    int step = 0;
+    double rate = -1;
+    maa_pwm_context pwm = maa_pwm_init(opt->pwm);
+    if (pwm != NULL && maa_pwm_period_us(pwm, 1000) == MAA_SUCCESS &&
+        maa_pwm_enable(pwm, 1) == MAA_SUCCESS) {
+        MEASURE(rate, opt->duration_ms,
+                       maa_pwm_write(pwm, (++step % 100) / 100.0f) == MAA_SUCCESS);
+        add_row("pwm", "duty percentage", "updates/s", rate, rate > 0);
+        MEASURE(rate, opt->duration_ms,
+                       maa_pwm_pulsewidth_us(pwm, ++step % 1000) == MAA_SUCCESS);
+        add_row("pwm", "pulse width", "updates/s", rate, rate > 0);
+        maa_pwm_enable(pwm, 0);
+    } else {
+        add_row("pwm", "duty percentage", "updates/s", 0, 0);
+        add_row("pwm", "pulse width", "updates/s", 0, 0);
+    }
+    if (pwm != NULL)
+        maa_pwm_close(pwm);
+}
+
+static void
+bench_aio(const struct options* opt)
+{
+    double rate = -1;
+    maa_aio_context aio = maa_aio_init(opt->aio);
+    if (aio != NULL) {
+        maa_clear_error();
+        MEASURE(rate, opt->duration_ms,
+                       (maa_aio_read(aio), maa_last_error()->code == MAA_SUCCESS));
+        maa_aio_close(aio);
+    }
+    add_row("aio", "sysfs", "samples/s", rate, rate > 0);
+}
+
+static void
+bench_i2c(const struct options* opt)
+{
+    uint8_t block[BLOCK] = { 0 };
+    double rate;
+    maa_i2c_context i2c = maa_i2c_init(opt->i2c_bus);
+    if (i2c == NULL || maa_i2c_address(i2c, opt->i2c_address) != MAA_SUCCESS) {
+        add_row("i2c", "read byte", "bytes/s", 0, 0);
+        add_row("i2c", "read block", "bytes/s", 0, 0);
+        add_row("i2c", "write byte", "bytes/s", 0, 0);
+        add_row("i2c", "write block", "bytes/s", 0, 0);
+        if (i2c != NULL)
+            maa_i2c_stop(i2c);
+        return;
+    }
+
+    maa_clear_error();
+    MEASURE(rate, opt->duration_ms,
+                   (maa_i2c_read_byte(i2c), maa_last_error()->code == MAA_SUCCESS));
+    add_row("i2c", "read byte", "bytes/s", rate, rate > 0);
+    MEASURE(rate, opt->duration_ms, maa_i2c_read(i2c, block, BLOCK) == BLOCK);
+    add_row("i2c", "read block", "bytes/s", rate * BLOCK, rate > 0);
+    MEASURE(rate, opt->duration_ms, maa_i2c_write_byte(i2c, 0) == MAA_SUCCESS);
+    add_row("i2c", "write byte", "bytes/s", rate, rate > 0);
+    MEASURE(rate, opt->duration_ms, maa_i2c_write(i2c, block, BLOCK) == MAA_SUCCESS);
+    add_row("i2c", "write block", "bytes/s", rate * BLOCK, rate > 0);
+    maa_i2c_stop(i2c);
+}
+
+static void
+bench_spi(const struct options* opt)
+{
+    uint8_t tx[BLOCK] = { 0 }, rx[BLOCK];
+    double rate;
+    maa_spi_context spi = maa_spi_init(opt->spi);
+    if (spi == NULL) {
+        add_row("spi", "byte", "bytes/s", 0, 0);
+        add_row("spi", "transfer buffer", "bytes/s", 0, 0);
+        return;
+    }
+
+    maa_clear_error();
+    MEASURE(rate, opt->duration_ms,
+                   (maa_spi_write(spi, 0xaa), maa_last_error()->code == MAA_SUCCESS));
+    add_row("spi", "byte", "bytes/s", rate, rate > 0);
+    MEASURE(rate, opt->duration_ms,
+                   maa_spi_transfer_buf(spi, tx, rx, BLOCK) == MAA_SUCCESS);
+    add_row("spi", "transfer buffer", "bytes/s", rate * BLOCK, rate > 0);
+    maa_spi_stop(spi);
+}
+
+/* Rate for the same row in a saved csv, or -1 if it is not there */
+static double
+baseline_rate(FILE* baseline, const struct row* r)
+{
+    char line[256], subsystem[32], method[32];
+    double rate;
+    rewind(baseline);
+    while (fgets(line, sizeof(line), baseline) != NULL) {
+        if (sscanf(line, "%31[^,],%31[^,],%*[^,],%lf", subsystem, method, &rate) == 3 &&
+            strcmp(subsystem, r->subsystem) == 0 && strcmp(method, r->method) == 0)
+            return rate;
+    }
+    return -1;
+}
+
+static void
+usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--gpio pin] [--pwm pin] [--aio pin] [--i2c bus:address]\n"
+                    "       [--spi bus] [--time ms] [--csv] [--baseline file]\n", name);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct options opt = { 2, 3, 0, 0, 0x1e, 0, 500 };
+    int csv = 0, regressions = 0, c, i;
+    FILE* baseline = NULL;
+    static const struct option longopts[] = {
+        { "gpio", required_argument, NULL, 'g' },
+        { "pwm", required_argument, NULL, 'p' },
+        { "aio", required_argument, NULL, 'a' },
+        { "i2c", required_argument, NULL, 'i' },
+        { "spi", required_argument, NULL, 's' },
+        { "time", required_argument, NULL, 't' },
+        { "csv", no_argument, NULL, 'c' },
+        { "baseline", required_argument, NULL, 'b' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ((c = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'g': opt.gpio = atoi(optarg); break;
+            case 'p': opt.pwm = atoi(optarg); break;
+            case 'a': opt.aio = atoi(optarg); break;
+            case 'i':
+                if (sscanf(optarg, "%d:%i", &opt.i2c_bus, &opt.i2c_address) < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's': opt.spi = atoi(optarg); break;
+            case 't': opt.duration_ms = atoi(optarg); break;
+            case 'c': csv = 1; break;
+            case 'b':
+                baseline = fopen(optarg, "r");
+                if (baseline == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    maa_init();
+
+//! [Interesting]
+    bench_gpio(&opt);
+    bench_pwm(&opt);
+    bench_aio(&opt);
+    bench_i2c(&opt);
+    bench_spi(&opt);
+//! [Interesting]
+
+    if (csv) {
+        fprintf(stdout, "subsystem,method,unit,rate\n");
+        for (i = 0; i < nrows; i++) {
+            if (rows[i].available)
+                fprintf(stdout, "%s,%s,%s,%.0f\n", rows[i].subsystem, rows[i].method,
+                        rows[i].unit, rows[i].rate);
+        }
+    } else {
+        fprintf(stdout, "MAA %s, %d ms per method\n\n", maa_get_version(), opt.duration_ms);
+        fprintf(stdout, "%-10s %-16s %14s %-10s%s\n", "subsystem", "method", "rate", "unit",
+                baseline != NULL ? "  baseline" : "");
+    }
+
+    for (i = 0; i < nrows && !csv; i++) {
+        const struct row* r = &rows[i];
+        if (!r->available) {
+            fprintf(stdout, "%-10s %-16s %14s\n", r->subsystem, r->method, "n/a");
+            continue;
+        }
+        fprintf(stdout, "%-10s %-16s %14.0f %-10s", r->subsystem, r->method, r->rate, r->unit);
+        double base = baseline != NULL ? baseline_rate(baseline, r) : -1;
+        if (base > 0) {
+            int slower = r->rate < base * 0.9;
+            fprintf(stdout, "  %+.1f%%%s", (r->rate - base) * 100 / base,
+                    slower ? " SLOWER" : "");
+            regressions += slower;
+        }
+        fprintf(stdout, "\n");
+    }
+
+    if (baseline != NULL) {
+        for (i = 0; i < nrows && csv; i++) {
+            double base = baseline_rate(baseline, &rows[i]);
+            regressions += rows[i].available && base > 0 && rows[i].rate < base * 0.9;
+        }
+        fclose(baseline);
+    }
+
+    return regressions > 0 ? 2 : MAA_SUCCESS;
+}
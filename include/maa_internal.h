@@ -24,7 +24,13 @@
 
 #pragma once
 
+#include <time.h>
+
 #include "common.h"
+#include "gpio.h"
+#include "stats.h"
+#include "log.h"
+#include "maa_trace.h"
 
 /** Setup gpio
  *
@@ -59,7 +65,7 @@ maa_spi_bus_t* maa_setup_spi(int bus);
  * Will check input is valid for pwm and will also setup required multiplexers.
  * IF the pin also does gpio (strong chance), DO NOTHING, REV D quirk
  * @param pin the pin as read from the board surface.
- * @return the pwm pin_info_t of that IO pin
+ * @return the pwm pin_info_t of that IO pin, owned by the platform
  */
 maa_pin_t* maa_setup_pwm(int pin);
 
@@ -76,3 +82,177 @@ maa_mmap_pin_t* maa_setup_mmap_gpio(int pin);
  * @return out direction to setup. 1 for output 0 for input
  */
 maa_result_t maa_swap_complex_gpio(int pin, int out);
+
+/** Claim a physical pin for a function.
+ *
+ * Claims of the same function are counted, a claim for another function
+ * fails while the pin is in use.
+ * @param pin physical pin
+ * @param mode function the pin is used for
+ * @return MAA_SUCCESS or MAA_ERROR_NO_RESOURCES on conflict
+ */
+maa_result_t maa_claim_pin(int pin, maa_pinmodes_t mode);
+
+/** Drop one claim on a physical pin.
+ *
+ * @param pin physical pin
+ * @return claims left on the pin, -1 for an invalid pin
+ */
+int maa_release_pin(int pin);
+
+/** Value of a mux cache entry whose line was changed outside the cache */
+#define MAA_MUX_UNKNOWN ((unsigned int) -1)
+
+/** Check whether a raw gpio is used as a multiplexer line by the platform.
+ *
+ * @param gpio raw gpio
+ * @return 1 if any pin lists it as a mux, 0 otherwise
+ */
+int maa_mux_gpio(unsigned int gpio);
+
+/** Forget the cached value of a mux line.
+ *
+ * Called when the line is written by anything other than the mux setup, so
+ * the next pin needing the mux writes it again.
+ * @param gpio raw gpio of the mux line
+ */
+void maa_mux_invalidate(unsigned int gpio);
+
+/** Open a raw gpio the library only needs for a moment, such as a line
+ * set during pwm setup or a direction change.
+ *
+ * Like maa_gpio_init_raw() but heap allocated even while a pool is in use,
+ * so the library never takes a context the application reserved.
+ * maa_gpio_close() frees it.
+ * @param gpio raw gpio
+ * @return gpio context or NULL
+ */
+maa_gpio_context maa_gpio_init_internal(int gpio);
+
+/** Open a context on a mux line for the mux setup itself.
+ *
+ * Writes through it keep the mux cache valid, the cache is updated by the
+ * caller instead. The context is heap allocated even while a pool is in
+ * use, maa_gpio_close() frees it.
+ * @param gpio raw gpio of the mux line
+ * @return gpio context or NULL
+ */
+maa_gpio_context maa_gpio_init_mux(int gpio);
+
+/** Raw gpio number of a context, the gpioN of its sysfs directory.
+ *
+ * @param dev gpio context
+ * @return raw gpio or -1
+ */
+int maa_gpio_raw_pin(maa_gpio_context dev);
+
+/** Whether a context currently uses memory mapped io.
+ *
+ * @param dev gpio context
+ * @return 1 when mmaped, 0 otherwise
+ */
+maa_boolean_t maa_gpio_mmaped(maa_gpio_context dev);
+
+/* Designware APB gpio interrupt registers, as word offsets into the mapped
+ * register page */
+#define DW_GPIO_INTEN         (0x30 / 4)
+#define DW_GPIO_INTMASK       (0x34 / 4)
+#define DW_GPIO_INTTYPE_LEVEL (0x38 / 4)
+#define DW_GPIO_INT_POLARITY  (0x3c / 4)
+#define DW_GPIO_INTSTATUS     (0x40 / 4)
+#define DW_GPIO_PORTA_EOI     (0x4c / 4)
+#define DW_GPIO_EXT_PORTA     (0x50 / 4)
+#define DW_GPIO_PINS          32
+
+/** Drop the claim maa_setup_aio() made.
+ *
+ * @param aio the analog input as passed to maa_setup_aio()
+ */
+void maa_release_aio(int aio);
+
+/** Drop the claims maa_setup_i2c() made.
+ *
+ * @param bus the bus as passed to maa_setup_i2c()
+ */
+void maa_release_i2c(int bus);
+
+/** Drop the claims maa_setup_spi() made.
+ *
+ * @param bus the bus as passed to maa_setup_spi()
+ */
+void maa_release_spi(int bus);
+
+/** Directory sysfs and device paths are resolved under.
+ *
+ * @return "" unless maa_set_sysfs_root() or MAA_SYSFS_ROOT chose another
+ */
+const char* maa_sysfs_root();
+
+/** Time to wait for udev to create and chmod sysfs attributes after export */
+#define MAA_SYSFS_READY_TIMEOUT_MS 1000
+
+/** Wait for a file to become accessible.
+ *
+ * Polls with exponential backoff, so a file that is already usable costs a
+ * single access() and one that udev is still setting up is picked up within
+ * a short delay of being ready.
+ * @param path file to wait for
+ * @param mode access mode needed, as for access(2)
+ * @param timeout_ms how long to wait before giving up
+ * @return MAA_SUCCESS once accessible, MAA_ERROR_NO_RESOURCES on timeout
+ */
+maa_result_t maa_wait_for_file(const char* path, int mode, unsigned int timeout_ms);
+
+/** System calls issued so far by the calling thread */
+extern __thread unsigned int maa_stats_syscalls __attribute__((tls_model("initial-exec")));
+
+/** Start timing an operation, the timestamp stays invalid when nothing records */
+#define MAA_STATS_BEGIN(t) struct timespec t = { 0, -1 }; MAA_PROBE_ENTRY(); \
+    if (maa_instrument) maa_stats_begin(&t)
+
+/** Account for system calls made by the operation being timed */
+#define MAA_STATS_SYSCALL(n) (maa_stats_syscalls += (n))
+
+/** Count an operation started with MAA_STATS_BEGIN() */
+#define MAA_STATS_END(t, op, bytes, failed) MAA_PROBE_EXIT(failed); \
+    if (t.tv_nsec >= 0) maa_stats_end(op, &t, bytes, failed)
+
+/** Take the start timestamp of an operation.
+ *
+ * @param start set to the current time
+ */
+void maa_stats_begin(struct timespec* start);
+
+/** Add an operation to the counters and the tracer.
+ *
+ * @param op the operation
+ * @param start as set by maa_stats_begin()
+ * @param bytes payload moved
+ * @param failed non zero if the operation failed
+ */
+void maa_stats_end(maa_stats_op_t op, struct timespec* start, unsigned int bytes, int failed);
+
+/** Print the counters to stderr, registered with atexit() for MAA_STATS */
+void maa_stats_report();
+
+/** Pass a message to the log sink if its level and the rate limit allow.
+ *
+ * Nothing is formatted for messages that are dropped.
+ * @param level severity
+ * @param fmt printf format
+ */
+void maa_log(maa_log_level_t level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/** Record a failure as the last error of the thread and log it.
+ *
+ * errno is saved before anything else runs.
+ * @param code result the caller is about to return
+ * @param function failing function
+ * @param fmt printf format, kept unformatted in the last error
+ * @return code
+ */
+maa_result_t maa_fail(maa_result_t code, const char* function, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/** Record a failure of the calling function, evaluates to code */
+#define MAA_FAIL(code, ...) maa_fail(code, __func__, __VA_ARGS__)
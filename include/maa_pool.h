@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "pool.h"
+
+/** Size of each context type, defined next to the struct in its module */
+extern const size_t maa_gpio_context_size;
+extern const size_t maa_pwm_context_size;
+extern const size_t maa_aio_context_size;
+extern const size_t maa_i2c_context_size;
+extern const size_t maa_spi_context_size;
+
+/** Get a zeroed context, from the pool when one is in use, else from the
+ * heap.
+ *
+ * @param type the context type
+ * @return the context or NULL when the pool of that type is used up
+ */
+void* maa_pool_alloc(maa_pool_type_t type);
+
+/** Give back a context obtained with maa_pool_alloc(). A context that is
+ * not part of the pool is freed to the heap.
+ *
+ * @param type the context type
+ * @param ctx the context, may be NULL
+ */
+void maa_pool_free(maa_pool_type_t type, void* ctx);
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "common.h"
+
+/** Pins, mux lines, buses and gpios the shared segment has room for */
+#define MAA_SHM_MAX_PINS 64
+#define MAA_SHM_MAX_MUX 64
+#define MAA_SHM_MAX_BUSES 8
+#define MAA_SHM_MAX_GPIOS 256
+/** Processes that can hold claims on one pin at the same time */
+#define MAA_SHM_MAX_HOLDERS 8
+
+/** Segment name used when none is given */
+#define MAA_SHM_DEFAULT_NAME "/maa"
+/** Mode of a new segment unless MAA_SHM_MODE sets another */
+#define MAA_SHM_DEFAULT_MODE 0660
+
+/**
+ * A process holding claims on a pin
+ */
+typedef struct {
+    pid_t pid; /**< the process, 0 for a free slot */
+    int users; /**< open contexts of that process using the pin */
+} maa_pin_holder_t;
+
+/**
+ * What a physical pin is claimed for
+ */
+typedef struct {
+    maa_pinmodes_t mode; /**< function the pin is set up for */
+    int users; /**< open contexts using the pin in that mode */
+    maa_pin_holder_t holders[MAA_SHM_MAX_HOLDERS]; /**< users split by process */
+} maa_pin_claim_t;
+
+/**
+ * Last level written to a raw gpio
+ */
+typedef struct {
+    volatile int value; /**< the level, -1 when unknown */
+    volatile pid_t pid; /**< process that wrote it, 0 none */
+} maa_gpio_shadow_t;
+
+/**
+ * Last value written to a mux gpio
+ */
+typedef struct {
+    unsigned int gpio; /**< raw gpio of the mux line */
+    unsigned int value; /**< value last written */
+    int pin; /**< physical pin the value was written for */
+} maa_mux_state_t;
+
+/**
+ * Bus types with a lock in the shared segment
+ */
+typedef enum {
+    MAA_SHM_BUS_I2C = 0,
+    MAA_SHM_BUS_SPI = 1
+} maa_shm_bus_t;
+
+/**
+ * Layout of the shared segment, every process attached to the same name sees
+ * the same registry. All mutexes are robust and process shared.
+ */
+typedef struct {
+    /*@{*/
+    volatile uint32_t magic; /**< set once the creator finished initialising */
+    uint32_t size; /**< sizeof this struct, guards against layout changes */
+    pthread_mutex_t lock; /**< guards claims and mux */
+    maa_pin_claim_t claims[MAA_SHM_MAX_PINS]; /**< claims of all processes */
+    maa_mux_state_t mux[MAA_SHM_MAX_MUX]; /**< mux lines set by any process */
+    int mux_len; /**< used entries of mux */
+    pthread_mutex_t bus_lock[2][MAA_SHM_MAX_BUSES]; /**< per bus transaction locks, recursive */
+    maa_gpio_shadow_t gpio_shadow[MAA_SHM_MAX_GPIOS]; /**< last level written per raw gpio */
+    /*@}*/
+} maa_shm_t;
+
+/** Create or attach to the shared segment.
+ *
+ * @param name shm_open() name, NULL for MAA_SHM_DEFAULT_NAME
+ * @return Result of operation
+ */
+maa_result_t maa_shm_open(const char* name);
+
+/** Get the attached segment.
+ *
+ * @return the segment or NULL when not attached
+ */
+maa_shm_t* maa_shm_get();
+
+/** Lock a robust mutex of the segment, recovering it when its holder died.
+ *
+ * @param lock mutex inside the segment
+ */
+void maa_shm_mutex_lock(pthread_mutex_t* lock);
+
+/** Serialise a transaction on a bus with other processes, or only with other
+ * threads when no segment is attached.
+ *
+ * @param type kind of bus
+ * @param bus bus number as used by the kernel device
+ */
+void maa_shm_bus_lock(maa_shm_bus_t type, unsigned int bus);
+
+/** Release a lock taken with maa_shm_bus_lock().
+ *
+ * @param type kind of bus
+ * @param bus bus number as used by the kernel device
+ */
+void maa_shm_bus_unlock(maa_shm_bus_t type, unsigned int bus);
+
+/** Lock a bus around a single transfer so transfers of processes sharing
+ * the segment do not interleave. Nests inside maa_shm_bus_lock().
+ *
+ * @param type kind of bus
+ * @param bus bus number as used by the kernel device
+ * @return the lock to hand to maa_shm_transfer_unlock(), NULL when no segment
+ * is attached and nothing was locked
+ */
+pthread_mutex_t* maa_shm_transfer_lock(maa_shm_bus_t type, unsigned int bus);
+
+/** Release a lock taken with maa_shm_transfer_lock().
+ *
+ * @param lock as returned by maa_shm_transfer_lock(), may be NULL
+ */
+void maa_shm_transfer_unlock(pthread_mutex_t* lock);
+
+/** Shared shadow of a raw gpio.
+ *
+ * @param gpio raw gpio number
+ * @return pointer into the segment or NULL when not attached or out of range
+ */
+maa_gpio_shadow_t* maa_shm_gpio_shadow(unsigned int gpio);
+
+/** Drop what processes that have exited left in the segment.
+ *
+ * Their claims are released and the shadows they wrote become unknown.
+ * Must be called with the segment lock held.
+ */
+void maa_shm_reap();
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <time.h>
+
+#include "trace.h"
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define MAA_PROBE_ENTRY() DTRACE_PROBE1(maa, entry, __func__)
+#define MAA_PROBE_EXIT(failed) DTRACE_PROBE2(maa, exit, __func__, failed)
+#define MAA_PROBE_ISR(pin) DTRACE_PROBE1(maa, isr, pin)
+#else
+#define MAA_PROBE_ENTRY()
+#define MAA_PROBE_EXIT(failed)
+#define MAA_PROBE_ISR(pin)
+#endif
+
+/** Counters are enabled, a bit of maa_instrument */
+#define MAA_INSTRUMENT_STATS 1
+/** Tracer is recording, a bit of maa_instrument */
+#define MAA_INSTRUMENT_TRACE 2
+
+/** What is recording operations, checked before taking timestamps */
+extern volatile int maa_instrument;
+
+/** Record a completed operation in the tracer.
+ *
+ * @param name operation name
+ * @param start when it started
+ * @param end when it ended
+ */
+void maa_trace_record(const char* name, const struct timespec* start, const struct timespec* end);
+
+/** Record an interrupt wakeup in the tracer.
+ *
+ * @param pin pin that fired
+ */
+void maa_trace_isr(int pin);
+
+/** Probe and trace an interrupt wakeup */
+#define MAA_TRACE_ISR(pin) do { \
+    MAA_PROBE_ISR(pin); \
+    if (maa_instrument & MAA_INSTRUMENT_TRACE) \
+        maa_trace_isr(pin); \
+} while (0)
+
+/** Write the trace to the MAA_TRACE file, registered with atexit() */
+void maa_trace_report();
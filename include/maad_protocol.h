@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Wire protocol between libmaa clients and the maad broker. Messages are
+ * exchanged over a SOCK_SEQPACKET unix socket, each one carrying a batch of
+ * requests or the matching batch of responses in the same order.
+ */
+
+#include <stdint.h>
+
+#include "gpio.h"
+
+/** Socket maad listens on unless told otherwise */
+#define MAAD_DEFAULT_SOCKET "/run/maad.sock"
+/** Requests carried by one message */
+#define MAAD_MAX_BATCH 32
+/** Payload bytes of one request or response */
+#define MAAD_MAX_DATA 256
+/** Handles one client can hold */
+#define MAAD_MAX_HANDLES 64
+/** Events the gpio event ring holds, a power of two */
+#define MAAD_RING_SIZE 256
+/** Samples an aio stream ring holds */
+#define MAAD_AIO_RING_SIZE 1024
+
+/**
+ * Operations a client can request, arg and data are per operation
+ */
+typedef enum {
+    MAAD_GPIO_INIT = 1, /**< arg pin, returns handle */
+    MAAD_GPIO_DIR, /**< arg gpio_dir_t */
+    MAAD_GPIO_READ, /**< returns level */
+    MAAD_GPIO_WRITE, /**< arg level */
+    MAAD_GPIO_ISR, /**< arg gpio_edge_t, events go to the ring */
+    MAAD_GPIO_CLOSE,
+    MAAD_AIO_INIT, /**< arg channel, returns handle */
+    MAAD_AIO_READ, /**< returns sample */
+    MAAD_AIO_CLOSE,
+    MAAD_I2C_INIT, /**< arg bus, returns handle */
+    MAAD_I2C_ADDRESS, /**< arg address */
+    MAAD_I2C_READ, /**< arg length, returns length and data */
+    MAAD_I2C_WRITE, /**< data to write */
+    MAAD_I2C_CLOSE,
+    MAAD_SPI_INIT, /**< arg bus, returns handle */
+    MAAD_SPI_TRANSFER, /**< data to send, returns received data */
+    MAAD_SPI_CLOSE,
+    MAAD_EVENTS, /**< returns the event ring fd and its eventfd as rights */
+    MAAD_AIO_STREAM /**< arg interval in us, returns the ring name */
+} maad_op_t;
+
+/**
+ * One request of a batch
+ */
+typedef struct {
+    uint16_t op; /**< maad_op_t */
+    uint16_t len; /**< bytes used in data */
+    int32_t handle; /**< handle the op applies to */
+    int32_t arg; /**< op argument */
+    uint8_t data[MAAD_MAX_DATA]; /**< op payload */
+} maad_req_t;
+
+/**
+ * Response to one request
+ */
+typedef struct {
+    int32_t result; /**< handle, value or maa_result_t, negative on error */
+    uint16_t len; /**< bytes used in data */
+    uint8_t data[MAAD_MAX_DATA]; /**< returned payload */
+} maad_resp_t;
+
+/**
+ * A batch of requests as sent on the socket, only count entries are sent
+ */
+typedef struct {
+    uint32_t count; /**< requests in the batch */
+    maad_req_t req[MAAD_MAX_BATCH]; /**< the requests */
+} maad_req_msg_t;
+
+/**
+ * A batch of responses as sent on the socket, only count entries are sent
+ */
+typedef struct {
+    uint32_t count; /**< responses in the batch */
+    maad_resp_t resp[MAAD_MAX_BATCH]; /**< the responses */
+} maad_resp_msg_t;
+
+/**
+ * Single producer single consumer ring of gpio events shared between maad
+ * and one client. The index of each event is the handle of the gpio.
+ */
+typedef struct {
+    volatile uint32_t head; /**< next slot maad writes */
+    volatile uint32_t tail; /**< next slot the client reads */
+    volatile uint32_t dropped; /**< events lost because the ring was full */
+    maa_gpio_event_t events[MAAD_RING_SIZE]; /**< the slots */
+} maad_ring_t;
@@ -23,26 +23,38 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "aio.h"
 #include "maa_internal.h"
+#include "maa_pool.h"
 
 struct _aio {
     unsigned int channel;
     int adc_in_fp;
+    int aio; /**< analog input as passed to init */
+    pthread_t export_thread; /**< sampling thread of maa_aio_export() */
+    maa_ring_context export_ring; /**< ring samples go to, NULL if not exporting */
+    unsigned int export_interval; /**< microseconds between samples */
+    volatile int export_stop; /**< asks the sampling thread to finish */
 };
 
+const size_t maa_aio_context_size = sizeof(struct _aio);
+
 static maa_result_t aio_get_valid_fp(maa_aio_context dev)
 {
-    char file_path[64]= "";
+    char file_path[128]= "";
 
     //Open file Analog device input channel raw voltage file for reading.
-    snprintf(file_path, 64, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw",
-        dev->channel );
+    snprintf(file_path, sizeof(file_path), "%s/sys/bus/iio/devices/iio:device0/in_voltage%d_raw",
+        maa_sysfs_root(), dev->channel );
 
     dev->adc_in_fp = open(file_path, O_RDONLY);
+    MAA_STATS_SYSCALL(1);
     if (dev->adc_in_fp == -1) {
 	fprintf(stderr, "Failed to open Analog input raw file %s for "
 	    "reading!\n", file_path); return( MAA_ERROR_INVALID_RESOURCE);
@@ -79,34 +91,32 @@ maa_aio_context maa_aio_init(unsigned int aio_channel)
     }
 
     //Create ADC device connected to specified channel
-    maa_aio_context dev = malloc(sizeof(struct _aio));
+    maa_aio_context dev = (maa_aio_context) maa_pool_alloc(MAA_POOL_AIO);
     if (dev == NULL) {
         fprintf(stderr, "Insufficient memory for specified Analog input channel "
             "%d\n", aio_channel);
+        maa_release_aio(aio_channel);
         return NULL;
     }
     dev->channel = checked_pin;
+    dev->aio = aio_channel;
+    dev->export_ring = NULL;
 
     //Open valid  analog input file and get the pointer.
     if (MAA_SUCCESS != aio_get_valid_fp(dev)) {
-        free(dev);
+        maa_release_aio(aio_channel);
+        maa_pool_free(MAA_POOL_AIO, dev);
         return NULL;
     }
 
     return dev;
 }
 
-/** Read the input voltage, represented as an unsigned short in the range [0x0,
- * 0xFFFF]
- *
- * @param pointer to maa_aio_context structure  initialised by
- * maa_aio_init()
- *
- * @returns
- *   unsigned 16 bit int representing the current input voltage, normalised to
- *   a 16-bit value
+/*
+ * Read and scale one sample, failed is set when the value could not be read
  */
-uint16_t maa_aio_read(maa_aio_context dev)
+static uint16_t
+maa_aio_read_value(maa_aio_context dev, int* failed)
 {
     char buffer[16];
     unsigned int shifter_value = 0;
@@ -115,20 +125,30 @@ uint16_t maa_aio_read(maa_aio_context dev)
         aio_get_valid_fp(dev);
     }
 
+    MAA_STATS_BEGIN(start);
     lseek(dev->adc_in_fp, 0, SEEK_SET);
-    if (read(dev->adc_in_fp, buffer, sizeof(buffer)) < 1) {
-        fprintf(stderr, "Failed to read a sensible value\n");
+    ssize_t got = read(dev->adc_in_fp, buffer, sizeof(buffer) - 1);
+    MAA_STATS_SYSCALL(2);
+    *failed = got < 1;
+    if (*failed) {
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to read analog input %d", dev->aio);
+        got = 0;
     }
+    buffer[got] = '\0';
     lseek(dev->adc_in_fp, 0, SEEK_SET);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_AIO_READ, sizeof(uint16_t), *failed);
 
     errno = 0;
     char *end;
     uint16_t analog_value = (uint16_t) strtoul(buffer, &end, 10);
-    if (end == &buffer[0]) {
-        fprintf(stderr, "%s is not a decimal number\n", buffer);
+    if (!*failed && end == &buffer[0]) {
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Analog input %d is not a decimal number", dev->aio);
+        *failed = 1;
     }
     else if (errno != 0) {
-        fprintf(stderr, "errno was set\n");
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Analog input %d out of range", dev->aio);
+        *failed = 1;
     }
 
     /* Adjust the raw analog input reading to supported resolution value*/
@@ -143,6 +163,83 @@ uint16_t maa_aio_read(maa_aio_context dev)
     return analog_value;
 }
 
+/** Read the input voltage, represented as an unsigned short in the range [0x0,
+ * 0xFFFF]
+ *
+ * @param pointer to maa_aio_context structure  initialised by
+ * maa_aio_init()
+ *
+ * @returns
+ *   unsigned 16 bit int representing the current input voltage, normalised to
+ *   a 16-bit value
+ */
+uint16_t maa_aio_read(maa_aio_context dev)
+{
+    int failed;
+    return maa_aio_read_value(dev, &failed);
+}
+
+static void*
+maa_aio_export_loop(void* arg)
+{
+    maa_aio_context dev = (maa_aio_context) arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!dev->export_stop) {
+        maa_aio_sample_t sample;
+        memset(&sample, 0, sizeof(sample));
+        int failed;
+        sample.value = maa_aio_read_value(dev, &failed);
+        sample.failed = failed;
+        clock_gettime(CLOCK_MONOTONIC, &sample.timestamp);
+        maa_ring_publish(dev->export_ring, &sample);
+
+        // absolute deadlines so the read time does not add up as drift
+        next.tv_nsec += (long) dev->export_interval * 1000;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+maa_result_t
+maa_aio_export(maa_aio_context dev, maa_ring_context ring, unsigned int interval_us)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (ring == NULL || maa_ring_record_size(ring) != sizeof(maa_aio_sample_t) ||
+        interval_us == 0)
+        return MAA_ERROR_INVALID_PARAMETER;
+    if (dev->export_ring != NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    dev->export_ring = ring;
+    dev->export_interval = interval_us;
+    dev->export_stop = 0;
+    if (pthread_create(&dev->export_thread, NULL, maa_aio_export_loop, dev) != 0) {
+        dev->export_ring = NULL;
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_aio_export_stop(maa_aio_context dev)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (dev->export_ring == NULL)
+        return MAA_SUCCESS;
+    dev->export_stop = 1;
+    pthread_join(dev->export_thread, NULL);
+    dev->export_ring = NULL;
+    return MAA_SUCCESS;
+}
+
 /** Close the analog input and free context memory
  *
  * @param dev - the analog input context
@@ -151,8 +248,11 @@ uint16_t maa_aio_read(maa_aio_context dev)
  */
 maa_result_t maa_aio_close(maa_aio_context dev)
 {
-    if (NULL != dev)
-        free(dev);
+    if (NULL != dev) {
+        maa_aio_export_stop(dev);
+        maa_release_aio(dev->aio);
+        maa_pool_free(MAA_POOL_AIO, dev);
+    }
 
     return(MAA_SUCCESS);
 }
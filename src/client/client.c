@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "client.h"
+#include "maad_protocol.h"
+
+/**
+ * A connection to maad
+ */
+struct _client {
+    /*@{*/
+    int fd; /**< the seqpacket socket */
+    pthread_mutex_t lock; /**< one call on the socket at a time */
+    maa_boolean_t batching; /**< queue calls until flushed */
+    maa_result_t batch_result; /**< first failure of queued calls */
+    maad_req_msg_t req; /**< calls to send */
+    maad_resp_msg_t resp; /**< responses of the last exchange */
+    maad_ring_t* ring; /**< gpio events shared with maad */
+    int event_fd; /**< signalled by maad when it pushes events */
+    /*@}*/
+};
+
+maa_client_context
+maa_client_connect(const char* path)
+{
+    if (path == NULL)
+        path = getenv("MAAD_SOCKET");
+    if (path == NULL)
+        path = MAAD_DEFAULT_SOCKET;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return NULL;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd == -1)
+        return NULL;
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    maa_client_context client = (maa_client_context) calloc(1, sizeof(struct _client));
+    if (client == NULL) {
+        close(fd);
+        return NULL;
+    }
+    client->fd = fd;
+    client->event_fd = -1;
+    pthread_mutex_init(&client->lock, NULL);
+    return client;
+}
+
+maa_result_t
+maa_client_close(maa_client_context client)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (client->ring != NULL)
+        munmap(client->ring, sizeof(maad_ring_t));
+    if (client->event_fd != -1)
+        close(client->event_fd);
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+    return MAA_SUCCESS;
+}
+
+/*
+ * Send the queued requests and wait for their responses, fds passed along
+ * with the responses are stored in fds. Failures of queued calls are kept for
+ * maa_client_batch_flush(), except for the last one when the caller waits on it.
+ */
+static maa_result_t
+maa_client_exchange(maa_client_context client, int* fds, int nfds, maa_boolean_t owned)
+{
+    size_t len = offsetof(maad_req_msg_t, req) + client->req.count * sizeof(maad_req_t);
+    uint32_t count = client->req.count;
+    if (count == 0)
+        return MAA_SUCCESS;
+    ssize_t sent = send(client->fd, &client->req, len, MSG_NOSIGNAL);
+    client->req.count = 0;
+    if (sent != (ssize_t) len)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct iovec iov = { &client->resp, sizeof(client->resp) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t got = recvmsg(client->fd, &msg, 0);
+    if (got < (ssize_t) offsetof(maad_resp_msg_t, resp) || client->resp.count != count)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (fds != NULL && cmsg != NULL && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+
+    uint32_t i;
+    for (i = 0; i + (owned ? 1 : 0) < count; i++)
+        if (client->resp.resp[i].result < 0 && client->batch_result == MAA_SUCCESS)
+            client->batch_result = (maa_result_t) -client->resp.resp[i].result;
+    return MAA_SUCCESS;
+}
+
+/*
+ * Append a request to the batch, sending the batch first when it is full.
+ * Returns the index of the request or -1. Called with the lock held.
+ */
+static int
+maa_client_queue(maa_client_context client, maad_op_t op, int handle, int arg,
+                 const uint8_t* data, int len)
+{
+    if (len < 0 || len > MAAD_MAX_DATA)
+        return -1;
+    if (client->req.count == MAAD_MAX_BATCH &&
+        maa_client_exchange(client, NULL, 0, 0) != MAA_SUCCESS)
+        return -1;
+
+    maad_req_t* req = &client->req.req[client->req.count];
+    req->op = op;
+    req->handle = handle;
+    req->arg = arg;
+    req->len = len;
+    if (len > 0)
+        memcpy(req->data, data, len);
+    return client->req.count++;
+}
+
+/*
+ * Queue a request and, unless it only needs to be queued, send the batch and
+ * return the response to it. Called with the lock held.
+ */
+static maad_resp_t*
+maa_client_call(maa_client_context client, maad_op_t op, int handle, int arg,
+                const uint8_t* data, int len, maa_boolean_t queue_only)
+{
+    static maad_resp_t queued = { .result = 0 };
+    static maad_resp_t failed = { .result = -MAA_ERROR_INVALID_RESOURCE };
+
+    int index = maa_client_queue(client, op, handle, arg, data, len);
+    if (index == -1)
+        return &failed;
+    if (queue_only && client->batching)
+        return &queued;
+    if (maa_client_exchange(client, NULL, 0, 1) != MAA_SUCCESS)
+        return &failed;
+    return &client->resp.resp[index];
+}
+
+static maa_result_t
+maa_client_result(int32_t result)
+{
+    return result < 0 ? (maa_result_t) -result : MAA_SUCCESS;
+}
+
+static int
+maa_client_simple(maa_client_context client, maad_op_t op, int handle, int arg,
+                  maa_boolean_t queue_only)
+{
+    if (client == NULL)
+        return -MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    int32_t result = maa_client_call(client, op, handle, arg, NULL, 0, queue_only)->result;
+    pthread_mutex_unlock(&client->lock);
+    return result;
+}
+
+maa_result_t
+maa_client_batch_begin(maa_client_context client)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    client->batching = 1;
+    pthread_mutex_unlock(&client->lock);
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_client_batch_flush(maa_client_context client)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    maa_result_t ret = maa_client_exchange(client, NULL, 0, 0);
+    if (ret == MAA_SUCCESS)
+        ret = client->batch_result;
+    client->batch_result = MAA_SUCCESS;
+    client->batching = 0;
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+int
+maa_client_gpio_init(maa_client_context client, int pin)
+{
+    int32_t result = maa_client_simple(client, MAAD_GPIO_INIT, -1, pin, 0);
+    return result < 0 ? -1 : result;
+}
+
+maa_result_t
+maa_client_gpio_dir(maa_client_context client, int gpio, gpio_dir_t dir)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_GPIO_DIR, gpio, dir, 1));
+}
+
+int
+maa_client_gpio_read(maa_client_context client, int gpio)
+{
+    int32_t result = maa_client_simple(client, MAAD_GPIO_READ, gpio, 0, 0);
+    return result < 0 ? -1 : result;
+}
+
+maa_result_t
+maa_client_gpio_write(maa_client_context client, int gpio, int value)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_GPIO_WRITE, gpio, value, 1));
+}
+
+static maa_result_t
+maa_client_map_events(maa_client_context client)
+{
+    int fds[2] = { -1, -1 };
+    int index = maa_client_queue(client, MAAD_EVENTS, -1, 0, NULL, 0);
+    if (index == -1 || maa_client_exchange(client, fds, 2, 1) != MAA_SUCCESS ||
+        client->resp.resp[index].result < 0 || fds[0] == -1)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    void* ring = mmap(NULL, sizeof(maad_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (ring == MAP_FAILED) {
+        close(fds[1]);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    client->ring = (maad_ring_t*) ring;
+    client->event_fd = fds[1];
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_client_gpio_isr(maa_client_context client, int gpio, gpio_edge_t edge)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    maa_result_t ret = MAA_SUCCESS;
+    if (client->ring == NULL)
+        ret = maa_client_map_events(client);
+    if (ret == MAA_SUCCESS)
+        ret = maa_client_result(maa_client_call(client, MAAD_GPIO_ISR, gpio, edge, NULL, 0, 0)->result);
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+int
+maa_client_gpio_events(maa_client_context client, maa_gpio_event_t* events, int max)
+{
+    if (client == NULL || client->ring == NULL)
+        return -1;
+    maad_ring_t* ring = client->ring;
+    int n = 0;
+    while (n < max && ring->tail != ring->head) {
+        __sync_synchronize();
+        events[n++] = ring->events[ring->tail % MAAD_RING_SIZE];
+        __sync_synchronize();
+        ring->tail++;
+    }
+    return n;
+}
+
+int
+maa_client_gpio_event_fd(maa_client_context client)
+{
+    if (client == NULL)
+        return -1;
+    return client->event_fd;
+}
+
+maa_result_t
+maa_client_gpio_close(maa_client_context client, int gpio)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_GPIO_CLOSE, gpio, 0, 1));
+}
+
+int
+maa_client_aio_init(maa_client_context client, unsigned int channel)
+{
+    int32_t result = maa_client_simple(client, MAAD_AIO_INIT, -1, channel, 0);
+    return result < 0 ? -1 : result;
+}
+
+uint16_t
+maa_client_aio_read(maa_client_context client, int aio)
+{
+    int32_t result = maa_client_simple(client, MAAD_AIO_READ, aio, 0, 0);
+    return result < 0 ? 0 : (uint16_t) result;
+}
+
+maa_ring_context
+maa_client_aio_stream(maa_client_context client, int aio, unsigned int interval_us)
+{
+    if (client == NULL)
+        return NULL;
+    pthread_mutex_lock(&client->lock);
+    maad_resp_t* resp = maa_client_call(client, MAAD_AIO_STREAM, aio, interval_us, NULL, 0, 0);
+    char name[MAAD_MAX_DATA + 1];
+    int ok = resp->result >= 0 && resp->len > 0;
+    if (ok) {
+        memcpy(name, resp->data, resp->len);
+        name[resp->len] = '\0';
+    }
+    pthread_mutex_unlock(&client->lock);
+    return ok ? maa_ring_attach(name) : NULL;
+}
+
+maa_result_t
+maa_client_aio_close(maa_client_context client, int aio)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_AIO_CLOSE, aio, 0, 1));
+}
+
+int
+maa_client_i2c_init(maa_client_context client, int bus)
+{
+    int32_t result = maa_client_simple(client, MAAD_I2C_INIT, -1, bus, 0);
+    return result < 0 ? -1 : result;
+}
+
+maa_result_t
+maa_client_i2c_address(maa_client_context client, int i2c, int address)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_I2C_ADDRESS, i2c, address, 1));
+}
+
+int
+maa_client_i2c_read(maa_client_context client, int i2c, uint8_t* data, int length)
+{
+    if (client == NULL || length < 0 || length > MAAD_MAX_DATA)
+        return 0;
+    pthread_mutex_lock(&client->lock);
+    maad_resp_t* resp = maa_client_call(client, MAAD_I2C_READ, i2c, length, NULL, 0, 0);
+    int ret = 0;
+    if (resp->result > 0 && resp->len <= length) {
+        memcpy(data, resp->data, resp->len);
+        ret = resp->len;
+    }
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+maa_result_t
+maa_client_i2c_write(maa_client_context client, int i2c, const uint8_t* data, int length)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    int32_t result = maa_client_call(client, MAAD_I2C_WRITE, i2c, 0, data, length, 1)->result;
+    pthread_mutex_unlock(&client->lock);
+    return maa_client_result(result);
+}
+
+maa_result_t
+maa_client_i2c_close(maa_client_context client, int i2c)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_I2C_CLOSE, i2c, 0, 1));
+}
+
+int
+maa_client_spi_init(maa_client_context client, int bus)
+{
+    int32_t result = maa_client_simple(client, MAAD_SPI_INIT, -1, bus, 0);
+    return result < 0 ? -1 : result;
+}
+
+maa_result_t
+maa_client_spi_transfer(maa_client_context client, int spi, const uint8_t* data, uint8_t* rxbuf, int length)
+{
+    if (client == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    pthread_mutex_lock(&client->lock);
+    maad_resp_t* resp = maa_client_call(client, MAAD_SPI_TRANSFER, spi, 0, data, length, 0);
+    maa_result_t ret = maa_client_result(resp->result);
+    if (ret == MAA_SUCCESS) {
+        if (resp->len == length)
+            memcpy(rxbuf, resp->data, length);
+        else
+            ret = MAA_ERROR_INVALID_RESOURCE;
+    }
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+maa_result_t
+maa_client_spi_close(maa_client_context client, int spi)
+{
+    return maa_client_result(maa_client_simple(client, MAAD_SPI_CLOSE, spi, 0, 1));
+}
@@ -22,23 +22,59 @@
  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+#define _GNU_SOURCE
 #include "gpio.h"
+#include "gpio_fast.h"
 #include "maa_internal.h"
+#include "maa_pool.h"
+#include "maa_shm.h"
 
 #include <stdlib.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
 #define SYSFS_CLASS_GPIO "/sys/class/gpio"
-#define MAX_SIZE 64
+#define MAX_SIZE 128
 #define POLL_TIMEOUT
 
+/**
+ * Kind of thread started for the interrupts of a context
+ */
+typedef enum {
+    MAA_GPIO_THREAD_NONE      = 0, /**< no thread */
+    MAA_GPIO_THREAD_SYSFS     = 1, /**< edge watcher on the value file */
+    MAA_GPIO_THREAD_BUSY_POLL = 2  /**< spins on the mapped register */
+} maa_gpio_thread_t;
+
+/**
+ * State of a busy poll thread. Copied out of the context so the thread
+ * never touches it after the isr has exited or closed it, the thread frees
+ * it on the way out.
+ */
+typedef struct {
+    /*@{*/
+    volatile uint32_t* regs; /**< the mapped register page */
+    uint32_t mask; /**< bit of the pin */
+    uint32_t last; /**< level seen last, sampled before the thread starts */
+    gpio_edge_t edge; /**< edges to report */
+    int cpu; /**< cpu to pin the thread to, -1 none */
+    unsigned int yield; /**< polls between sched_yield, 0 never */
+    void (*isr)(void*); /**< the callback */
+    void* isr_args; /**< passed to isr */
+    int pin; /**< reported to the tracer */
+    volatile int stop; /**< asks the thread to exit */
+    /*@}*/
+} maa_gpio_busy_t;
+
 /**
  * A structure representing a gpio pin.
  */
@@ -51,21 +87,82 @@ struct _gpio {
     void (* isr)(void *); /**< the interupt service request */
     void *isr_args; /**< args return when interupt service request triggered */
     pthread_t thread_id; /**< the isr handler thread id */
+    maa_gpio_thread_t isr_thread; /**< which kind of thread thread_id is */
     int isr_value_fp; /**< the isr file pointer on the value */
+    short isr_events; /**< poll events signalling an edge on isr_value_fp */
     maa_boolean_t owner; /**< If this context originally exported the pin */
     maa_boolean_t mmap;
     void *reg;
     unsigned int reg_sz;
     unsigned int reg_bit_pos;
+    maa_boolean_t shadow; /**< skip writes that do not change the level */
+    maa_gpio_shadow_t* shadow_value; /**< last level written and its writer */
+    maa_gpio_shadow_t shadow_local; /**< shadow storage when not shared between processes */
+    maa_boolean_t output; /**< direction was last set to output */
+    maa_boolean_t cache; /**< reads are answered from cache_value */
+    volatile int cache_value; /**< level seen by the edge watcher, -1 unknown */
+    gpio_isr_mode_t isr_mode; /**< how interrupts are delivered */
+    maa_boolean_t uio_isr; /**< isr registered with the uio dispatcher */
+    int busy_cpu; /**< cpu the busy poll thread is pinned to, -1 none */
+    unsigned int busy_yield; /**< polls between sched_yield, 0 never */
+    maa_gpio_busy_t* busy; /**< state of the busy poll thread, NULL none */
+    maa_boolean_t multi_isr; /**< part of a maa_gpio_isr_multi group */
+    int mux_line; /**< raw gpio of a mux line this context changes, -1 none */
+    /*@}*/
+};
+
+const size_t maa_gpio_context_size = sizeof(struct _gpio);
+
+/**
+ * A group of gpios sharing one callback and one dispatcher thread.
+ */
+struct _gpio_multi {
+    /*@{*/
+    maa_gpio_context* devs; /**< the gpios of the group */
+    struct pollfd* fds; /**< value file of each gpio, same order as devs */
+    unsigned int n; /**< number of gpios */
+    maa_gpio_multi_isr_t cb; /**< callback for every edge */
+    void* user; /**< passed back to cb */
+    pthread_t thread_id; /**< the dispatcher thread */
+    volatile int stop; /**< exited from a callback, the thread frees the group */
     /*@}*/
 };
 
+/** Process id stamped on shadows, kept here so writes need no syscall */
+static pid_t maa_gpio_pid = 0;
+static pthread_once_t maa_gpio_pid_once = PTHREAD_ONCE_INIT;
+
+static void
+maa_gpio_pid_refresh()
+{
+    maa_gpio_pid = getpid();
+}
+
+static void
+maa_gpio_pid_init()
+{
+    maa_gpio_pid_refresh();
+    pthread_atfork(NULL, NULL, maa_gpio_pid_refresh);
+}
+
+/**
+ * Record the last level written so other processes can skip rewriting it.
+ * The writer is stamped so the level is forgotten once it exits.
+ */
+static void
+maa_gpio_shadow_set(maa_gpio_context dev, int value)
+{
+    dev->shadow_value->value = value;
+    dev->shadow_value->pid = value == -1 ? 0 : maa_gpio_pid;
+}
+
 static maa_result_t
 maa_gpio_get_valfp(maa_gpio_context dev)
 {
     char bu[MAX_SIZE];
-    sprintf(bu, SYSFS_CLASS_GPIO "/gpio%d/value", dev->pin);
+    snprintf(bu, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/value", maa_sysfs_root(), dev->pin);
     dev->value_fp = open(bu, O_RDWR);
+    MAA_STATS_SYSCALL(1);
     if (dev->value_fp == -1) {
         return MAA_ERROR_INVALID_RESOURCE;
     }
@@ -81,12 +178,21 @@ maa_gpio_init(int pin)
         return NULL;
 
     maa_gpio_context r = maa_gpio_init_raw(pinm);
+    if (r == NULL) {
+        maa_release_pin(pin);
+        return NULL;
+    }
     r->phy_pin = pin;
     return r;
 }
 
-maa_gpio_context
-maa_gpio_init_raw(int pin)
+/*
+ * Open a raw gpio. Contexts the library keeps for itself come from the heap
+ * so they never use up the pool the application sized, maa_pool_free()
+ * tells them apart.
+ */
+static maa_gpio_context
+maa_gpio_init_context(int pin, maa_boolean_t pooled)
 {
     if (pin < 0)
         return NULL;
@@ -94,116 +200,214 @@ maa_gpio_init_raw(int pin)
     char bu[MAX_SIZE];
     int length;
 
-    maa_gpio_context dev = (maa_gpio_context) malloc(sizeof(struct _gpio));
-    memset(dev, 0, sizeof(struct _gpio));
+    maa_gpio_context dev;
+    if (pooled)
+        dev = (maa_gpio_context) maa_pool_alloc(MAA_POOL_GPIO);
+    else
+        dev = (maa_gpio_context) calloc(1, sizeof(struct _gpio));
+    if (dev == NULL)
+        return NULL;
     dev->value_fp = -1;
     dev->isr_value_fp = -1;
+    dev->shadow_local.value = -1;
+    pthread_once(&maa_gpio_pid_once, maa_gpio_pid_init);
+    // with shared memory every process sees the last level written
+    dev->shadow_value = maa_shm_gpio_shadow(pin);
+    if (dev->shadow_value == NULL)
+        dev->shadow_value = &dev->shadow_local;
+    dev->cache_value = -1;
+    dev->busy_cpu = -1;
     dev->pin = pin;
     dev->phy_pin = -1;
+    // writes to a mux line go behind the back of the mux cache
+    dev->mux_line = maa_mux_gpio(pin) ? pin : -1;
 
     char directory[MAX_SIZE];
-    snprintf(directory, MAX_SIZE, SYSFS_CLASS_GPIO "/gpio%d/", dev->pin);
+    snprintf(directory, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/", maa_sysfs_root(), dev->pin);
     struct stat dir;
     if (stat(directory, &dir) == 0 && S_ISDIR(dir.st_mode)) {
         //fprintf(stderr, "GPIO Pin already exporting, continuing.\n");
         dev->owner = 0; // Not Owner
     } else {
-        int export = open(SYSFS_CLASS_GPIO "/export", O_WRONLY);
+        snprintf(bu, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/export", maa_sysfs_root());
+        int export = open(bu, O_WRONLY);
         if (export == -1) {
             fprintf(stderr, "Failed to open export for writing!\n");
+            maa_pool_free(MAA_POOL_GPIO, dev);
             return NULL;
         }
         length = snprintf(bu, sizeof(bu), "%d", dev->pin);
         if (write(export, bu, length*sizeof(char)) == -1) {
             fprintf(stderr, "Failed to write to export\n");
             close(export);
+            maa_pool_free(MAA_POOL_GPIO, dev);
             return NULL;
         }
         dev->owner = 1;
         close(export);
+
+        // udev may still be creating or chmod'ing the attributes
+        const char* attrs[] = { "direction", "value" };
+        int i;
+        for (i = 0; i < 2; i++) {
+            snprintf(bu, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/%s", maa_sysfs_root(), dev->pin, attrs[i]);
+            if (maa_wait_for_file(bu, R_OK | W_OK, MAA_SYSFS_READY_TIMEOUT_MS) != MAA_SUCCESS) {
+                maa_gpio_close(dev);
+                return NULL;
+            }
+        }
     }
     return dev;
 }
 
+maa_gpio_context
+maa_gpio_init_raw(int pin)
+{
+    return maa_gpio_init_context(pin, 1);
+}
+
+maa_gpio_context
+maa_gpio_init_internal(int gpio)
+{
+    return maa_gpio_init_context(gpio, 0);
+}
+
+maa_gpio_context
+maa_gpio_init_mux(int gpio)
+{
+    maa_gpio_context dev = maa_gpio_init_context(gpio, 0);
+    if (dev != NULL)
+        dev->mux_line = -1;
+    return dev;
+}
+
+/**
+ * All mmaped contexts share one mapping of the gpio register page so that
+ * their register pointers compare equal and masks of pins in the same
+ * register can be combined in a single atomic update.
+ */
+static pthread_mutex_t mmap_lock = PTHREAD_MUTEX_INITIALIZER;
+static void* mmap_base = NULL;
+static unsigned int mmap_sz = 0;
+static int mmap_refs = 0;
+static const char* mmap_dev = NULL;
+
+/**
+ * One thread serves the interrupts of every pin using MAA_GPIO_ISR_UIO by
+ * blocking on the uio device, contexts are found by their bit in the
+ * interrupt status register.
+ */
+static pthread_mutex_t uio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uio_idle = PTHREAD_COND_INITIALIZER;
+static maa_gpio_context uio_pins[DW_GPIO_PINS];
+static uint32_t uio_both_edges = 0;
+static int uio_fd = -1;
+static int uio_count = 0;
+static int uio_running = -1; /**< bit whose isr is being called, -1 none */
+static int uio_irqcontrol = 1; /**< the device takes writes rearming the irq */
+static pthread_t uio_thread;
+
 static maa_result_t
 maa_gpio_write_register(maa_gpio_context dev,int value)
 {
+    // the register is shared with other pins, a plain read-modify-write
+    // could undo a concurrent write to one of them
+    uint32_t bit = (uint32_t) 1 << dev->reg_bit_pos;
     if (value == 1) {
-        *((unsigned *)dev->reg) |= (1<<dev->reg_bit_pos);
+        __sync_fetch_and_or((volatile uint32_t*) dev->reg, bit);
         return MAA_SUCCESS;
     }
-    *((unsigned *)dev->reg) &= ~(1<<dev->reg_bit_pos);
+    __sync_fetch_and_and((volatile uint32_t*) dev->reg, ~bit);
     return MAA_SUCCESS;
 }
 
-static maa_result_t
-maa_gpio_wait_interrupt(int fd)
+static void
+maa_gpio_read_level(maa_gpio_context dev, int fd)
 {
     unsigned char c;
-    struct pollfd pfd;
 
-    // setup poll on POLLPRI
-    pfd.fd = fd;
-    pfd.events = POLLPRI;
+    // value has to be read from the start for sysfs to rearm the poll
+    lseek(fd, 0, SEEK_SET);
+    if (read(fd, &c, 1) == 1 && dev->cache && (c == '0' || c == '1'))
+        dev->cache_value = (c == '1') ? 1 : 0;
+}
+
+/**
+ * Open the value file of dev to wait for edges on. A FIFO stands in for the
+ * value file in a simulated tree, every byte written to it is the level
+ * after one edge. Opening it read-write neither blocks for nor loses the
+ * writer.
+ *
+ * @param events set to the poll events that signal an edge
+ * @return the descriptor, -1 on failure
+ */
+static int
+maa_gpio_open_edge_fd(maa_gpio_context dev, short* events)
+{
+    char bu[MAX_SIZE];
+    struct stat st;
+
+    snprintf(bu, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/value", maa_sysfs_root(), dev->pin);
+    if (stat(bu, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        *events = POLLIN;
+        return open(bu, O_RDWR | O_NONBLOCK);
+    }
+    *events = POLLPRI;
+    return open(bu, O_RDONLY);
+}
 
-    // do an initial read to clear interupt
-    read (fd, &c, 1);
+static maa_result_t
+maa_gpio_wait_interrupt(maa_gpio_context dev, int fd)
+{
+    struct pollfd pfd;
 
     if (fd <= 0) {
         return MAA_ERROR_INVALID_RESOURCE;
     }
 
+    pfd.fd = fd;
+    pfd.events = dev->isr_events;
+
+    // do an initial read to clear interupt, this also catches any edge
+    // missed while the last handler ran
+    maa_gpio_read_level(dev, fd);
+
     // Wait for it forever or until pthread_cancel
     // poll is a cancelable point like sleep()
     int x = poll (&pfd, 1, -1);
 
     // do a final read to clear interupt
-    read (fd, &c, 1);
+    maa_gpio_read_level(dev, fd);
 
     return MAA_SUCCESS;
 }
 
+static void
+maa_gpio_call_isr(maa_gpio_context dev)
+{
+    MAA_TRACE_ISR(dev->phy_pin >= 0 ? dev->phy_pin : dev->pin);
+    dev->isr(dev->isr_args);
+}
+
 static void*
 maa_gpio_interrupt_handler(void* arg)
 {
     maa_gpio_context dev = (maa_gpio_context) arg;
     maa_result_t ret;
 
-    // open gpio value with open(3)
-    char bu[MAX_SIZE];
-    sprintf(bu, SYSFS_CLASS_GPIO "/gpio%d/value", dev->pin);
-    dev->isr_value_fp = open(bu, O_RDONLY);
+    dev->isr_value_fp = maa_gpio_open_edge_fd(dev, &dev->isr_events);
 
     for (;;) {
-        ret = maa_gpio_wait_interrupt(dev->isr_value_fp);
-        if (ret == MAA_SUCCESS) {
+        ret = maa_gpio_wait_interrupt(dev, dev->isr_value_fp);
+        if (ret == MAA_SUCCESS && dev->isr == NULL) {
+            // only keeping the input cache up to date
+            continue;
+        } else if (ret == MAA_SUCCESS) {
             pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-#ifdef SWIGPYTHON
-            // In order to call a python object (all python functions are objects) we
-            // need to aquire the GIL (Global Interpreter Lock). This may not always be
-            // nessecary but especially if doing IO (like print()) python will segfault
-            // if we do not hold a lock on the GIL
-            PyGILState_STATE gilstate = PyGILState_Ensure();
-            PyObject *arglist;
-            PyObject *ret;
-            arglist = Py_BuildValue("(i)", dev->isr_args);
-			if (arglist == NULL) {
-				fprintf(stdout, "Py_BuildValue NULL\n");
-			} else {
-                ret = PyEval_CallObject((PyObject*)dev->isr, arglist);
-                if (ret == NULL) {
-                    fprintf(stdout, "PyEval_CallObject failed\n");
-                } else {
-                    Py_DECREF(ret);
-                }
-                Py_DECREF(arglist);
-            }
-
-            PyGILState_Release (gilstate);
-#else
-            dev->isr(dev->isr_args);
-#endif
+            maa_gpio_call_isr(dev);
             pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+            // the isr may have exited or closed dev, leave before touching it
+            pthread_testcancel();
         } else {
         // we must have got an error code so die nicely
             pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
@@ -214,6 +418,214 @@ maa_gpio_interrupt_handler(void* arg)
     }
 }
 
+static void
+maa_gpio_uio_close(void* arg)
+{
+    close(*(int*) arg);
+}
+
+static void*
+maa_gpio_uio_dispatcher(void* arg)
+{
+    volatile uint32_t* regs = (volatile uint32_t*) arg;
+    const uint32_t enable = 1;
+    uint32_t count;
+    int fd = uio_fd;
+    int irqcontrol = uio_irqcontrol;
+
+    // the device is closed however the thread ends
+    pthread_cleanup_push(maa_gpio_uio_close, &fd);
+    for (;;) {
+        // rearm the irq line then block until it fires, read() is a
+        // cancellation point. Without irqcontrol the driver answers EIO and
+        // the line is never disabled, so there is nothing to rearm
+        if (irqcontrol && write(fd, &enable, sizeof(enable)) != sizeof(enable)) {
+            if (errno != EIO) {
+                fprintf(stderr, "Failed to rearm uio interrupt\n");
+                break;
+            }
+            irqcontrol = 0;
+        }
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+            fprintf(stderr, "Failed to wait for uio interrupt\n");
+            break;
+        }
+
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        uint32_t status = regs[DW_GPIO_INTSTATUS];
+        regs[DW_GPIO_PORTA_EOI] = status;
+
+        int bit;
+        for (bit = 0; bit < DW_GPIO_PINS; bit++) {
+            uint32_t mask = (uint32_t) 1 << bit;
+            if ((status & mask) == 0)
+                continue;
+            // the controller only knows one edge, wait for the other next
+            if (uio_both_edges & mask)
+                __sync_fetch_and_xor(&regs[DW_GPIO_INT_POLARITY], mask);
+
+            // call without the lock so the isr may exit or close its own
+            // pin, unregistering waits for uio_running to clear instead
+            void (*isr)(void*) = NULL;
+            void* isr_args = NULL;
+            int pin = 0;
+            pthread_mutex_lock(&uio_lock);
+            if (uio_pins[bit] != NULL) {
+                isr = uio_pins[bit]->isr;
+                isr_args = uio_pins[bit]->isr_args;
+                pin = uio_pins[bit]->phy_pin >= 0 ? uio_pins[bit]->phy_pin : uio_pins[bit]->pin;
+                uio_running = bit;
+            }
+            pthread_mutex_unlock(&uio_lock);
+            if (isr == NULL)
+                continue;
+
+            MAA_TRACE_ISR(pin);
+            isr(isr_args);
+
+            pthread_mutex_lock(&uio_lock);
+            uio_running = -1;
+            pthread_cond_broadcast(&uio_idle);
+            pthread_mutex_unlock(&uio_lock);
+        }
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        // the last isr may have stopped the dispatcher from its callback
+        pthread_testcancel();
+    }
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+static maa_result_t
+maa_gpio_uio_register(maa_gpio_context dev, gpio_edge_t mode)
+{
+    volatile uint32_t* regs = (volatile uint32_t*) dev->reg;
+    uint32_t mask = (uint32_t) 1 << dev->reg_bit_pos;
+
+    if (mode != MAA_GPIO_EDGE_BOTH && mode != MAA_GPIO_EDGE_RISING &&
+        mode != MAA_GPIO_EDGE_FALLING)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&uio_lock);
+    if (uio_pins[dev->reg_bit_pos] != NULL) {
+        pthread_mutex_unlock(&uio_lock);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    if (uio_count == 0) {
+        char uio_dev[MAX_SIZE];
+        snprintf(uio_dev, MAX_SIZE, "%s%s", maa_sysfs_root(), mmap_dev);
+        uio_fd = open(uio_dev, O_RDWR);
+        if (uio_fd == -1) {
+            pthread_mutex_unlock(&uio_lock);
+            fprintf(stderr, "Failed to open uio device\n");
+            return MAA_ERROR_INVALID_RESOURCE;
+        }
+        // a FIFO stands in for the device in a simulated tree, every count
+        // written to it is one interrupt. Rearming would feed it our own writes
+        struct stat st;
+        uio_irqcontrol = !(fstat(uio_fd, &st) == 0 && S_ISFIFO(st.st_mode));
+        if (pthread_create(&uio_thread, NULL, maa_gpio_uio_dispatcher, (void *) regs) != 0) {
+            close(uio_fd);
+            uio_fd = -1;
+            pthread_mutex_unlock(&uio_lock);
+            return MAA_ERROR_NO_RESOURCES;
+        }
+    }
+
+    // keep the pin masked while it is being configured
+    __sync_fetch_and_or(&regs[DW_GPIO_INTMASK], mask);
+    __sync_fetch_and_or(&regs[DW_GPIO_INTTYPE_LEVEL], mask);
+    if (mode == MAA_GPIO_EDGE_RISING ||
+        (mode == MAA_GPIO_EDGE_BOTH && (regs[DW_GPIO_EXT_PORTA] & mask) == 0))
+        __sync_fetch_and_or(&regs[DW_GPIO_INT_POLARITY], mask);
+    else
+        __sync_fetch_and_and(&regs[DW_GPIO_INT_POLARITY], ~mask);
+    if (mode == MAA_GPIO_EDGE_BOTH)
+        __sync_fetch_and_or(&uio_both_edges, mask);
+    regs[DW_GPIO_PORTA_EOI] = mask;
+    __sync_fetch_and_or(&regs[DW_GPIO_INTEN], mask);
+    __sync_fetch_and_and(&regs[DW_GPIO_INTMASK], ~mask);
+
+    uio_pins[dev->reg_bit_pos] = dev;
+    uio_count++;
+    dev->uio_isr = 1;
+    pthread_mutex_unlock(&uio_lock);
+    return MAA_SUCCESS;
+}
+
+static maa_result_t
+maa_gpio_uio_unregister(maa_gpio_context dev)
+{
+    volatile uint32_t* regs = (volatile uint32_t*) dev->reg;
+    uint32_t mask = (uint32_t) 1 << dev->reg_bit_pos;
+
+    pthread_mutex_lock(&uio_lock);
+    __sync_fetch_and_and(&regs[DW_GPIO_INTEN], ~mask);
+    __sync_fetch_and_or(&regs[DW_GPIO_INTMASK], mask);
+    __sync_fetch_and_and(&uio_both_edges, ~mask);
+    uio_pins[dev->reg_bit_pos] = NULL;
+    dev->uio_isr = 0;
+
+    // wait for a running isr of this pin so that its arguments can be freed
+    // once we return, unless we are that isr
+    pthread_t thread = uio_thread;
+    int self = pthread_equal(thread, pthread_self());
+    while (!self && uio_running == (int) dev->reg_bit_pos)
+        pthread_cond_wait(&uio_idle, &uio_lock);
+
+    int stop = (--uio_count == 0);
+    if (stop)
+        uio_fd = -1;
+    pthread_mutex_unlock(&uio_lock);
+
+    // the dispatcher closes the device when it is cancelled
+    if (stop) {
+        pthread_cancel(thread);
+        if (self)
+            pthread_detach(thread);
+        else
+            pthread_join(thread, NULL);
+    }
+    return MAA_SUCCESS;
+}
+
+static void*
+maa_gpio_busy_poll_handler(void* arg)
+{
+    maa_gpio_busy_t* busy = (maa_gpio_busy_t*) arg;
+    volatile uint32_t* regs = busy->regs;
+    uint32_t mask = busy->mask;
+    unsigned int polls = 0;
+
+    if (busy->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(busy->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "Failed to pin busy poll thread to cpu %d\n", busy->cpu);
+    }
+
+    uint32_t last = busy->last;
+    while (!busy->stop) {
+        uint32_t level = regs[DW_GPIO_EXT_PORTA] & mask;
+        if (level != last) {
+            last = level;
+            if (busy->edge == MAA_GPIO_EDGE_BOTH ||
+                (busy->edge == MAA_GPIO_EDGE_RISING && level) ||
+                (busy->edge == MAA_GPIO_EDGE_FALLING && !level)) {
+                MAA_TRACE_ISR(busy->pin);
+                busy->isr(busy->isr_args);
+            }
+        }
+        if (busy->yield != 0 && ++polls >= busy->yield) {
+            polls = 0;
+            sched_yield();
+        }
+    }
+    free(busy);
+    return NULL;
+}
+
 maa_result_t
 maa_gpio_edge_mode(maa_gpio_context dev, gpio_edge_t mode)
 {
@@ -223,7 +635,7 @@ maa_gpio_edge_mode(maa_gpio_context dev, gpio_edge_t mode)
     }
 
     char filepath[MAX_SIZE];
-    snprintf(filepath, MAX_SIZE, SYSFS_CLASS_GPIO "/gpio%d/edge", dev->pin);
+    snprintf(filepath, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/edge", maa_sysfs_root(), dev->pin);
 
     int edge = open(filepath, O_RDWR);
     if (edge == -1) {
@@ -264,18 +676,195 @@ maa_result_t
 maa_gpio_isr(maa_gpio_context dev, gpio_edge_t mode, void (*fptr)(void *), void * args)
 {
     // we only allow one isr per maa_gpio_context
-    if (dev->thread_id != 0) {
+    if (dev->thread_id != 0 || dev->uio_isr || dev->multi_isr) {
         return MAA_ERROR_NO_RESOURCES;
     }
 
+    if (dev->isr_mode == MAA_GPIO_ISR_UIO) {
+        if (dev->mmap != 1)
+            return MAA_ERROR_FEATURE_NOT_SUPPORTED;
+        dev->isr = fptr;
+        dev->isr_args = args;
+        return maa_gpio_uio_register(dev, mode);
+    }
+
+    if (dev->isr_mode == MAA_GPIO_ISR_BUSY_POLL) {
+        if (dev->mmap != 1)
+            return MAA_ERROR_FEATURE_NOT_SUPPORTED;
+        if (mode != MAA_GPIO_EDGE_BOTH && mode != MAA_GPIO_EDGE_RISING &&
+            mode != MAA_GPIO_EDGE_FALLING)
+            return MAA_ERROR_INVALID_PARAMETER;
+        maa_gpio_busy_t* busy = (maa_gpio_busy_t*) calloc(1, sizeof(maa_gpio_busy_t));
+        if (busy == NULL)
+            return MAA_ERROR_NO_RESOURCES;
+        busy->regs = (volatile uint32_t*) dev->reg;
+        busy->mask = (uint32_t) 1 << dev->reg_bit_pos;
+        // edges from the moment we return on are reported
+        busy->last = busy->regs[DW_GPIO_EXT_PORTA] & busy->mask;
+        busy->edge = mode;
+        busy->cpu = dev->busy_cpu;
+        busy->yield = dev->busy_yield;
+        busy->isr = fptr;
+        busy->isr_args = args;
+        busy->pin = dev->phy_pin >= 0 ? dev->phy_pin : dev->pin;
+        dev->isr = fptr;
+        dev->isr_args = args;
+        if (pthread_create(&dev->thread_id, NULL, maa_gpio_busy_poll_handler, (void *) busy) != 0) {
+            free(busy);
+            dev->thread_id = 0;
+            return MAA_ERROR_NO_RESOURCES;
+        }
+        dev->busy = busy;
+        dev->isr_thread = MAA_GPIO_THREAD_BUSY_POLL;
+        return MAA_SUCCESS;
+    }
+
     if (MAA_SUCCESS != maa_gpio_edge_mode(dev, mode)) {
         return MAA_ERROR_UNSPECIFIED;
     }
         
     dev->isr = fptr;
     dev->isr_args = args;
-    pthread_create (&dev->thread_id, NULL, maa_gpio_interrupt_handler, (void *) dev);
+    if (pthread_create(&dev->thread_id, NULL, maa_gpio_interrupt_handler, (void *) dev) != 0) {
+        maa_gpio_edge_mode(dev, MAA_GPIO_EDGE_NONE);
+        dev->thread_id = 0;
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    dev->isr_thread = MAA_GPIO_THREAD_SYSFS;
+
+    return MAA_SUCCESS;
+}
+
+static void
+maa_gpio_multi_release(maa_gpio_multi_context multi, unsigned int n)
+{
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        maa_gpio_edge_mode(multi->devs[i], MAA_GPIO_EDGE_NONE);
+        close(multi->fds[i].fd);
+        multi->devs[i]->multi_isr = 0;
+    }
+    free(multi->fds);
+    free(multi->devs);
+    free(multi);
+}
+
+static void*
+maa_gpio_multi_handler(void* arg)
+{
+    maa_gpio_multi_context multi = (maa_gpio_multi_context) arg;
+    maa_gpio_event_t event;
+    unsigned int i;
+    unsigned char c;
+
+    while (!multi->stop) {
+        // poll is a cancellation point, nothing else in the loop blocks
+        if (poll(multi->fds, multi->n, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Failed to wait for gpio group interrupt\n");
+            return NULL;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &event.timestamp);
+
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        for (i = 0; i < multi->n && !multi->stop; i++) {
+            if ((multi->fds[i].revents & multi->fds[i].events) == 0)
+                continue;
+            lseek(multi->fds[i].fd, 0, SEEK_SET);
+            if (read(multi->fds[i].fd, &c, 1) != 1)
+                continue;
+            maa_gpio_context dev = multi->devs[i];
+            event.index = i;
+            event.pin = dev->phy_pin >= 0 ? dev->phy_pin : dev->pin;
+            event.edge = (c == '1') ? MAA_GPIO_EDGE_RISING : MAA_GPIO_EDGE_FALLING;
+            MAA_TRACE_ISR(event.pin);
+            multi->cb(&event, multi->user);
+        }
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    }
+
+    // maa_gpio_isr_multi_exit() was called from the callback and left
+    // freeing the group to us
+    pthread_detach(pthread_self());
+    maa_gpio_multi_release(multi, multi->n);
+    return NULL;
+}
+
+maa_gpio_multi_context
+maa_gpio_isr_multi(maa_gpio_context* devs, unsigned int n, gpio_edge_t edge,
+                   maa_gpio_multi_isr_t cb, void* user)
+{
+    if (devs == NULL || n == 0 || cb == NULL)
+        return NULL;
+
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        if (devs[i] == NULL || devs[i]->thread_id != 0 ||
+            devs[i]->uio_isr || devs[i]->multi_isr) {
+            fprintf(stderr, "Gpio %u of the group is invalid or already has an isr\n", i);
+            return NULL;
+        }
+    }
+
+    maa_gpio_multi_context multi = (maa_gpio_multi_context) calloc(1, sizeof(struct _gpio_multi));
+    if (multi == NULL)
+        return NULL;
+    multi->devs = (maa_gpio_context*) malloc(n * sizeof(maa_gpio_context));
+    multi->fds = (struct pollfd*) calloc(n, sizeof(struct pollfd));
+    if (multi->devs == NULL || multi->fds == NULL) {
+        free(multi->devs);
+        free(multi->fds);
+        free(multi);
+        return NULL;
+    }
+    memcpy(multi->devs, devs, n * sizeof(maa_gpio_context));
+    multi->cb = cb;
+    multi->user = user;
+
+    unsigned char c;
+    for (i = 0; i < n; i++) {
+        if (maa_gpio_edge_mode(devs[i], edge) != MAA_SUCCESS)
+            break;
+        multi->fds[i].fd = maa_gpio_open_edge_fd(devs[i], &multi->fds[i].events);
+        if (multi->fds[i].fd == -1) {
+            maa_gpio_edge_mode(devs[i], MAA_GPIO_EDGE_NONE);
+            break;
+        }
+        // an initial read so the first poll only reports new edges
+        read(multi->fds[i].fd, &c, 1);
+        devs[i]->multi_isr = 1;
+    }
+    multi->n = i;
+    if (i != n) {
+        fprintf(stderr, "Failed to set up interrupt on gpio %u of the group\n", i);
+        maa_gpio_multi_release(multi, i);
+        return NULL;
+    }
+
+    if (pthread_create(&multi->thread_id, NULL, maa_gpio_multi_handler, (void *) multi) != 0) {
+        maa_gpio_multi_release(multi, n);
+        return NULL;
+    }
+    return multi;
+}
+
+maa_result_t
+maa_gpio_isr_multi_exit(maa_gpio_multi_context multi)
+{
+    if (multi == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
 
+    // the callback is still using the group, let the thread free it once
+    // the callback returns
+    if (pthread_equal(multi->thread_id, pthread_self())) {
+        multi->stop = 1;
+        return MAA_SUCCESS;
+    }
+
+    pthread_cancel(multi->thread_id);
+    pthread_join(multi->thread_id, NULL);
+    maa_gpio_multi_release(multi, multi->n);
     return MAA_SUCCESS;
 }
 
@@ -284,6 +873,27 @@ maa_gpio_isr_exit(maa_gpio_context dev)
 {
     maa_result_t ret = MAA_SUCCESS;
 
+    if (dev->uio_isr) {
+        ret = maa_gpio_uio_unregister(dev);
+        dev->isr = NULL;
+        return ret;
+    }
+
+    if (dev->isr_thread == MAA_GPIO_THREAD_BUSY_POLL) {
+        // the poll loop has no cancellation point, ask it to stop instead.
+        // It frees its state itself, so an isr closing dev is safe
+        dev->busy->stop = 1;
+        if (pthread_equal(dev->thread_id, pthread_self()))
+            pthread_detach(dev->thread_id);
+        else
+            pthread_join(dev->thread_id, NULL);
+        dev->busy = NULL;
+        dev->thread_id = 0;
+        dev->isr_thread = MAA_GPIO_THREAD_NONE;
+        dev->isr = NULL;
+        return ret;
+    }
+
     // wasting our time, there is no isr to exit from
     if (dev->thread_id == 0 && dev->isr_value_fp == -1) {
         return ret;
@@ -295,6 +905,14 @@ maa_gpio_isr_exit(maa_gpio_context dev)
     if ((dev->thread_id != 0) &&
         (pthread_cancel(dev->thread_id) != 0)) {
         ret = MAA_ERROR_INVALID_HANDLE;
+    } else if (dev->thread_id != 0) {
+        // wait for a running isr to return so that its arguments can be
+        // freed as soon as we return, unless we are that isr
+        if (pthread_equal(dev->thread_id, pthread_self())) {
+            pthread_detach(dev->thread_id);
+        } else {
+            pthread_join(dev->thread_id, NULL);
+        }
     }
 
     // close the filehandle in case it's still open
@@ -304,14 +922,12 @@ maa_gpio_isr_exit(maa_gpio_context dev)
           }
     }
 
-#ifdef SWIGPYTHON
-    // Dereference our Python call back function
-    Py_DECREF(dev->isr);
-#endif
-
-    // assume our thread will exit either way we just lost it's handle
     dev->thread_id = 0;
+    dev->isr_thread = MAA_GPIO_THREAD_NONE;
     dev->isr_value_fp = -1;
+    dev->isr = NULL;
+    dev->cache = 0;
+    dev->cache_value = -1;
 
     return ret;
 }
@@ -325,7 +941,7 @@ maa_gpio_mode(maa_gpio_context dev, gpio_mode_t mode)
     }
 
     char filepath[MAX_SIZE];
-    snprintf(filepath, MAX_SIZE, SYSFS_CLASS_GPIO "/gpio%d/drive", dev->pin);
+    snprintf(filepath, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/drive", maa_sysfs_root(), dev->pin);
 
     int drive = open(filepath, O_WRONLY);
     if (drive == -1) {
@@ -363,24 +979,22 @@ maa_gpio_mode(maa_gpio_context dev, gpio_mode_t mode)
     return MAA_SUCCESS;
 }
 
-maa_result_t
-maa_gpio_dir(maa_gpio_context dev, gpio_dir_t dir)
+static maa_result_t
+maa_gpio_dir_sysfs(maa_gpio_context dev, gpio_dir_t dir)
 {
-    if (dev == NULL) {
-        return MAA_ERROR_INVALID_HANDLE;
-    }
     if (dev->value_fp != -1) {
          close(dev->value_fp);
          dev->value_fp = -1;
+         MAA_STATS_SYSCALL(1);
     }
     char filepath[MAX_SIZE];
-    snprintf(filepath, MAX_SIZE, SYSFS_CLASS_GPIO "/gpio%d/direction", dev->pin);
+    snprintf(filepath, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/gpio%d/direction", maa_sysfs_root(), dev->pin);
 
     int direction = open(filepath, O_RDWR);
+    MAA_STATS_SYSCALL(1);
 
     if (direction == -1) {
-        fprintf(stderr, "Failed to open direction for writing!\n");
-        return MAA_ERROR_INVALID_RESOURCE;
+        return MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to open direction of gpio%d", dev->pin);
     }
 
     char bu[MAX_SIZE];
@@ -396,72 +1010,152 @@ maa_gpio_dir(maa_gpio_context dev, gpio_dir_t dir)
             break;
         default:
             close(direction);
+            MAA_STATS_SYSCALL(1);
             return MAA_ERROR_FEATURE_NOT_IMPLEMENTED;
     }
 
     if (dev->phy_pin >= 0) {
         maa_result_t swap_res = maa_swap_complex_gpio(dev->phy_pin, out_switch);
-        if (swap_res != MAA_SUCCESS)
+        if (swap_res != MAA_SUCCESS) {
+            close(direction);
+            MAA_STATS_SYSCALL(1);
             return swap_res;
+        }
     }
 
-    if (write(direction, bu, length*sizeof(char)) == -1) {
+    ssize_t written = write(direction, bu, length*sizeof(char));
+    MAA_STATS_SYSCALL(1);
+    if (written == -1) {
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to write direction of gpio%d", dev->pin);
         close(direction);
+        MAA_STATS_SYSCALL(1);
         return MAA_ERROR_INVALID_RESOURCE;
     }
 
     close(direction);
+    MAA_STATS_SYSCALL(1);
+    if (dev->mux_line >= 0)
+        maa_mux_invalidate(dev->mux_line);
+    // the kernel does not promise a level when switching to output
+    dev->output = out_switch;
+    maa_gpio_shadow_set(dev, -1);
     return MAA_SUCCESS;
 }
 
-int
-maa_gpio_read(maa_gpio_context dev)
+maa_result_t
+maa_gpio_dir(maa_gpio_context dev, gpio_dir_t dir)
 {
+    if (dev == NULL) {
+        return MAA_ERROR_INVALID_HANDLE;
+    }
+    MAA_STATS_BEGIN(start);
+    maa_result_t ret = maa_gpio_dir_sysfs(dev, dir);
+    MAA_STATS_END(start, MAA_STATS_GPIO_DIR, 0, ret != MAA_SUCCESS);
+    return ret;
+}
+
+static int
+maa_gpio_read_value(maa_gpio_context dev)
+{
+    if (dev->cache && dev->cache_value != -1)
+        return dev->cache_value;
+
+    if (dev->shadow && dev->output) {
+        int value = dev->shadow_value->value;
+        if (value != -1)
+            return value;
+    }
+
     if (dev->value_fp == -1) {
         if (maa_gpio_get_valfp(dev) != MAA_SUCCESS) {
-             fprintf(stderr, "Failed to get value file pointer\n");
+            MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to open value of gpio%d", dev->pin);
+            return -1;
         }
     }
     else {
         // if value_fp is new this is pointless
         lseek(dev->value_fp, 0, SEEK_SET);
+        MAA_STATS_SYSCALL(1);
     }
     char bu[2];
-    if (read(dev->value_fp, bu, 2*sizeof(char)) != 2) {
-        fprintf(stderr, "Failed to read a sensible value from sysfs");
+    ssize_t got = read(dev->value_fp, bu, 2*sizeof(char));
+    MAA_STATS_SYSCALL(1);
+    if (got != 2) {
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to read value of gpio%d", dev->pin);
+        return -1;
     }
     lseek(dev->value_fp, 0, SEEK_SET);
+    MAA_STATS_SYSCALL(1);
     int ret = strtol(bu, NULL, 10);
 
     return ret;
 }
 
-maa_result_t
-maa_gpio_write(maa_gpio_context dev, int value)
+int
+maa_gpio_read(maa_gpio_context dev)
 {
-    if (dev->mmap == 1)
-        return maa_gpio_write_register(dev,value);
+    MAA_STATS_BEGIN(start);
+    int ret = maa_gpio_read_value(dev);
+    MAA_STATS_END(start, MAA_STATS_GPIO_READ, 1, ret < 0);
+    return ret;
+}
+
+static maa_result_t
+maa_gpio_write_value(maa_gpio_context dev, int value)
+{
+    if (dev->shadow) {
+        value = value ? 1 : 0;
+        if (value == dev->shadow_value->value)
+            return MAA_SUCCESS;
+    }
+
+    if (dev->mmap == 1) {
+        maa_gpio_shadow_set(dev, value);
+        maa_gpio_write_register(dev,value);
+        if (dev->mux_line >= 0)
+            maa_mux_invalidate(dev->mux_line);
+        return MAA_SUCCESS;
+    }
 
     if (dev->value_fp == -1) {
         maa_gpio_get_valfp(dev);
     }
-    if (lseek(dev->value_fp, 0, SEEK_SET) == -1) {
-        return MAA_ERROR_INVALID_RESOURCE;
+    off_t pos = lseek(dev->value_fp, 0, SEEK_SET);
+    MAA_STATS_SYSCALL(1);
+    if (pos == -1) {
+        return MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to open value of gpio%d", dev->pin);
     }
 
     char bu[MAX_SIZE];
     int length = snprintf(bu, sizeof(bu), "%d", value);
-    if (write(dev->value_fp, bu, length*sizeof(char)) == -1) {
-        return MAA_ERROR_INVALID_HANDLE;
+    ssize_t written = write(dev->value_fp, bu, length*sizeof(char));
+    MAA_STATS_SYSCALL(1);
+    if (dev->mux_line >= 0)
+        maa_mux_invalidate(dev->mux_line);
+    if (written == -1) {
+        maa_gpio_shadow_set(dev, -1);
+        return MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to write value of gpio%d", dev->pin);
     }
 
+    maa_gpio_shadow_set(dev, value);
     return MAA_SUCCESS;
 }
 
+maa_result_t
+maa_gpio_write(maa_gpio_context dev, int value)
+{
+    MAA_STATS_BEGIN(start);
+    maa_result_t ret = maa_gpio_write_value(dev, value);
+    MAA_STATS_END(start, MAA_STATS_GPIO_WRITE, 1, ret != MAA_SUCCESS);
+    return ret;
+}
+
 static maa_result_t
 maa_gpio_unexport_force(maa_gpio_context dev)
 {
-    int unexport = open(SYSFS_CLASS_GPIO "/unexport", O_WRONLY);
+    char filepath[MAX_SIZE];
+    snprintf(filepath, MAX_SIZE, "%s" SYSFS_CLASS_GPIO "/unexport", maa_sysfs_root());
+    int unexport = open(filepath, O_WRONLY);
     if (unexport == -1) {
         fprintf(stderr, "Failed to open unexport for writing!\n");
         return MAA_ERROR_INVALID_RESOURCE;
@@ -491,11 +1185,18 @@ maa_gpio_unexport(maa_gpio_context dev)
 maa_result_t
 maa_gpio_close(maa_gpio_context dev)
 {
+    // a running edge watcher or poll thread would outlive the context
+    if (dev->uio_isr || dev->isr_thread != MAA_GPIO_THREAD_NONE)
+        maa_gpio_isr_exit(dev);
+    if (dev->mmap == 1)
+        maa_gpio_use_mmaped(dev, 0);
     if (dev->value_fp != -1) {
         close(dev->value_fp);
     }
-    maa_gpio_unexport(dev);
-    free(dev);
+    // other contexts of the pin still need it exported
+    if (dev->phy_pin < 0 || maa_release_pin(dev->phy_pin) == 0)
+        maa_gpio_unexport(dev);
+    maa_pool_free(MAA_POOL_GPIO, dev);
     return MAA_SUCCESS;
 }
 
@@ -508,6 +1209,112 @@ maa_gpio_owner(maa_gpio_context dev, maa_boolean_t own)
     return MAA_SUCCESS;
 }
 
+maa_result_t
+maa_gpio_isr_mode(maa_gpio_context dev, gpio_isr_mode_t mode)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+    if (dev->thread_id != 0 || dev->uio_isr)
+        return MAA_ERROR_NO_RESOURCES;
+
+    switch (mode) {
+        case MAA_GPIO_ISR_SYSFS:
+            break;
+        case MAA_GPIO_ISR_UIO:
+        case MAA_GPIO_ISR_BUSY_POLL:
+            if (maa_pin_mode_test(dev->phy_pin, MAA_PIN_FAST_GPIO) == 0)
+                return MAA_ERROR_FEATURE_NOT_SUPPORTED;
+            break;
+        default:
+            return MAA_ERROR_INVALID_PARAMETER;
+    }
+    dev->isr_mode = mode;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_gpio_busy_poll_config(maa_gpio_context dev, int cpu, unsigned int yield_every)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+    if (dev->thread_id != 0)
+        return MAA_ERROR_NO_RESOURCES;
+    if (cpu < -1 || cpu >= CPU_SETSIZE)
+        return MAA_ERROR_INVALID_PARAMETER;
+    dev->busy_cpu = cpu;
+    dev->busy_yield = yield_every;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_gpio_input_cache(maa_gpio_context dev, maa_boolean_t cache)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    if (cache == 0)
+        return dev->cache ? maa_gpio_isr_exit(dev) : MAA_SUCCESS;
+
+    // the edge watcher is needed for the cache, and must see both edges
+    if (dev->thread_id != 0 || dev->uio_isr || dev->multi_isr)
+        return MAA_ERROR_NO_RESOURCES;
+    if (maa_gpio_edge_mode(dev, MAA_GPIO_EDGE_BOTH) != MAA_SUCCESS)
+        return MAA_ERROR_UNSPECIFIED;
+
+    dev->isr = NULL;
+    dev->isr_args = NULL;
+    dev->cache_value = -1;
+    dev->cache = 1;
+    if (pthread_create(&dev->thread_id, NULL, maa_gpio_interrupt_handler, (void *) dev) != 0) {
+        maa_gpio_edge_mode(dev, MAA_GPIO_EDGE_NONE);
+        dev->cache = 0;
+        dev->thread_id = 0;
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    dev->isr_thread = MAA_GPIO_THREAD_SYSFS;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_gpio_shadow(maa_gpio_context dev, maa_boolean_t shadow)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+    dev->shadow = shadow;
+    maa_gpio_shadow_set(dev, -1);
+    return MAA_SUCCESS;
+}
+
+int
+maa_gpio_raw_pin(maa_gpio_context dev)
+{
+    if (dev == NULL)
+        return -1;
+    return dev->pin;
+}
+
+maa_boolean_t
+maa_gpio_mmaped(maa_gpio_context dev)
+{
+    return dev != NULL && dev->mmap == 1;
+}
+
+maa_result_t
+maa_gpio_get_fast(maa_gpio_context dev, maa_gpio_fast_t* fast)
+{
+    if (dev == NULL || fast == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+    if (dev->mmap != 1)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    fast->reg = (volatile uint32_t*) dev->reg;
+    fast->mask = (uint32_t) 1 << dev->reg_bit_pos;
+    // writes through fast never reach us, give up on the cached mux value now
+    if (dev->mux_line >= 0)
+        maa_mux_invalidate(dev->mux_line);
+    return MAA_SUCCESS;
+}
+
 maa_result_t
 maa_gpio_use_mmaped(maa_gpio_context dev, maa_boolean_t mmap_en)
 {
@@ -515,6 +1322,23 @@ maa_gpio_use_mmaped(maa_gpio_context dev, maa_boolean_t mmap_en)
         return MAA_ERROR_INVALID_RESOURCE;
     }
 
+    // disabling only drops the mapping, the pin keeps its mux settings
+    if (mmap_en == 0) {
+        if (dev->mmap == 0)
+            return MAA_ERROR_INVALID_PARAMETER;
+        // only the uio and busy poll isrs need the mapping
+        if (dev->uio_isr || dev->isr_thread == MAA_GPIO_THREAD_BUSY_POLL)
+            maa_gpio_isr_exit(dev);
+        pthread_mutex_lock(&mmap_lock);
+        if (--mmap_refs == 0)
+            munmap(mmap_base, mmap_sz);
+        pthread_mutex_unlock(&mmap_lock);
+        dev->reg = NULL;
+        dev->mmap = 0;
+        dev->mux_line = maa_mux_gpio(dev->pin) ? (int) dev->pin : -1;
+        return MAA_SUCCESS;
+    }
+
     if (maa_pin_mode_test(dev->phy_pin, MAA_PIN_FAST_GPIO) == 0)
         return MAA_ERROR_NO_RESOURCES;
 
@@ -522,31 +1346,43 @@ maa_gpio_use_mmaped(maa_gpio_context dev, maa_boolean_t mmap_en)
     if (mmp == NULL)
         return MAA_ERROR_INVALID_RESOURCE;
 
-    if (mmap_en == 1) {
-        if (dev->mmap == 0) {
-            close(dev->value_fp);
-            int fd;
-            fd = open(mmp->mem_dev, O_RDWR);
-            if (fd < 1) {
-                fprintf(stderr, "Unable to open memory device\n");
-                return MAA_ERROR_INVALID_RESOURCE;
-            }
-            dev->reg_sz = mmp->mem_sz;
-            dev->reg = mmap(NULL, dev->reg_sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-            dev->reg_bit_pos = mmp->bit_pos;
-            dev->mmap = 1;
-            return MAA_SUCCESS;
-        }
+    if (dev->mmap == 1)
         return MAA_ERROR_INVALID_PARAMETER;
-    }
 
-    if (mmap_en == 0) {
-        if (dev ->mmap == 1) {
-            munmap(dev->reg, dev->reg_sz);
-            dev->mmap = 0;
+    pthread_mutex_lock(&mmap_lock);
+    if (mmap_refs == 0) {
+        int fd;
+        char mem_dev[MAX_SIZE];
+        snprintf(mem_dev, MAX_SIZE, "%s%s", maa_sysfs_root(), mmp->mem_dev);
+        fd = open(mem_dev, O_RDWR);
+        if (fd < 1) {
+            pthread_mutex_unlock(&mmap_lock);
+            fprintf(stderr, "Unable to open memory device\n");
+            return MAA_ERROR_INVALID_RESOURCE;
         }
-        return MAA_ERROR_INVALID_PARAMETER;
+        mmap_base = mmap(NULL, mmp->mem_sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mmap_base == MAP_FAILED) {
+            pthread_mutex_unlock(&mmap_lock);
+            fprintf(stderr, "Unable to map memory device\n");
+            return MAA_ERROR_INVALID_RESOURCE;
+        }
+        mmap_sz = mmp->mem_sz;
+        mmap_dev = mmp->mem_dev;
     }
+    mmap_refs++;
+    pthread_mutex_unlock(&mmap_lock);
 
+    if (dev->value_fp != -1) {
+        close(dev->value_fp);
+        dev->value_fp = -1;
+    }
+    dev->reg_sz = mmap_sz;
+    dev->reg = mmap_base;
+    dev->reg_bit_pos = mmp->bit_pos;
+    dev->mmap = 1;
+    // the mapped bit may drive a line other pins use as a mux
+    if (maa_mux_gpio(mmp->gpio.pinmap))
+        dev->mux_line = mmp->gpio.pinmap;
     return MAA_SUCCESS;
 }
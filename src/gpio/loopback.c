@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "loopback.h"
+#include "gpio_fast.h"
+#include "maa_internal.h"
+
+/* give up on an edge after this long */
+#define LOOPBACK_TIMEOUT_NS 100000000ULL
+/* let the isr thread rearm before the next edge */
+#define LOOPBACK_GAP_US 500
+#define SYSFS_CLASS_GPIO "/sys/class/gpio"
+#define MAX_SIZE 128
+
+typedef struct maa_loopback_wire maa_loopback_wire_t;
+
+/**
+ * State shared between the edge generator and the isr. It is handed to the
+ * isr thread so it lives on the heap until that thread has been stopped.
+ */
+struct maa_loopback_wire {
+    volatile uint32_t seq; /**< edge being timed, 0 between edges */
+    volatile uint32_t stamped; /**< last edge a callback was taken for */
+    volatile uint32_t stamp_seq; /**< edge stamp belongs to */
+    volatile uint64_t stamp; /**< time the callback ran */
+    void (*fire)(maa_loopback_wire_t*); /**< generates one edge */
+    int level; /**< level after the last edge */
+    maa_gpio_context out; /**< output of a real wire */
+    int fd; /**< FIFO standing in for the value file or the uio device */
+    maa_gpio_fast_t fast; /**< mapped registers of a simulated input */
+};
+
+static uint64_t
+maa_loopback_now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/*
+ * The isr. Only the first callback of the edge being timed is kept, one
+ * from an edge that already timed out would otherwise be taken for the
+ * next edge with a bogus latency.
+ */
+static void
+maa_loopback_stamp(void* arg)
+{
+    maa_loopback_wire_t* wire = (maa_loopback_wire_t*) arg;
+    uint64_t now = maa_loopback_now();
+    uint32_t seq = wire->seq;
+    uint32_t last = wire->stamped;
+    if (seq == 0 || last >= seq || !__sync_bool_compare_and_swap(&wire->stamped, last, seq))
+        return;
+    wire->stamp = now;
+    __sync_synchronize();
+    wire->stamp_seq = seq;
+}
+
+static int
+maa_loopback_cmp(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t
+maa_loopback_isqrt(uint64_t v)
+{
+    uint64_t r = 0, bit = 1ULL << 62;
+    while (bit > v)
+        bit >>= 2;
+    while (bit != 0) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+static void
+maa_loopback_summarise(uint64_t* lat, unsigned int n, unsigned int missed,
+                       unsigned int bucket_ns, maa_loopback_result_t* result)
+{
+    memset(result, 0, sizeof(maa_loopback_result_t));
+    result->samples = n;
+    result->missed = missed;
+    result->bucket_ns = bucket_ns;
+    if (n == 0)
+        return;
+
+    qsort(lat, n, sizeof(uint64_t), maa_loopback_cmp);
+    uint64_t sum = 0;
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        sum += lat[i];
+        uint64_t bucket = lat[i] / bucket_ns;
+        result->histogram[bucket < MAA_LOOPBACK_BUCKETS ? bucket : MAA_LOOPBACK_BUCKETS - 1]++;
+    }
+    result->mean_ns = sum / n;
+    uint64_t var = 0;
+    for (i = 0; i < n; i++) {
+        int64_t d = (int64_t) (lat[i] - result->mean_ns);
+        var += (uint64_t) (d * d) / n;
+    }
+    result->jitter_ns = maa_loopback_isqrt(var);
+    result->min_ns = lat[0];
+    result->max_ns = lat[n - 1];
+    result->p50_ns = lat[(n - 1) * 50 / 100];
+    result->p99_ns = lat[(uint64_t) (n - 1) * 99 / 100];
+    result->p999_ns = lat[(uint64_t) (n - 1) * 999 / 1000];
+}
+
+/*
+ * Generate edges and time each until the callback stamps it
+ */
+static maa_result_t
+maa_loopback_run(maa_loopback_wire_t* wire, unsigned int samples, unsigned int bucket_ns,
+                 maa_loopback_result_t* result)
+{
+    uint64_t* lat = malloc(samples * sizeof(uint64_t));
+    if (lat == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+
+    unsigned int i, n = 0, missed = 0;
+    for (i = 0; i < samples; i++) {
+        uint32_t seq = i + 1;
+        wire->seq = seq;
+        __sync_synchronize();
+        uint64_t start = maa_loopback_now();
+        wire->fire(wire);
+        while (wire->stamp_seq != seq && maa_loopback_now() - start < LOOPBACK_TIMEOUT_NS)
+            sched_yield();
+        __sync_synchronize();
+        if (wire->stamp_seq != seq) {
+            missed++;
+        } else {
+            uint64_t stamp = wire->stamp;
+            lat[n++] = stamp > start ? stamp - start : 0;
+        }
+        // callbacks arriving between edges are dropped
+        wire->seq = 0;
+        __sync_synchronize();
+        usleep(LOOPBACK_GAP_US);
+    }
+
+    maa_loopback_summarise(lat, n, missed, bucket_ns ? bucket_ns : 1000, result);
+    free(lat);
+    return MAA_SUCCESS;
+}
+
+/*
+ * Time edges of wire on in with its isr in the given mode, mmap must
+ * already be enabled on in for the modes that need it
+ */
+static maa_result_t
+maa_loopback_measure(maa_gpio_context in, maa_loopback_wire_t* wire, gpio_isr_mode_t mode,
+                     unsigned int samples, unsigned int bucket_ns, maa_loopback_result_t* result)
+{
+    maa_result_t ret = maa_gpio_isr_mode(in, mode);
+    if (ret == MAA_SUCCESS)
+        ret = maa_gpio_isr(in, MAA_GPIO_EDGE_BOTH, maa_loopback_stamp, wire);
+    if (ret != MAA_SUCCESS) {
+        maa_gpio_isr_mode(in, MAA_GPIO_ISR_SYSFS);
+        return ret;
+    }
+    // the isr thread needs to be waiting before the first edge
+    usleep(10000);
+
+    ret = maa_loopback_run(wire, samples, bucket_ns, result);
+    // joins the isr thread, nothing uses wire afterwards
+    maa_gpio_isr_exit(in);
+    maa_gpio_isr_mode(in, MAA_GPIO_ISR_SYSFS);
+    return ret;
+}
+
+static void
+maa_loopback_toggle(maa_loopback_wire_t* wire)
+{
+    maa_gpio_write(wire->out, wire->level ^= 1);
+}
+
+maa_result_t
+maa_gpio_loopback(maa_gpio_context out, maa_gpio_context in, gpio_isr_mode_t mode,
+                  unsigned int samples, unsigned int bucket_ns, maa_loopback_result_t* result)
+{
+    if (out == NULL || in == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (samples == 0 || result == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    maa_result_t ret = maa_gpio_dir(out, MAA_GPIO_OUT);
+    if (ret == MAA_SUCCESS)
+        ret = maa_gpio_dir(in, MAA_GPIO_IN);
+    if (ret != MAA_SUCCESS)
+        return ret;
+    // the caller gets the input back the way it handed it over
+    maa_boolean_t mmaped = maa_gpio_mmaped(in);
+    if (mode != MAA_GPIO_ISR_SYSFS && !mmaped) {
+        ret = maa_gpio_use_mmaped(in, 1);
+        if (ret != MAA_SUCCESS)
+            return ret;
+    }
+
+    maa_loopback_wire_t* wire = calloc(1, sizeof(maa_loopback_wire_t));
+    if (wire == NULL) {
+        ret = MAA_ERROR_NO_RESOURCES;
+    } else {
+        wire->fire = maa_loopback_toggle;
+        wire->out = out;
+        wire->fd = -1;
+        ret = maa_loopback_measure(in, wire, mode, samples, bucket_ns, result);
+        free(wire);
+    }
+    if (maa_gpio_mmaped(in) != mmaped)
+        maa_gpio_use_mmaped(in, mmaped);
+    return ret;
+}
+
+/* a FIFO edge source takes one level per byte */
+static void
+maa_loopback_sim_sysfs(maa_loopback_wire_t* wire)
+{
+    char c = (wire->level ^= 1) ? '1' : '0';
+    if (write(wire->fd, &c, 1) != 1)
+        fprintf(stderr, "loopback: Failed to drive the simulated wire\n");
+}
+
+/* latch the edge in the controller, then signal the uio device */
+static void
+maa_loopback_sim_uio(maa_loopback_wire_t* wire)
+{
+    uint32_t count = wire->seq;
+    maa_gpio_fast_toggle(&wire->fast);
+    __sync_fetch_and_or(&wire->fast.reg[DW_GPIO_INTSTATUS], wire->fast.mask);
+    if (write(wire->fd, &count, sizeof(count)) != sizeof(count))
+        fprintf(stderr, "loopback: Failed to drive the simulated wire\n");
+}
+
+/* the poll loop watches the external port register */
+static void
+maa_loopback_sim_busy(maa_loopback_wire_t* wire)
+{
+    __sync_fetch_and_xor(&wire->fast.reg[DW_GPIO_EXT_PORTA], wire->fast.mask);
+}
+
+/*
+ * Put a FIFO in place of path, the original is kept next to it until
+ * maa_loopback_sim_restore(). Returns a descriptor to drive it or -1.
+ */
+static int
+maa_loopback_sim_fifo(const char* path)
+{
+    char saved[MAX_SIZE];
+    snprintf(saved, sizeof(saved), "%s.loopback", path);
+    if (rename(path, saved) == -1)
+        return -1;
+    // read-write so that opening neither blocks nor fails without a reader
+    int fd = -1;
+    if (mkfifo(path, 0600) == 0)
+        fd = open(path, O_RDWR | O_NONBLOCK);
+    if (fd == -1) {
+        unlink(path);
+        rename(saved, path);
+    }
+    return fd;
+}
+
+static void
+maa_loopback_sim_restore(const char* path, int fd)
+{
+    char saved[MAX_SIZE];
+    snprintf(saved, sizeof(saved), "%s.loopback", path);
+    close(fd);
+    unlink(path);
+    rename(saved, path);
+}
+
+maa_result_t
+maa_gpio_loopback_sim(int pin, gpio_isr_mode_t mode, unsigned int samples, unsigned int bucket_ns,
+                      maa_loopback_result_t* result)
+{
+    if (samples == 0 || result == NULL || mode < MAA_GPIO_ISR_SYSFS || mode > MAA_GPIO_ISR_BUSY_POLL)
+        return MAA_ERROR_INVALID_PARAMETER;
+    // files are replaced, never do that to the real tree
+    if (maa_sysfs_root()[0] == '\0')
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    maa_gpio_context in = maa_gpio_init(pin);
+    if (in == NULL)
+        return MAA_ERROR_INVALID_RESOURCE;
+    maa_loopback_wire_t* wire = calloc(1, sizeof(maa_loopback_wire_t));
+    if (wire == NULL) {
+        maa_gpio_close(in);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    wire->fd = -1;
+
+    char path[MAX_SIZE];
+    maa_result_t ret = maa_gpio_dir(in, MAA_GPIO_IN);
+    if (ret == MAA_SUCCESS && mode != MAA_GPIO_ISR_SYSFS)
+        ret = maa_gpio_use_mmaped(in, 1);
+    if (ret == MAA_SUCCESS && mode != MAA_GPIO_ISR_SYSFS)
+        ret = maa_gpio_get_fast(in, &wire->fast);
+    if (ret == MAA_SUCCESS) {
+        switch (mode) {
+            case MAA_GPIO_ISR_SYSFS:
+                snprintf(path, sizeof(path), "%s" SYSFS_CLASS_GPIO "/gpio%d/value",
+                         maa_sysfs_root(), maa_gpio_raw_pin(in));
+                wire->fire = maa_loopback_sim_sysfs;
+                break;
+            case MAA_GPIO_ISR_UIO: {
+                // the registers are mapped already, only the device is replaced
+                maa_mmap_pin_t* mmp = maa_setup_mmap_gpio(pin);
+                if (mmp == NULL) {
+                    ret = MAA_ERROR_INVALID_RESOURCE;
+                    break;
+                }
+                snprintf(path, sizeof(path), "%s%s", maa_sysfs_root(), mmp->mem_dev);
+                wire->fire = maa_loopback_sim_uio;
+                break;
+            }
+            default:
+                wire->fire = maa_loopback_sim_busy;
+                break;
+        }
+        if (ret == MAA_SUCCESS && mode != MAA_GPIO_ISR_BUSY_POLL &&
+            (wire->fd = maa_loopback_sim_fifo(path)) == -1)
+            ret = MAA_ERROR_INVALID_RESOURCE;
+    }
+    if (ret == MAA_SUCCESS)
+        ret = maa_loopback_measure(in, wire, mode, samples, bucket_ns, result);
+
+    if (wire->fd != -1)
+        maa_loopback_sim_restore(path, wire->fd);
+    free(wire);
+    maa_gpio_close(in);
+    return ret;
+}
+
+maa_result_t
+maa_loopback_print(const maa_loopback_result_t* result, FILE* out)
+{
+    if (result == NULL || out == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    fprintf(out, "edges %u, missed %u\n", result->samples, result->missed);
+    if (result->samples == 0)
+        return MAA_SUCCESS;
+    fprintf(out, "min %llu ns, p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+            (unsigned long long) result->min_ns, (unsigned long long) result->p50_ns,
+            (unsigned long long) result->p99_ns, (unsigned long long) result->p999_ns,
+            (unsigned long long) result->max_ns);
+    fprintf(out, "mean %llu ns, jitter %llu ns\n", (unsigned long long) result->mean_ns,
+            (unsigned long long) result->jitter_ns);
+
+    uint32_t peak = 0;
+    int i;
+    for (i = 0; i < MAA_LOOPBACK_BUCKETS; i++)
+        if (result->histogram[i] > peak)
+            peak = result->histogram[i];
+    for (i = 0; i < MAA_LOOPBACK_BUCKETS; i++) {
+        if (result->histogram[i] == 0)
+            continue;
+        char bar[51];
+        int len = (int) ((uint64_t) result->histogram[i] * 50 / peak);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        fprintf(out, "%10u%s ns %8u %s\n", i * result->bucket_ns,
+                i == MAA_LOOPBACK_BUCKETS - 1 ? "+" : " ", result->histogram[i], bar);
+    }
+    return MAA_SUCCESS;
+}
@@ -25,15 +25,21 @@
 #include "i2c.h"
 #include "smbus.h"
 #include "maa_internal.h"
+#include "maa_pool.h"
+#include "maa_shm.h"
 
 struct _i2c {
     /*@{*/
     int hz; /**< frequency of communication */
     int fh; /**< the file handle to the /dev/i2c-* device */
     int addr; /**< the address of the i2c slave */
+    int bus; /**< board bus it was set up for, -1 when raw */
+    unsigned int adapter; /**< number of the /dev/i2c-* device */
     /*@}*/
 };
 
+const size_t maa_i2c_context_size = sizeof(struct _i2c);
+
 maa_i2c_context
 maa_i2c_init(int bus)
 {
@@ -52,18 +58,26 @@ maa_i2c_init(int bus)
             default: return NULL;
         }
     }
-    return maa_i2c_init_raw((unsigned int) checked_pin);
+    maa_i2c_context dev = maa_i2c_init_raw((unsigned int) checked_pin);
+    if (dev == NULL) {
+        maa_release_i2c(bus);
+        return NULL;
+    }
+    dev->bus = bus;
+    return dev;
 }
 
 maa_i2c_context
 maa_i2c_init_raw(unsigned int bus)
 {
-    maa_i2c_context dev = (maa_i2c_context) malloc(sizeof(struct _i2c));
+    maa_i2c_context dev = (maa_i2c_context) maa_pool_alloc(MAA_POOL_I2C);
     if (dev == NULL)
         return NULL;
+    dev->bus = -1;
+    dev->adapter = bus;
 
-    char filepath[32];
-    snprintf(filepath, 32, "/dev/i2c-%u", bus);
+    char filepath[128];
+    snprintf(filepath, sizeof(filepath), "%s/dev/i2c-%u", maa_sysfs_root(), bus);
     if ((dev->fh = open(filepath, O_RDWR)) < 1) {
         fprintf(stderr, "Failed to open requested i2c port %s", filepath);
     }
@@ -81,18 +95,29 @@ maa_i2c_frequency(maa_i2c_context dev, int hz)
 int
 maa_i2c_read(maa_i2c_context dev, uint8_t* data, int length)
 {
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_I2C, dev->adapter);
     // this is the read(3) syscall not maa_i2c_read()
-    if (read(dev->fh, data, length) == length) {
-        return length;
-    }
-    return 0;
+    int ret = read(dev->fh, data, length) == length ? length : 0;
+    maa_shm_transfer_unlock(bus);
+    if (ret != length)
+        MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to read from i2c-%u", dev->adapter);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_I2C_READ, ret, ret != length);
+    return ret;
 }
 
 uint8_t
 maa_i2c_read_byte(maa_i2c_context dev)
 {
-    uint8_t byte = i2c_smbus_read_byte(dev->fh);
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_I2C, dev->adapter);
+    int32_t byte = i2c_smbus_read_byte(dev->fh);
+    maa_shm_transfer_unlock(bus);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_I2C_READ, 1, byte < 0);
     if (byte < 0) {
+        MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to read from i2c-%u", dev->adapter);
         return -1;
     }
     return byte;
@@ -101,9 +126,14 @@ maa_i2c_read_byte(maa_i2c_context dev)
 maa_result_t
 maa_i2c_write(maa_i2c_context dev, const uint8_t* data, int length)
 {
-    if (i2c_smbus_write_i2c_block_data(dev->fh, data[0], length-1, (uint8_t*) data+1) < 0) {
-        fprintf(stderr, "Failed to write to i2c\n");
-	return MAA_ERROR_INVALID_HANDLE;
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_I2C, dev->adapter);
+    int failed = i2c_smbus_write_i2c_block_data(dev->fh, data[0], length-1, (uint8_t*) data+1) < 0;
+    maa_shm_transfer_unlock(bus);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_I2C_WRITE, length, failed);
+    if (failed) {
+        return MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to write to i2c-%u", dev->adapter);
     }
     return MAA_SUCCESS;
 }
@@ -111,20 +141,42 @@ maa_i2c_write(maa_i2c_context dev, const uint8_t* data, int length)
 maa_result_t
 maa_i2c_write_byte(maa_i2c_context dev, const uint8_t data)
 {
-    if (i2c_smbus_write_byte(dev->fh, data) < 0) {
-        fprintf(stderr, "Failed to write to i2c\n");
-	return MAA_ERROR_INVALID_HANDLE;
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_I2C, dev->adapter);
+    int failed = i2c_smbus_write_byte(dev->fh, data) < 0;
+    maa_shm_transfer_unlock(bus);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_I2C_WRITE, 1, failed);
+    if (failed) {
+        return MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to write to i2c-%u", dev->adapter);
     }
     return MAA_SUCCESS;
 }
 
+maa_result_t
+maa_i2c_lock(maa_i2c_context dev)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    maa_shm_bus_lock(MAA_SHM_BUS_I2C, dev->adapter);
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_i2c_unlock(maa_i2c_context dev)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    maa_shm_bus_unlock(MAA_SHM_BUS_I2C, dev->adapter);
+    return MAA_SUCCESS;
+}
+
 maa_result_t
 maa_i2c_address(maa_i2c_context dev, int addr)
 {
     dev->addr = addr;
     if (ioctl(dev->fh, I2C_SLAVE_FORCE, addr) < 0) {
-        fprintf(stderr, "Failed to set slave address %d\n", addr);
-	return MAA_ERROR_INVALID_HANDLE;
+        return MAA_FAIL(MAA_ERROR_INVALID_HANDLE, "Failed to set slave address %d", addr);
     }
     return MAA_SUCCESS;
 }
@@ -132,6 +184,10 @@ maa_i2c_address(maa_i2c_context dev, int addr)
 maa_result_t
 maa_i2c_stop(maa_i2c_context dev)
 {
-    free(dev);
+    if (dev->fh > 0)
+        close(dev->fh);
+    if (dev->bus >= 0)
+        maa_release_i2c(dev->bus);
+    maa_pool_free(MAA_POOL_I2C, dev);
     return MAA_SUCCESS;
 }
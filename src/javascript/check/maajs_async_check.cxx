@@ -0,0 +1,33 @@
+/*
+ * Stand in for the swig generated wrapper around maajs_async.i. Only the
+ * parts of the swig v8 runtime the glue uses are declared, the object is
+ * never linked.
+ */
+
+#include <node.h>
+
+#include "common.h"
+#include "gpio.hpp"
+#include "i2c.hpp"
+#include "spi.hpp"
+#include "aio.hpp"
+
+#define SwigV8ReturnValue void
+#define SwigV8Arguments v8::FunctionCallbackInfo<v8::Value>
+#define SWIG_IsOK(r) ((r) >= 0)
+
+typedef struct swig_type_info swig_type_info;
+
+static swig_type_info* SWIGTYPE_p_maa__Gpio;
+static swig_type_info* SWIGTYPE_p_maa__I2c;
+static swig_type_info* SWIGTYPE_p_maa__Spi;
+static swig_type_info* SWIGTYPE_p_maa__Aio;
+
+static int
+SWIG_ConvertPtr(v8::Local<v8::Value> obj, void** ptr, swig_type_info* info, int flags)
+{
+    *ptr = NULL;
+    return -1;
+}
+
+#include "maajs_async_code.h"
@@ -3,3 +3,5 @@
 %feature("autodoc", "3");
 
 %include ../maa.i
+
+%include maajs_async.i
@@ -0,0 +1,444 @@
+// Asynchronous variants of the blocking libmaa calls for node. Every *Async
+// function queues the call on the libuv threadpool and returns a Promise that
+// is resolved on the event loop once the call completes. Calls on the same
+// object run one after the other, in the order they were made. Gpio interrupts are
+// forwarded to the event loop through a uv_async_t so that javascript is never
+// entered from the maa isr thread.
+
+%{
+#include <deque>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+#include <node.h>
+#include <node_buffer.h>
+#include "log.h"
+
+typedef enum {
+    MAAJS_GPIO_READ  = 0,
+    MAAJS_GPIO_WRITE = 1,
+    MAAJS_I2C_READ   = 2,
+    MAAJS_I2C_WRITE  = 3,
+    MAAJS_SPI_WRITE  = 4,
+    MAAJS_AIO_READ   = 5
+} maajs_async_op_t;
+
+typedef struct {
+    uv_work_t work;
+    maajs_async_op_t op;
+    void* dev; /**< maa::Gpio, maa::I2c, maa::Spi or maa::Aio */
+    uint8_t* buf; /**< tx buffer in, rx buffer out, owned by the request */
+    int length;
+    int arg;
+    int result;
+    v8::Persistent<v8::Object> owner; /**< keeps the js object alive */
+    v8::Persistent<v8::Promise::Resolver> resolver;
+    v8::Persistent<v8::Context> context;
+} maajs_async_req_t;
+
+typedef struct {
+    uv_async_t async;
+    maa::Gpio* gpio;
+    v8::Persistent<v8::Object> owner;
+    v8::Persistent<v8::Function> callback;
+    v8::Persistent<v8::Context> context;
+} maajs_isr_t;
+
+static std::map<maa::Gpio*, maajs_isr_t*> maajs_isrs;
+
+/* Requests waiting for an earlier one on the same object to complete. An
+ * object has an entry while one of its requests is on the threadpool. Only
+ * touched from the loop thread. */
+static std::map<void*, std::deque<maajs_async_req_t*> > maajs_busy;
+
+static void maajs_async_work(uv_work_t* work);
+static void maajs_async_after(uv_work_t* work, int status);
+
+static void
+maajs_async_submit(maajs_async_req_t* req)
+{
+    std::map<void*, std::deque<maajs_async_req_t*> >::iterator it = maajs_busy.find(req->dev);
+    if (it != maajs_busy.end()) {
+        it->second.push_back(req);
+        return;
+    }
+    maajs_busy[req->dev];
+    uv_queue_work(uv_default_loop(), &req->work, maajs_async_work, maajs_async_after);
+}
+
+static void
+maajs_async_next(void* dev)
+{
+    std::map<void*, std::deque<maajs_async_req_t*> >::iterator it = maajs_busy.find(dev);
+    if (it->second.empty()) {
+        maajs_busy.erase(it);
+        return;
+    }
+    maajs_async_req_t* next = it->second.front();
+    it->second.pop_front();
+    uv_queue_work(uv_default_loop(), &next->work, maajs_async_work, maajs_async_after);
+}
+
+static void
+maajs_async_work(uv_work_t* work)
+{
+    maajs_async_req_t* req = (maajs_async_req_t*) work->data;
+
+    switch (req->op) {
+        case MAAJS_GPIO_READ:
+            req->result = ((maa::Gpio*) req->dev)->read();
+            break;
+        case MAAJS_GPIO_WRITE:
+            req->result = ((maa::Gpio*) req->dev)->write(req->arg);
+            break;
+        case MAAJS_I2C_READ:
+            req->result = ((maa::I2c*) req->dev)->read(req->buf, req->length);
+            break;
+        case MAAJS_I2C_WRITE:
+            req->result = ((maa::I2c*) req->dev)->write(req->buf, req->length);
+            break;
+        case MAAJS_SPI_WRITE: {
+            unsigned char* recv = ((maa::Spi*) req->dev)->write(req->buf, req->length);
+            free(req->buf);
+            req->buf = recv;
+            req->result = (recv == NULL) ? MAA_ERROR_INVALID_RESOURCE : MAA_SUCCESS;
+            break;
+        }
+        case MAAJS_AIO_READ:
+            // the value cannot carry an error, the last error of this worker
+            // thread tells a failed read apart from a zero reading
+            maa_clear_error();
+            req->result = ((maa::Aio*) req->dev)->read();
+            if (maa_last_error()->code != MAA_SUCCESS)
+                req->result = -1;
+            break;
+    }
+}
+
+static void
+maajs_free_buffer(char* data, void* hint)
+{
+    free(data);
+}
+
+static void
+maajs_async_after(uv_work_t* work, int status)
+{
+    maajs_async_req_t* req = (maajs_async_req_t*) work->data;
+    maajs_async_next(req->dev);
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Context> context = v8::Local<v8::Context>::New(isolate, req->context);
+    v8::Context::Scope context_scope(context);
+    // run the promise reactions once we leave this callback, like node does
+    // for its own threadpool requests
+    node::CallbackScope callback_scope(isolate, v8::Object::New(isolate), {0, 0});
+    v8::Local<v8::Promise::Resolver> resolver =
+        v8::Local<v8::Promise::Resolver>::New(isolate, req->resolver);
+
+    v8::Local<v8::Value> value;
+    maa_boolean_t failed = (status != 0);
+    switch (req->op) {
+        case MAAJS_I2C_READ:
+            failed |= (req->result != req->length);
+            if (!failed) {
+                // the buffer is handed over to node, no copy is made
+                value = node::Buffer::New(isolate, (char*) req->buf, req->length,
+                                          maajs_free_buffer, NULL).ToLocalChecked();
+                req->buf = NULL;
+            }
+            break;
+        case MAAJS_SPI_WRITE:
+            failed |= (req->result != MAA_SUCCESS);
+            if (!failed) {
+                value = node::Buffer::New(isolate, (char*) req->buf, req->length,
+                                          maajs_free_buffer, NULL).ToLocalChecked();
+                req->buf = NULL;
+            }
+            break;
+        case MAAJS_GPIO_WRITE:
+        case MAAJS_I2C_WRITE:
+            failed |= (req->result != MAA_SUCCESS);
+            value = v8::Integer::New(isolate, req->result);
+            break;
+        case MAAJS_GPIO_READ:
+        case MAAJS_AIO_READ:
+            // both come back as -1 when the read failed
+            failed |= (req->result < 0);
+            value = v8::Integer::New(isolate, req->result);
+            break;
+    }
+
+    if (failed) {
+        resolver->Reject(context, v8::Exception::Error(
+            v8::String::NewFromUtf8(isolate, "maa operation failed").ToLocalChecked())).FromJust();
+    } else {
+        resolver->Resolve(context, value).FromJust();
+    }
+
+    free(req->buf);
+    req->owner.Reset();
+    req->resolver.Reset();
+    req->context.Reset();
+    delete req;
+}
+
+static void
+maajs_throw(v8::Isolate* isolate, const char* msg)
+{
+    isolate->ThrowException(v8::Exception::TypeError(
+        v8::String::NewFromUtf8(isolate, msg).ToLocalChecked()));
+}
+
+/**
+ * Validate the common part of an async call and return the unwrapped maa
+ * object in args[0], or NULL after throwing a javascript exception.
+ */
+static void*
+maajs_unwrap(const SwigV8Arguments &args, swig_type_info* type, int argc)
+{
+    void* dev = NULL;
+    if (args.Length() != argc) {
+        maajs_throw(args.GetIsolate(), "Illegal number of arguments");
+        return NULL;
+    }
+    if (!SWIG_IsOK(SWIG_ConvertPtr(args[0], &dev, type, 0)) || dev == NULL) {
+        maajs_throw(args.GetIsolate(), "Invalid maa object");
+        return NULL;
+    }
+    return dev;
+}
+
+/**
+ * Queue req on the libuv threadpool and return the pending Promise
+ */
+static void
+maajs_async_queue(const SwigV8Arguments &args, maajs_async_req_t* req)
+{
+    v8::Isolate* isolate = args.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    v8::Local<v8::Promise::Resolver> resolver =
+        v8::Promise::Resolver::New(context).ToLocalChecked();
+
+    req->work.data = req;
+    req->owner.Reset(isolate, args[0].As<v8::Object>());
+    req->resolver.Reset(isolate, resolver);
+    req->context.Reset(isolate, context);
+    maajs_async_submit(req);
+
+    args.GetReturnValue().Set(resolver->GetPromise());
+}
+
+static maajs_async_req_t*
+maajs_async_req_new(maajs_async_op_t op, void* dev)
+{
+    maajs_async_req_t* req = new maajs_async_req_t();
+    req->op = op;
+    req->dev = dev;
+    req->buf = NULL;
+    req->length = 0;
+    req->arg = 0;
+    req->result = 0;
+    return req;
+}
+
+/**
+ * Copy a node Buffer argument, the copy is needed because the js side may
+ * reuse the Buffer before the worker thread is done with it
+ */
+static maa_boolean_t
+maajs_copy_buffer(const SwigV8Arguments &args, int idx, maajs_async_req_t* req)
+{
+    if (!node::Buffer::HasInstance(args[idx])) {
+        maajs_throw(args.GetIsolate(), "Expected a Buffer");
+        return 0;
+    }
+    req->length = node::Buffer::Length(args[idx]);
+    req->buf = (uint8_t*) malloc(req->length);
+    if (req->buf == NULL) {
+        maajs_throw(args.GetIsolate(), "Out of memory");
+        return 0;
+    }
+    memcpy(req->buf, node::Buffer::Data(args[idx]), req->length);
+    return 1;
+}
+
+static SwigV8ReturnValue
+maajs_gpio_read_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__Gpio, 1);
+    if (dev == NULL)
+        return;
+    maajs_async_queue(args, maajs_async_req_new(MAAJS_GPIO_READ, dev));
+}
+
+static SwigV8ReturnValue
+maajs_gpio_write_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__Gpio, 2);
+    if (dev == NULL)
+        return;
+    maajs_async_req_t* req = maajs_async_req_new(MAAJS_GPIO_WRITE, dev);
+    req->arg = args[1]->Int32Value(args.GetIsolate()->GetCurrentContext()).FromMaybe(0);
+    maajs_async_queue(args, req);
+}
+
+static SwigV8ReturnValue
+maajs_i2c_read_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__I2c, 2);
+    if (dev == NULL)
+        return;
+    int length = args[1]->Int32Value(args.GetIsolate()->GetCurrentContext()).FromMaybe(0);
+    if (length <= 0) {
+        maajs_throw(args.GetIsolate(), "Invalid read length");
+        return;
+    }
+    maajs_async_req_t* req = maajs_async_req_new(MAAJS_I2C_READ, dev);
+    req->length = length;
+    req->buf = (uint8_t*) malloc(length);
+    if (req->buf == NULL) {
+        delete req;
+        maajs_throw(args.GetIsolate(), "Out of memory");
+        return;
+    }
+    maajs_async_queue(args, req);
+}
+
+static SwigV8ReturnValue
+maajs_i2c_write_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__I2c, 2);
+    if (dev == NULL)
+        return;
+    maajs_async_req_t* req = maajs_async_req_new(MAAJS_I2C_WRITE, dev);
+    if (!maajs_copy_buffer(args, 1, req)) {
+        free(req->buf);
+        delete req;
+        return;
+    }
+    maajs_async_queue(args, req);
+}
+
+static SwigV8ReturnValue
+maajs_spi_write_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__Spi, 2);
+    if (dev == NULL)
+        return;
+    maajs_async_req_t* req = maajs_async_req_new(MAAJS_SPI_WRITE, dev);
+    if (!maajs_copy_buffer(args, 1, req)) {
+        free(req->buf);
+        delete req;
+        return;
+    }
+    maajs_async_queue(args, req);
+}
+
+static SwigV8ReturnValue
+maajs_aio_read_async(const SwigV8Arguments &args)
+{
+    void* dev = maajs_unwrap(args, SWIGTYPE_p_maa__Aio, 1);
+    if (dev == NULL)
+        return;
+    maajs_async_queue(args, maajs_async_req_new(MAAJS_AIO_READ, dev));
+}
+
+/**
+ * Runs on the maa isr thread, all we can do from here is to wake up the loop.
+ * Several edges arriving before the loop runs are coalesced into one call.
+ */
+static void
+maajs_isr_trampoline(void* args)
+{
+    maajs_isr_t* isr = (maajs_isr_t*) args;
+    uv_async_send(&isr->async);
+}
+
+static void
+maajs_isr_async_cb(uv_async_t* handle)
+{
+    maajs_isr_t* isr = (maajs_isr_t*) handle->data;
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Context> context = v8::Local<v8::Context>::New(isolate, isr->context);
+    v8::Context::Scope context_scope(context);
+    v8::Local<v8::Function> callback = v8::Local<v8::Function>::New(isolate, isr->callback);
+    v8::Local<v8::Object> owner = v8::Local<v8::Object>::New(isolate, isr->owner);
+
+    node::MakeCallback(isolate, owner, callback, 0, NULL, {0, 0});
+}
+
+static void
+maajs_isr_close_cb(uv_handle_t* handle)
+{
+    maajs_isr_t* isr = (maajs_isr_t*) handle->data;
+    isr->owner.Reset();
+    isr->callback.Reset();
+    isr->context.Reset();
+    delete isr;
+}
+
+static SwigV8ReturnValue
+maajs_gpio_isr(const SwigV8Arguments &args)
+{
+    v8::Isolate* isolate = args.GetIsolate();
+    maa::Gpio* gpio = (maa::Gpio*) maajs_unwrap(args, SWIGTYPE_p_maa__Gpio, 3);
+    if (gpio == NULL)
+        return;
+    if (!args[2]->IsFunction()) {
+        maajs_throw(isolate, "Expected a callback function");
+        return;
+    }
+    if (maajs_isrs.count(gpio) != 0) {
+        args.GetReturnValue().Set(v8::Integer::New(isolate, MAA_ERROR_NO_RESOURCES));
+        return;
+    }
+
+    maajs_isr_t* isr = new maajs_isr_t();
+    isr->gpio = gpio;
+    isr->async.data = isr;
+    isr->owner.Reset(isolate, args[0].As<v8::Object>());
+    isr->callback.Reset(isolate, args[2].As<v8::Function>());
+    isr->context.Reset(isolate, isolate->GetCurrentContext());
+    uv_async_init(uv_default_loop(), &isr->async, maajs_isr_async_cb);
+
+    maa::Edge edge = (maa::Edge) args[1]->Int32Value(isolate->GetCurrentContext()).FromMaybe(0);
+    maa_result_t ret = gpio->isr(edge, maajs_isr_trampoline, isr);
+    if (ret != MAA_SUCCESS) {
+        uv_close((uv_handle_t*) &isr->async, maajs_isr_close_cb);
+    } else {
+        maajs_isrs[gpio] = isr;
+    }
+    args.GetReturnValue().Set(v8::Integer::New(isolate, ret));
+}
+
+static SwigV8ReturnValue
+maajs_gpio_isr_exit(const SwigV8Arguments &args)
+{
+    v8::Isolate* isolate = args.GetIsolate();
+    maa::Gpio* gpio = (maa::Gpio*) maajs_unwrap(args, SWIGTYPE_p_maa__Gpio, 1);
+    if (gpio == NULL)
+        return;
+
+    // isrExit() joins the isr thread, after it returns no uv_async_send()
+    // can still be running on the handle we are about to close
+    maa_result_t ret = gpio->isrExit();
+    std::map<maa::Gpio*, maajs_isr_t*>::iterator it = maajs_isrs.find(gpio);
+    if (it != maajs_isrs.end()) {
+        uv_close((uv_handle_t*) &it->second->async, maajs_isr_close_cb);
+        maajs_isrs.erase(it);
+    }
+    args.GetReturnValue().Set(v8::Integer::New(isolate, ret));
+}
+%}
+
+%native(gpioReadAsync) void maajs_gpio_read_async();
+%native(gpioWriteAsync) void maajs_gpio_write_async();
+%native(gpioIsr) void maajs_gpio_isr();
+%native(gpioIsrExit) void maajs_gpio_isr_exit();
+%native(i2cReadAsync) void maajs_i2c_read_async();
+%native(i2cWriteAsync) void maajs_i2c_write_async();
+%native(spiWriteAsync) void maajs_spi_write_async();
+%native(aioReadAsync) void maajs_aio_read_async();
@@ -0,0 +1,911 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief N-API binding for node
+ *
+ * Unlike the swig generated module this only uses the stable N-API ABI so the
+ * same maa_napi.node keeps working across node and V8 upgrades. Contexts are
+ * pinned in native objects, Buffers are used in place without copies and
+ * every blocking call has a Promise returning *Async variant running on the
+ * libuv threadpool. Asynchronous operations on one object run one after the
+ * other in the order they were issued. Gpio interrupts are forwarded to the
+ * javascript callback through a threadsafe function.
+ */
+
+#define NAPI_VERSION 4
+
+#include <stdlib.h>
+#include <string.h>
+#include <node_api.h>
+
+#include "maa.h"
+
+#define MAA_NAPI_CALL(env, call)                                    \
+    do {                                                            \
+        if ((call) != napi_ok) {                                    \
+            napi_throw_error((env), NULL, "N-API call failed: " #call); \
+            return NULL;                                            \
+        }                                                           \
+    } while (0)
+
+#define MAA_NAPI_MAX_ARGS 3
+/* completed requests an object keeps for its next async calls */
+#define MAA_NAPI_MAX_SPARE 4
+
+typedef enum {
+    MAA_NAPI_GPIO = 0,
+    MAA_NAPI_I2C  = 1,
+    MAA_NAPI_SPI  = 2,
+    MAA_NAPI_AIO  = 3
+} maa_napi_type_t;
+
+typedef enum {
+    MAA_NAPI_GPIO_READ    = 0,
+    MAA_NAPI_GPIO_WRITE   = 1,
+    MAA_NAPI_I2C_READ     = 2,
+    MAA_NAPI_I2C_WRITE    = 3,
+    MAA_NAPI_SPI_TRANSFER = 4,
+    MAA_NAPI_AIO_READ     = 5
+} maa_napi_op_t;
+
+typedef struct _maa_napi_async maa_napi_async_t;
+
+/**
+ * Native side of every wrapped javascript object
+ */
+typedef struct {
+    /*@{*/
+    maa_napi_type_t type; /**< which kind of context ctx is */
+    void* ctx; /**< the maa context, NULL once closed */
+    int pending; /**< async operations in flight or waiting */
+    maa_napi_async_t* waiting; /**< operations queued behind the running one */
+    maa_napi_async_t* waiting_tail; /**< last entry of waiting */
+    napi_threadsafe_function isr; /**< javascript isr callback, NULL if none */
+    maa_napi_async_t* spare; /**< completed requests kept for reuse */
+    int spares; /**< entries of spare */
+    /*@}*/
+} maa_napi_obj_t;
+
+/**
+ * An operation queued on the libuv threadpool
+ */
+struct _maa_napi_async {
+    /*@{*/
+    napi_async_work work;
+    napi_deferred deferred;
+    napi_ref this_ref; /**< keeps the object alive */
+    napi_ref buf_ref[2]; /**< keeps the Buffers alive, may be NULL */
+    maa_napi_obj_t* obj;
+    maa_napi_op_t op;
+    uint8_t* tx; /**< Buffer memory, used in place */
+    uint8_t* rx; /**< Buffer memory, used in place */
+    int length;
+    int arg;
+    int result;
+    maa_napi_async_t* next; /**< next entry of the object's waiting or spare list */
+    /*@}*/
+};
+
+/**
+ * Fetch this, the native object and up to MAA_NAPI_MAX_ARGS arguments. Throws
+ * and returns NULL if the object was closed or too few arguments were given.
+ */
+static maa_napi_obj_t*
+maa_napi_this(napi_env env, napi_callback_info info, size_t min_args, napi_value* argv, napi_value* thisv)
+{
+    size_t argc = MAA_NAPI_MAX_ARGS;
+    maa_napi_obj_t* obj = NULL;
+    napi_value self;
+
+    if (napi_get_cb_info(env, info, &argc, argv, &self, NULL) != napi_ok)
+        return NULL;
+    if (argc < min_args) {
+        napi_throw_type_error(env, NULL, "Wrong number of arguments");
+        return NULL;
+    }
+    if (napi_unwrap(env, self, (void**) &obj) != napi_ok || obj == NULL) {
+        napi_throw_type_error(env, NULL, "Not a maa object");
+        return NULL;
+    }
+    if (obj->ctx == NULL) {
+        napi_throw_error(env, NULL, "Context is closed");
+        return NULL;
+    }
+    if (thisv != NULL)
+        *thisv = self;
+    return obj;
+}
+
+/**
+ * maa_napi_this() for synchronous calls. They would race the threadpool for
+ * the context, so they throw while async operations are pending.
+ */
+static maa_napi_obj_t*
+maa_napi_this_sync(napi_env env, napi_callback_info info, size_t min_args, napi_value* argv)
+{
+    maa_napi_obj_t* obj = maa_napi_this(env, info, min_args, argv, NULL);
+    if (obj != NULL && obj->pending > 0) {
+        napi_throw_error(env, NULL, "Asynchronous operations still pending");
+        return NULL;
+    }
+    return obj;
+}
+
+static napi_value
+maa_napi_int(napi_env env, int value)
+{
+    napi_value ret;
+    MAA_NAPI_CALL(env, napi_create_int32(env, value, &ret));
+    return ret;
+}
+
+static int
+maa_napi_get_int(napi_env env, napi_value value, int* out)
+{
+    int32_t v;
+    if (napi_get_value_int32(env, value, &v) != napi_ok) {
+        napi_throw_type_error(env, NULL, "Expected a number");
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+static int
+maa_napi_get_buffer(napi_env env, napi_value value, uint8_t** data, int* length)
+{
+    size_t len;
+    if (napi_get_buffer_info(env, value, (void**) data, &len) != napi_ok) {
+        napi_throw_type_error(env, NULL, "Expected a Buffer");
+        return 0;
+    }
+    *length = (int) len;
+    return 1;
+}
+
+/**
+ * Stop the interrupt thread, waiting for a running callback to be handed
+ * over, then let go of the javascript callback.
+ */
+static void
+maa_napi_isr_stop(maa_napi_obj_t* obj)
+{
+    if (obj->isr == NULL)
+        return;
+    maa_gpio_isr_exit((maa_gpio_context) obj->ctx);
+    napi_release_threadsafe_function(obj->isr, napi_tsfn_release);
+    obj->isr = NULL;
+}
+
+static void
+maa_napi_close_ctx(maa_napi_obj_t* obj)
+{
+    if (obj->ctx == NULL)
+        return;
+    maa_napi_isr_stop(obj);
+    switch (obj->type) {
+        case MAA_NAPI_GPIO:
+            maa_gpio_close((maa_gpio_context) obj->ctx);
+            break;
+        case MAA_NAPI_I2C:
+            maa_i2c_stop((maa_i2c_context) obj->ctx);
+            break;
+        case MAA_NAPI_SPI:
+            maa_spi_stop((maa_spi_context) obj->ctx);
+            break;
+        case MAA_NAPI_AIO:
+            maa_aio_close((maa_aio_context) obj->ctx);
+            break;
+    }
+    obj->ctx = NULL;
+}
+
+static void
+maa_napi_finalize(napi_env env, void* data, void* hint)
+{
+    maa_napi_obj_t* obj = (maa_napi_obj_t*) data;
+    maa_napi_close_ctx(obj);
+    while (obj->spare != NULL) {
+        maa_napi_async_t* req = obj->spare;
+        obj->spare = req->next;
+        free(req);
+    }
+    free(obj);
+}
+
+static napi_value
+maa_napi_wrap(napi_env env, napi_callback_info info, maa_napi_type_t type)
+{
+    size_t argc = 2;
+    napi_value argv[2];
+    napi_value self;
+    int id;
+    int raw = 0;
+
+    MAA_NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, &self, NULL));
+    if (argc < 1 || !maa_napi_get_int(env, argv[0], &id))
+        return NULL;
+    if (argc > 1) {
+        bool b;
+        MAA_NAPI_CALL(env, napi_get_value_bool(env, argv[1], &b));
+        raw = b;
+    }
+
+    void* ctx = NULL;
+    switch (type) {
+        case MAA_NAPI_GPIO:
+            ctx = raw ? maa_gpio_init_raw(id) : maa_gpio_init(id);
+            break;
+        case MAA_NAPI_I2C:
+            ctx = raw ? maa_i2c_init_raw(id) : maa_i2c_init(id);
+            break;
+        case MAA_NAPI_SPI:
+            ctx = maa_spi_init(id);
+            break;
+        case MAA_NAPI_AIO:
+            ctx = maa_aio_init(id);
+            break;
+    }
+    if (ctx == NULL) {
+        napi_throw_error(env, NULL, "Failed to initialise context");
+        return NULL;
+    }
+
+    maa_napi_obj_t* obj = (maa_napi_obj_t*) calloc(1, sizeof(maa_napi_obj_t));
+    if (obj == NULL) {
+        maa_napi_obj_t tmp = { type, ctx, 0, NULL, NULL, NULL, NULL, 0 };
+        maa_napi_close_ctx(&tmp);
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    obj->type = type;
+    obj->ctx = ctx;
+    if (napi_wrap(env, self, obj, maa_napi_finalize, NULL, NULL) != napi_ok) {
+        maa_napi_finalize(env, obj, NULL);
+        napi_throw_error(env, NULL, "Failed to wrap context");
+        return NULL;
+    }
+    return self;
+}
+
+static napi_value
+maa_napi_close(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 0, argv);
+    if (obj == NULL)
+        return NULL;
+    maa_napi_close_ctx(obj);
+    return maa_napi_int(env, MAA_SUCCESS);
+}
+
+/* ---- async operations ---- */
+
+/**
+ * Take a request for obj, a spare one when the object has any so that a
+ * steady stream of async calls does not allocate
+ */
+static maa_napi_async_t*
+maa_napi_async_new(maa_napi_obj_t* obj, maa_napi_op_t op)
+{
+    maa_napi_async_t* req = obj->spare;
+    if (req != NULL) {
+        obj->spare = req->next;
+        obj->spares--;
+        memset(req, 0, sizeof(maa_napi_async_t));
+    } else {
+        req = (maa_napi_async_t*) calloc(1, sizeof(maa_napi_async_t));
+        if (req == NULL)
+            return NULL;
+    }
+    req->obj = obj;
+    req->op = op;
+    return req;
+}
+
+/**
+ * Hand a request that is done with back to its object
+ */
+static void
+maa_napi_async_release(maa_napi_async_t* req)
+{
+    maa_napi_obj_t* obj = req->obj;
+    if (obj->spares >= MAA_NAPI_MAX_SPARE) {
+        free(req);
+        return;
+    }
+    req->next = obj->spare;
+    obj->spare = req;
+    obj->spares++;
+}
+
+static void
+maa_napi_execute(napi_env env, void* data)
+{
+    maa_napi_async_t* req = (maa_napi_async_t*) data;
+    void* ctx = req->obj->ctx;
+
+    switch (req->op) {
+        case MAA_NAPI_GPIO_READ:
+            req->result = maa_gpio_read((maa_gpio_context) ctx);
+            break;
+        case MAA_NAPI_GPIO_WRITE:
+            req->result = maa_gpio_write((maa_gpio_context) ctx, req->arg);
+            break;
+        case MAA_NAPI_I2C_READ:
+            req->result = maa_i2c_read((maa_i2c_context) ctx, req->rx, req->length);
+            break;
+        case MAA_NAPI_I2C_WRITE:
+            req->result = maa_i2c_write((maa_i2c_context) ctx, req->tx, req->length);
+            break;
+        case MAA_NAPI_SPI_TRANSFER:
+            req->result = maa_spi_transfer_buf((maa_spi_context) ctx, req->tx, req->rx, req->length);
+            break;
+        case MAA_NAPI_AIO_READ:
+            // a failed read still returns a value, the last error of this
+            // worker thread tells it apart from a zero reading
+            maa_clear_error();
+            req->result = maa_aio_read((maa_aio_context) ctx);
+            if (maa_last_error()->code != MAA_SUCCESS)
+                req->result = -1;
+            break;
+    }
+}
+
+static void
+maa_napi_complete(napi_env env, napi_status status, void* data)
+{
+    maa_napi_async_t* req = (maa_napi_async_t*) data;
+    napi_value value;
+    int failed = (status != napi_ok);
+
+    switch (req->op) {
+        case MAA_NAPI_GPIO_WRITE:
+        case MAA_NAPI_I2C_WRITE:
+        case MAA_NAPI_SPI_TRANSFER:
+            failed |= (req->result != MAA_SUCCESS);
+            break;
+        case MAA_NAPI_I2C_READ:
+            failed |= (req->result != req->length);
+            break;
+        case MAA_NAPI_GPIO_READ:
+        case MAA_NAPI_AIO_READ:
+            failed |= (req->result < 0);
+            break;
+    }
+
+    napi_create_int32(env, req->result, &value);
+    if (failed) {
+        napi_value msg, err;
+        napi_create_string_utf8(env, "maa operation failed", NAPI_AUTO_LENGTH, &msg);
+        napi_create_error(env, NULL, msg, &err);
+        napi_reject_deferred(env, req->deferred, err);
+    } else {
+        napi_resolve_deferred(env, req->deferred, value);
+    }
+
+    maa_napi_obj_t* obj = req->obj;
+    obj->pending--;
+    if (obj->waiting != NULL) {
+        maa_napi_async_t* next = obj->waiting;
+        obj->waiting = next->next;
+        if (obj->waiting == NULL)
+            obj->waiting_tail = NULL;
+        napi_queue_async_work(env, next->work);
+    }
+
+    if (req->buf_ref[0] != NULL)
+        napi_delete_reference(env, req->buf_ref[0]);
+    if (req->buf_ref[1] != NULL)
+        napi_delete_reference(env, req->buf_ref[1]);
+    napi_delete_async_work(env, req->work);
+    // the object may only go away once the request is off our hands
+    napi_ref this_ref = req->this_ref;
+    maa_napi_async_release(req);
+    napi_delete_reference(env, this_ref);
+}
+
+/**
+ * Queue req and return its Promise. Buffers passed in bufs are referenced
+ * until the operation completes. Only one operation per object is handed to
+ * the threadpool at a time, the others wait in issue order.
+ */
+static napi_value
+maa_napi_async_queue(napi_env env, napi_value self, maa_napi_async_t* req, napi_value* bufs, int nbufs)
+{
+    napi_value promise, name;
+    int i;
+
+    if (req == NULL) {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    if (napi_create_promise(env, &req->deferred, &promise) != napi_ok) {
+        maa_napi_async_release(req);
+        napi_throw_error(env, NULL, "Failed to create promise");
+        return NULL;
+    }
+    if (napi_create_reference(env, self, 1, &req->this_ref) != napi_ok) {
+        // a deferred must be settled exactly once or it is never released
+        napi_value msg, err;
+        napi_create_string_utf8(env, "Failed to reference object", NAPI_AUTO_LENGTH, &msg);
+        napi_create_error(env, NULL, msg, &err);
+        napi_reject_deferred(env, req->deferred, err);
+        maa_napi_async_release(req);
+        napi_throw_error(env, NULL, "Failed to reference object");
+        return NULL;
+    }
+    for (i = 0; i < nbufs; i++) {
+        napi_create_reference(env, bufs[i], 1, &req->buf_ref[i]);
+    }
+    napi_create_string_utf8(env, "maa", NAPI_AUTO_LENGTH, &name);
+    napi_create_async_work(env, NULL, name, maa_napi_execute, maa_napi_complete, req, &req->work);
+
+    maa_napi_obj_t* obj = req->obj;
+    if (obj->pending == 0) {
+        napi_queue_async_work(env, req->work);
+    } else if (obj->waiting_tail != NULL) {
+        obj->waiting_tail->next = req;
+        obj->waiting_tail = req;
+    } else {
+        obj->waiting = obj->waiting_tail = req;
+    }
+    obj->pending++;
+    return promise;
+}
+
+/* ---- Gpio ---- */
+
+static napi_value
+maa_napi_gpio_new(napi_env env, napi_callback_info info)
+{
+    return maa_napi_wrap(env, info, MAA_NAPI_GPIO);
+}
+
+static napi_value
+maa_napi_gpio_dir(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_gpio_dir((maa_gpio_context) obj->ctx, (gpio_dir_t) v));
+}
+
+static napi_value
+maa_napi_gpio_mode(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_gpio_mode((maa_gpio_context) obj->ctx, (gpio_mode_t) v));
+}
+
+static napi_value
+maa_napi_gpio_use_mmaped(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    bool b;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL)
+        return NULL;
+    MAA_NAPI_CALL(env, napi_get_value_bool(env, argv[0], &b));
+    return maa_napi_int(env, maa_gpio_use_mmaped((maa_gpio_context) obj->ctx, b));
+}
+
+static napi_value
+maa_napi_gpio_read(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 0, argv);
+    if (obj == NULL)
+        return NULL;
+    return maa_napi_int(env, maa_gpio_read((maa_gpio_context) obj->ctx));
+}
+
+static napi_value
+maa_napi_gpio_write(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_gpio_write((maa_gpio_context) obj->ctx, v));
+}
+
+static napi_value
+maa_napi_gpio_read_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    maa_napi_obj_t* obj = maa_napi_this(env, info, 0, argv, &self);
+    if (obj == NULL)
+        return NULL;
+    return maa_napi_async_queue(env, self, maa_napi_async_new(obj, MAA_NAPI_GPIO_READ), NULL, 0);
+}
+
+static napi_value
+maa_napi_gpio_write_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this(env, info, 1, argv, &self);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    maa_napi_async_t* req = maa_napi_async_new(obj, MAA_NAPI_GPIO_WRITE);
+    if (req != NULL)
+        req->arg = v;
+    return maa_napi_async_queue(env, self, req, NULL, 0);
+}
+
+/**
+ * Runs on the interrupt thread, only hands the edge over to the javascript
+ * thread so a slow callback never holds up maa_gpio_isr_exit()
+ */
+static void
+maa_napi_isr_fire(void* args)
+{
+    maa_napi_obj_t* obj = (maa_napi_obj_t*) args;
+    napi_call_threadsafe_function(obj->isr, NULL, napi_tsfn_nonblocking);
+}
+
+static void
+maa_napi_isr_call(napi_env env, napi_value callback, void* context, void* data)
+{
+    napi_value undefined;
+    if (env == NULL || callback == NULL)
+        return;
+    napi_get_undefined(env, &undefined);
+    napi_call_function(env, undefined, callback, 0, NULL, NULL);
+}
+
+/**
+ * isr(edge, callback), replaces a previously set callback
+ */
+static napi_value
+maa_napi_gpio_isr(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], name;
+    napi_valuetype type;
+    int edge;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 2, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &edge))
+        return NULL;
+    MAA_NAPI_CALL(env, napi_typeof(env, argv[1], &type));
+    if (type != napi_function) {
+        napi_throw_type_error(env, NULL, "Expected a function");
+        return NULL;
+    }
+
+    maa_napi_isr_stop(obj);
+    MAA_NAPI_CALL(env, napi_create_string_utf8(env, "maa isr", NAPI_AUTO_LENGTH, &name));
+    MAA_NAPI_CALL(env, napi_create_threadsafe_function(env, argv[1], NULL, name, 0, 1, NULL, NULL,
+                                                       NULL, maa_napi_isr_call, &obj->isr));
+
+    maa_result_t ret = maa_gpio_isr((maa_gpio_context) obj->ctx, (gpio_edge_t) edge, maa_napi_isr_fire, obj);
+    if (ret != MAA_SUCCESS) {
+        napi_release_threadsafe_function(obj->isr, napi_tsfn_release);
+        obj->isr = NULL;
+    }
+    return maa_napi_int(env, ret);
+}
+
+static napi_value
+maa_napi_gpio_isr_exit(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 0, argv);
+    if (obj == NULL)
+        return NULL;
+    maa_napi_isr_stop(obj);
+    return maa_napi_int(env, MAA_SUCCESS);
+}
+
+/* ---- I2c ---- */
+
+static napi_value
+maa_napi_i2c_new(napi_env env, napi_callback_info info)
+{
+    return maa_napi_wrap(env, info, MAA_NAPI_I2C);
+}
+
+static napi_value
+maa_napi_i2c_address(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_i2c_address((maa_i2c_context) obj->ctx, v));
+}
+
+static napi_value
+maa_napi_i2c_frequency(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_i2c_frequency((maa_i2c_context) obj->ctx, v));
+}
+
+static napi_value
+maa_napi_i2c_read(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    uint8_t* data;
+    int length;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_buffer(env, argv[0], &data, &length))
+        return NULL;
+    return maa_napi_int(env, maa_i2c_read((maa_i2c_context) obj->ctx, data, length));
+}
+
+static napi_value
+maa_napi_i2c_write(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    uint8_t* data;
+    int length;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_buffer(env, argv[0], &data, &length))
+        return NULL;
+    return maa_napi_int(env, maa_i2c_write((maa_i2c_context) obj->ctx, data, length));
+}
+
+static napi_value
+maa_napi_i2c_read_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    uint8_t* data;
+    int length;
+    maa_napi_obj_t* obj = maa_napi_this(env, info, 1, argv, &self);
+    if (obj == NULL || !maa_napi_get_buffer(env, argv[0], &data, &length))
+        return NULL;
+    maa_napi_async_t* req = maa_napi_async_new(obj, MAA_NAPI_I2C_READ);
+    if (req != NULL) {
+        req->rx = data;
+        req->length = length;
+    }
+    return maa_napi_async_queue(env, self, req, argv, 1);
+}
+
+static napi_value
+maa_napi_i2c_write_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    uint8_t* data;
+    int length;
+    maa_napi_obj_t* obj = maa_napi_this(env, info, 1, argv, &self);
+    if (obj == NULL || !maa_napi_get_buffer(env, argv[0], &data, &length))
+        return NULL;
+    maa_napi_async_t* req = maa_napi_async_new(obj, MAA_NAPI_I2C_WRITE);
+    if (req != NULL) {
+        req->tx = data;
+        req->length = length;
+    }
+    return maa_napi_async_queue(env, self, req, argv, 1);
+}
+
+/* ---- Spi ---- */
+
+static napi_value
+maa_napi_spi_new(napi_env env, napi_callback_info info)
+{
+    return maa_napi_wrap(env, info, MAA_NAPI_SPI);
+}
+
+static napi_value
+maa_napi_spi_mode(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_spi_mode((maa_spi_context) obj->ctx, (unsigned short) v));
+}
+
+static napi_value
+maa_napi_spi_frequency(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    int v;
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 1, argv);
+    if (obj == NULL || !maa_napi_get_int(env, argv[0], &v))
+        return NULL;
+    return maa_napi_int(env, maa_spi_frequency((maa_spi_context) obj->ctx, v));
+}
+
+/**
+ * transfer(tx[, rx]), rx defaults to tx for an in place transfer
+ */
+static int
+maa_napi_spi_buffers(napi_env env, napi_callback_info info, maa_napi_obj_t** obj, napi_value* self,
+                     napi_value* argv, uint8_t** tx, uint8_t** rx, int* length, int* nbufs)
+{
+    size_t argc = MAA_NAPI_MAX_ARGS;
+    int rxlen;
+
+    *obj = maa_napi_this(env, info, 1, argv, self);
+    if (*obj == NULL || !maa_napi_get_buffer(env, argv[0], tx, length))
+        return 0;
+    napi_get_cb_info(env, info, &argc, NULL, NULL, NULL);
+    *rx = *tx;
+    *nbufs = 1;
+    if (argc > 1) {
+        if (!maa_napi_get_buffer(env, argv[1], rx, &rxlen))
+            return 0;
+        if (rxlen < *length) {
+            napi_throw_range_error(env, NULL, "rx Buffer is smaller than tx Buffer");
+            return 0;
+        }
+        *nbufs = 2;
+    }
+    return 1;
+}
+
+static napi_value
+maa_napi_spi_transfer(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    maa_napi_obj_t* obj;
+    uint8_t *tx, *rx;
+    int length, nbufs;
+    if (!maa_napi_spi_buffers(env, info, &obj, &self, argv, &tx, &rx, &length, &nbufs))
+        return NULL;
+    if (obj->pending > 0) {
+        napi_throw_error(env, NULL, "Asynchronous operations still pending");
+        return NULL;
+    }
+    return maa_napi_int(env, maa_spi_transfer_buf((maa_spi_context) obj->ctx, tx, rx, length));
+}
+
+static napi_value
+maa_napi_spi_transfer_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    maa_napi_obj_t* obj;
+    uint8_t *tx, *rx;
+    int length, nbufs;
+    if (!maa_napi_spi_buffers(env, info, &obj, &self, argv, &tx, &rx, &length, &nbufs))
+        return NULL;
+    maa_napi_async_t* req = maa_napi_async_new(obj, MAA_NAPI_SPI_TRANSFER);
+    if (req != NULL) {
+        req->tx = tx;
+        req->rx = rx;
+        req->length = length;
+    }
+    return maa_napi_async_queue(env, self, req, argv, nbufs);
+}
+
+/* ---- Aio ---- */
+
+static napi_value
+maa_napi_aio_new(napi_env env, napi_callback_info info)
+{
+    return maa_napi_wrap(env, info, MAA_NAPI_AIO);
+}
+
+static napi_value
+maa_napi_aio_read(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS];
+    maa_napi_obj_t* obj = maa_napi_this_sync(env, info, 0, argv);
+    if (obj == NULL)
+        return NULL;
+    return maa_napi_int(env, maa_aio_read((maa_aio_context) obj->ctx));
+}
+
+static napi_value
+maa_napi_aio_read_async(napi_env env, napi_callback_info info)
+{
+    napi_value argv[MAA_NAPI_MAX_ARGS], self;
+    maa_napi_obj_t* obj = maa_napi_this(env, info, 0, argv, &self);
+    if (obj == NULL)
+        return NULL;
+    return maa_napi_async_queue(env, self, maa_napi_async_new(obj, MAA_NAPI_AIO_READ), NULL, 0);
+}
+
+/* ---- module ---- */
+
+#define MAA_NAPI_METHOD(name, fn) { name, NULL, fn, NULL, NULL, NULL, napi_default, NULL }
+
+static int
+maa_napi_define(napi_env env, napi_value exports, const char* name,
+                napi_callback ctor, const napi_property_descriptor* props, size_t nprops)
+{
+    napi_value cls;
+    if (napi_define_class(env, name, NAPI_AUTO_LENGTH, ctor, NULL, nprops, props, &cls) != napi_ok)
+        return 0;
+    return napi_set_named_property(env, exports, name, cls) == napi_ok;
+}
+
+static napi_value
+maa_napi_init(napi_env env, napi_value exports)
+{
+    static const napi_property_descriptor gpio[] = {
+        MAA_NAPI_METHOD("dir", maa_napi_gpio_dir),
+        MAA_NAPI_METHOD("mode", maa_napi_gpio_mode),
+        MAA_NAPI_METHOD("useMmaped", maa_napi_gpio_use_mmaped),
+        MAA_NAPI_METHOD("read", maa_napi_gpio_read),
+        MAA_NAPI_METHOD("write", maa_napi_gpio_write),
+        MAA_NAPI_METHOD("readAsync", maa_napi_gpio_read_async),
+        MAA_NAPI_METHOD("writeAsync", maa_napi_gpio_write_async),
+        MAA_NAPI_METHOD("isr", maa_napi_gpio_isr),
+        MAA_NAPI_METHOD("isrExit", maa_napi_gpio_isr_exit),
+        MAA_NAPI_METHOD("close", maa_napi_close),
+    };
+    static const napi_property_descriptor i2c[] = {
+        MAA_NAPI_METHOD("address", maa_napi_i2c_address),
+        MAA_NAPI_METHOD("frequency", maa_napi_i2c_frequency),
+        MAA_NAPI_METHOD("read", maa_napi_i2c_read),
+        MAA_NAPI_METHOD("write", maa_napi_i2c_write),
+        MAA_NAPI_METHOD("readAsync", maa_napi_i2c_read_async),
+        MAA_NAPI_METHOD("writeAsync", maa_napi_i2c_write_async),
+        MAA_NAPI_METHOD("close", maa_napi_close),
+    };
+    static const napi_property_descriptor spi[] = {
+        MAA_NAPI_METHOD("mode", maa_napi_spi_mode),
+        MAA_NAPI_METHOD("frequency", maa_napi_spi_frequency),
+        MAA_NAPI_METHOD("transfer", maa_napi_spi_transfer),
+        MAA_NAPI_METHOD("transferAsync", maa_napi_spi_transfer_async),
+        MAA_NAPI_METHOD("close", maa_napi_close),
+    };
+    static const napi_property_descriptor aio[] = {
+        MAA_NAPI_METHOD("read", maa_napi_aio_read),
+        MAA_NAPI_METHOD("readAsync", maa_napi_aio_read_async),
+        MAA_NAPI_METHOD("close", maa_napi_close),
+    };
+
+    if (!maa_napi_define(env, exports, "Gpio", maa_napi_gpio_new, gpio, sizeof(gpio) / sizeof(gpio[0])) ||
+        !maa_napi_define(env, exports, "I2c", maa_napi_i2c_new, i2c, sizeof(i2c) / sizeof(i2c[0])) ||
+        !maa_napi_define(env, exports, "Spi", maa_napi_spi_new, spi, sizeof(spi) / sizeof(spi[0])) ||
+        !maa_napi_define(env, exports, "Aio", maa_napi_aio_new, aio, sizeof(aio) / sizeof(aio[0]))) {
+        napi_throw_error(env, NULL, "Failed to define maa classes");
+        return NULL;
+    }
+
+    napi_set_named_property(env, exports, "DIR_OUT", maa_napi_int(env, MAA_GPIO_OUT));
+    napi_set_named_property(env, exports, "DIR_IN", maa_napi_int(env, MAA_GPIO_IN));
+    napi_set_named_property(env, exports, "MODE_STRONG", maa_napi_int(env, MAA_GPIO_STRONG));
+    napi_set_named_property(env, exports, "MODE_PULLUP", maa_napi_int(env, MAA_GPIO_PULLUP));
+    napi_set_named_property(env, exports, "MODE_PULLDOWN", maa_napi_int(env, MAA_GPIO_PULLDOWN));
+    napi_set_named_property(env, exports, "MODE_HIZ", maa_napi_int(env, MAA_GPIO_HIZ));
+    napi_set_named_property(env, exports, "EDGE_NONE", maa_napi_int(env, MAA_GPIO_EDGE_NONE));
+    napi_set_named_property(env, exports, "EDGE_BOTH", maa_napi_int(env, MAA_GPIO_EDGE_BOTH));
+    napi_set_named_property(env, exports, "EDGE_RISING", maa_napi_int(env, MAA_GPIO_EDGE_RISING));
+    napi_set_named_property(env, exports, "EDGE_FALLING", maa_napi_int(env, MAA_GPIO_EDGE_FALLING));
+    napi_set_named_property(env, exports, "SUCCESS", maa_napi_int(env, MAA_SUCCESS));
+
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, maa_napi_init)
@@ -25,10 +25,14 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <sched.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "maa_internal.h"
+#include "maa_shm.h"
 #include "intel_galileo_rev_d.h"
 #include "intel_galileo_rev_g.h"
 #include "gpio.h"
@@ -38,6 +42,28 @@
 static maa_board_t* plat = NULL;
 static maa_platform_t platform_type = MAA_UNKNOWN_PLATFORM;
 
+/**
+ * A mux gpio this process has an open context on, kept so the line is not
+ * exported again when its value has to change
+ */
+typedef struct {
+    unsigned int gpio; /**< raw gpio of the mux line */
+    maa_gpio_context ctx; /**< open context on the mux line */
+} maa_mux_line_t;
+
+/*
+ * The registry lives in the shared segment once maa_shm_attach() was called,
+ * in these process local tables otherwise
+ */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static maa_pin_claim_t* local_claims = NULL;
+static maa_mux_state_t local_mux[MAA_SHM_MAX_MUX];
+static int local_mux_len = 0;
+static maa_mux_line_t* mux_lines = NULL;
+static int mux_lines_len = 0;
+static int mux_lines_cap = 0;
+static char sysfs_root[64] = "";
+
 const char *
 maa_get_version()
 {
@@ -58,17 +84,17 @@ maa_init()
     if (plat != NULL) {
         return MAA_ERROR_PLATFORM_ALREADY_INITIALISED;
     }
-#ifdef SWIGPYTHON
-    // Initialise python threads, this allows use to grab the GIL when we are
-    // required to do so
-    Py_InitializeEx(0);
-    PyEval_InitThreads();
-#endif
+    char* root = getenv("MAA_SYSFS_ROOT");
+    if (root != NULL)
+        maa_set_sysfs_root(root);
+
     // detect a galileo gen2 board
     char *line = NULL;
     // let getline allocate memory for *line
     size_t len = 0;
-    FILE *fh = fopen("/sys/devices/virtual/dmi/id/board_name", "r");
+    char board_name[128];
+    snprintf(board_name, sizeof(board_name), "%s/sys/devices/virtual/dmi/id/board_name", sysfs_root);
+    FILE *fh = fopen(board_name, "r");
     if (fh != NULL) {
         if (getline(&line, &len, fh) != -1) {
             if (strncmp(line, "GalileoGen2", 10) == 0) {
@@ -77,9 +103,9 @@ maa_init()
                 platform_type = MAA_INTEL_GALILEO_GEN1;
             }
         }
+        fclose(fh);
     }
     free(line);
-    fclose(fh);
 
     switch(platform_type) {
         case MAA_INTEL_GALILEO_GEN2:
@@ -93,9 +119,56 @@ maa_init()
             fprintf(stderr, "Platform not found, initialising MAA_INTEL_GALILEO_GEN1\n");
     }
 
+    local_claims = (maa_pin_claim_t*) calloc(plat->phy_pin_count + 1, sizeof(maa_pin_claim_t));
+
+    // let processes share hardware state without code changes
+    char* shm_name = getenv("MAA_SHM");
+    if (shm_name != NULL)
+        maa_shm_attach(shm_name);
+
+    if (getenv("MAA_STATS") != NULL) {
+        maa_stats_enable(1);
+        atexit(maa_stats_report);
+    }
+
+    if (getenv("MAA_TRACE") != NULL && maa_trace_start(65536) == MAA_SUCCESS)
+        atexit(maa_trace_report);
+
     return MAA_SUCCESS;
 }
 
+maa_result_t
+maa_set_sysfs_root(const char* root)
+{
+    if (root == NULL)
+        root = "";
+    if (strlen(root) >= sizeof(sysfs_root))
+        return MAA_ERROR_INVALID_PARAMETER;
+    strcpy(sysfs_root, root);
+    // a trailing slash would double up with the absolute paths appended
+    size_t len = strlen(sysfs_root);
+    if (len > 0 && sysfs_root[len - 1] == '/')
+        sysfs_root[len - 1] = '\0';
+
+    // mux lines set up so far live in the previous tree
+    int i;
+    pthread_mutex_lock(&registry_lock);
+    for (i = 0; i < mux_lines_len; i++) {
+        maa_gpio_owner(mux_lines[i].ctx, 0);
+        maa_gpio_close(mux_lines[i].ctx);
+    }
+    mux_lines_len = 0;
+    local_mux_len = 0;
+    pthread_mutex_unlock(&registry_lock);
+    return MAA_SUCCESS;
+}
+
+const char*
+maa_sysfs_root()
+{
+    return sysfs_root;
+}
+
 int
 maa_set_priority(const unsigned int priority)
 {
@@ -112,22 +185,284 @@ maa_set_priority(const unsigned int priority)
     return sched_setscheduler(0, SCHED_RR, &sched_s);
 }
 
-static maa_result_t
-maa_setup_mux_mapped(maa_pin_t meta)
+static const char*
+maa_pin_mode_name(maa_pinmodes_t mode)
 {
-    int mi;
-    for (mi = 0; mi < meta.mux_total; mi++) {
-        maa_gpio_context mux_i;
-        mux_i = maa_gpio_init_raw(meta.mux[mi].pin);
-        if (mux_i == NULL)
-            return MAA_ERROR_INVALID_HANDLE;
-        maa_gpio_dir(mux_i, MAA_GPIO_OUT);
-        if (maa_gpio_write(mux_i, meta.mux[mi].value) != MAA_SUCCESS)
+    switch (mode) {
+        case MAA_PIN_GPIO: return "gpio";
+        case MAA_PIN_PWM: return "pwm";
+        case MAA_PIN_FAST_GPIO: return "fast gpio";
+        case MAA_PIN_SPI: return "spi";
+        case MAA_PIN_I2C: return "i2c";
+        case MAA_PIN_AIO: return "aio";
+        default: return "unknown";
+    }
+}
+
+static maa_pin_claim_t*
+maa_registry_lock()
+{
+    maa_shm_t* shm = maa_shm_get();
+    if (shm != NULL) {
+        maa_shm_mutex_lock(&shm->lock);
+        return shm->claims;
+    }
+    pthread_mutex_lock(&registry_lock);
+    return local_claims;
+}
+
+static void
+maa_registry_unlock()
+{
+    maa_shm_t* shm = maa_shm_get();
+    if (shm != NULL)
+        pthread_mutex_unlock(&shm->lock);
+    else
+        pthread_mutex_unlock(&registry_lock);
+}
+
+/**
+ * Find the holder entry of the calling process.
+ *
+ * @param claim claim to search
+ * @param create hand out a free entry when the process has none yet
+ * @return the entry, NULL if there is none
+ */
+static maa_pin_holder_t*
+maa_pin_holder(maa_pin_claim_t* claim, int create)
+{
+    pid_t self = getpid();
+    maa_pin_holder_t* free_slot = NULL;
+    int i;
+    for (i = 0; i < MAA_SHM_MAX_HOLDERS; i++) {
+        if (claim->holders[i].pid == self)
+            return &claim->holders[i];
+        if (claim->holders[i].pid == 0 && free_slot == NULL)
+            free_slot = &claim->holders[i];
+    }
+    return create ? free_slot : NULL;
+}
+
+maa_result_t
+maa_claim_pin(int pin, maa_pinmodes_t mode)
+{
+    if (plat == NULL || local_claims == NULL)
+        return MAA_ERROR_PLATFORM_NOT_INITIALISED;
+    if (pin < 0 || pin > plat->phy_pin_count)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    maa_result_t ret = MAA_SUCCESS;
+    maa_pin_claim_t* claims = maa_registry_lock();
+    maa_shm_reap();
+    maa_pin_holder_t* holder = maa_pin_holder(&claims[pin], 1);
+    if (claims[pin].users > 0 && claims[pin].mode != mode) {
+        fprintf(stderr, "Pin %d is already in use as %s, cannot use it as %s\n",
+                pin, maa_pin_mode_name(claims[pin].mode), maa_pin_mode_name(mode));
+        ret = MAA_ERROR_NO_RESOURCES;
+    } else if (holder == NULL) {
+        fprintf(stderr, "Pin %d is used by too many processes\n", pin);
+        ret = MAA_ERROR_NO_RESOURCES;
+    } else {
+        claims[pin].mode = mode;
+        claims[pin].users++;
+        holder->pid = getpid();
+        holder->users++;
+    }
+    maa_registry_unlock();
+    return ret;
+}
+
+int
+maa_release_pin(int pin)
+{
+    if (plat == NULL || local_claims == NULL || pin < 0 || pin > plat->phy_pin_count)
+        return -1;
+    maa_pin_claim_t* claims = maa_registry_lock();
+    // a claim inherited over fork() stays with the process that made it
+    maa_pin_holder_t* holder = maa_pin_holder(&claims[pin], 0);
+    if (holder != NULL && holder->users > 0) {
+        claims[pin].users--;
+        if (--holder->users == 0)
+            holder->pid = 0;
+    }
+    int users = claims[pin].users;
+    maa_registry_unlock();
+    return users;
+}
+
+int
+maa_pin_claims(int pin, maa_pinmodes_t* mode)
+{
+    if (plat == NULL || local_claims == NULL || pin < 0 || pin > plat->phy_pin_count)
+        return -1;
+    maa_pin_claim_t* claims = maa_registry_lock();
+    maa_shm_reap();
+    int users = claims[pin].users;
+    if (users > 0 && mode != NULL)
+        *mode = claims[pin].mode;
+    maa_registry_unlock();
+    return users;
+}
+
+maa_result_t
+maa_shm_attach(const char* name)
+{
+    if (plat == NULL || local_claims == NULL)
+        return MAA_ERROR_PLATFORM_NOT_INITIALISED;
+    if (plat->phy_pin_count >= MAA_SHM_MAX_PINS)
+        return MAA_ERROR_FEATURE_NOT_SUPPORTED;
+
+    // claims made so far are local and would be lost from the shared view
+    int pin;
+    pthread_mutex_lock(&registry_lock);
+    for (pin = 0; pin <= plat->phy_pin_count; pin++) {
+        if (local_claims[pin].users > 0) {
+            pthread_mutex_unlock(&registry_lock);
+            fprintf(stderr, "Shared memory has to be attached before pins are used\n");
             return MAA_ERROR_INVALID_RESOURCE;
+        }
+    }
+    maa_result_t ret = maa_shm_open(name);
+    pthread_mutex_unlock(&registry_lock);
+    return ret;
+}
+
+static int
+maa_mux_listed(const maa_pin_t* meta, unsigned int gpio)
+{
+    unsigned int mi;
+    for (mi = 0; mi < meta->mux_total; mi++)
+        if (meta->mux[mi].pin == gpio)
+            return 1;
+    return 0;
+}
+
+int
+maa_mux_gpio(unsigned int gpio)
+{
+    if (plat == NULL)
+        return 0;
+    unsigned int pin;
+    for (pin = 0; pin < plat->phy_pin_count; pin++) {
+        // tables of functions a pin lacks are left uninitialised
+        const maa_pininfo_t* info = &plat->pins[pin];
+        maa_pincapabilities_t cap = info->capabilites;
+        if ((cap.gpio && maa_mux_listed(&info->gpio, gpio)) ||
+            (cap.pwm && maa_mux_listed(&info->pwm, gpio)) ||
+            (cap.aio && maa_mux_listed(&info->aio, gpio)) ||
+            (cap.fast_gpio && maa_mux_listed(&info->mmap.gpio, gpio)) ||
+            (cap.i2c && maa_mux_listed(&info->i2c, gpio)) ||
+            (cap.spi && maa_mux_listed(&info->spi, gpio)))
+            return 1;
     }
+    return 0;
+}
+
+void
+maa_mux_invalidate(unsigned int gpio)
+{
+    if (plat == NULL || local_claims == NULL)
+        return;
+    maa_shm_t* shm = maa_shm_get();
+    maa_registry_lock();
+    maa_mux_state_t* table = shm != NULL ? shm->mux : local_mux;
+    int len = shm != NULL ? shm->mux_len : local_mux_len;
+    int i;
+    for (i = 0; i < len; i++) {
+        if (table[i].gpio == gpio) {
+            // no value a mux can ask for, the next setup writes the line
+            table[i].value = MAA_MUX_UNKNOWN;
+            break;
+        }
+    }
+    maa_registry_unlock();
+}
+
+static maa_gpio_context
+maa_mux_line_context(unsigned int gpio)
+{
+    int i;
+    for (i = 0; i < mux_lines_len; i++)
+        if (mux_lines[i].gpio == gpio)
+            return mux_lines[i].ctx;
+
+    if (mux_lines_len == mux_lines_cap) {
+        int cap = mux_lines_cap == 0 ? 16 : mux_lines_cap * 2;
+        maa_mux_line_t* grown = (maa_mux_line_t*) realloc(mux_lines, cap * sizeof(maa_mux_line_t));
+        if (grown == NULL)
+            return NULL;
+        mux_lines = grown;
+        mux_lines_cap = cap;
+    }
+
+    maa_gpio_context mux_i;
+    mux_i = maa_gpio_init_mux(gpio);
+    if (mux_i == NULL)
+        return NULL;
+    maa_gpio_dir(mux_i, MAA_GPIO_OUT);
+    mux_lines[mux_lines_len].gpio = gpio;
+    mux_lines[mux_lines_len].ctx = mux_i;
+    mux_lines_len++;
+    return mux_i;
+}
+
+static maa_result_t
+maa_setup_mux_line(maa_pin_claim_t* claims, int pin, maa_mux_t mux)
+{
+    maa_shm_t* shm = maa_shm_get();
+    maa_mux_state_t* table = shm != NULL ? shm->mux : local_mux;
+    int* len = shm != NULL ? &shm->mux_len : &local_mux_len;
+    maa_mux_state_t* line = NULL;
+
+    int i;
+    for (i = 0; i < *len; i++) {
+        if (table[i].gpio == mux.pin) {
+            line = &table[i];
+            break;
+        }
+    }
+
+    if (line != NULL && line->value == mux.value) {
+        // already set up, possibly by another process
+        line->pin = pin;
+        return MAA_SUCCESS;
+    }
+    if (line != NULL && line->pin != pin && claims[line->pin].users > 0) {
+        fprintf(stderr, "Mux gpio %u is set for pin %d, cannot change it for pin %d\n",
+                line->gpio, line->pin, pin);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+
+    maa_gpio_context ctx = maa_mux_line_context(mux.pin);
+    if (ctx == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (maa_gpio_write(ctx, mux.value) != MAA_SUCCESS)
+        return MAA_ERROR_INVALID_RESOURCE;
+
+    if (line == NULL) {
+        // a full table only means this line will be written every time
+        if (*len == MAA_SHM_MAX_MUX)
+            return MAA_SUCCESS;
+        line = &table[(*len)++];
+        line->gpio = mux.pin;
+    }
+    line->value = mux.value;
+    line->pin = pin;
     return MAA_SUCCESS;
 }
 
+static maa_result_t
+maa_setup_mux_mapped(int pin, maa_pin_t meta)
+{
+    maa_result_t ret = MAA_SUCCESS;
+    int mi;
+    maa_pin_claim_t* claims = maa_registry_lock();
+    for (mi = 0; mi < meta.mux_total && ret == MAA_SUCCESS; mi++)
+        ret = maa_setup_mux_line(claims, pin, meta.mux[mi]);
+    maa_registry_unlock();
+    return ret;
+}
+
 unsigned int
 maa_setup_gpio(int pin)
 {
@@ -140,9 +475,13 @@ maa_setup_gpio(int pin)
     if(plat->pins[pin].capabilites.gpio != 1)
       return -1;
 
+    if (maa_claim_pin(pin, MAA_PIN_GPIO) != MAA_SUCCESS)
+        return -1;
     if (plat->pins[pin].gpio.mux_total > 0)
-       if (maa_setup_mux_mapped(plat->pins[pin].gpio) != MAA_SUCCESS)
+       if (maa_setup_mux_mapped(pin, plat->pins[pin].gpio) != MAA_SUCCESS) {
+            maa_release_pin(pin);
             return -1;
+       }
     return plat->pins[pin].gpio.pinmap;
 }
 
@@ -160,9 +499,13 @@ maa_setup_aio(int aio)
     if (plat->pins[pin].capabilites.aio != 1)
       return -1;
 
+    if (maa_claim_pin(pin, MAA_PIN_AIO) != MAA_SUCCESS)
+        return -1;
     if (plat->pins[pin].aio.mux_total > 0)
-       if (maa_setup_mux_mapped(plat->pins[pin].aio) != MAA_SUCCESS)
-            return -1;
+       if (maa_setup_mux_mapped(pin, plat->pins[pin].aio) != MAA_SUCCESS) {
+            maa_release_pin(pin);
+            return -2;
+       }
     return plat->pins[pin].aio.pinmap;
 }
 
@@ -181,15 +524,21 @@ maa_setup_i2c(int bus)
         return -1;
     }
 
-    int pos = plat->i2c_bus[bus].sda;
-    if (plat->pins[pos].i2c.mux_total > 0)
-        if (maa_setup_mux_mapped(plat->pins[pos].i2c) != MAA_SUCCESS)
-             return -2;
-
-    pos = plat->i2c_bus[bus].scl;
-    if (plat->pins[pos].i2c.mux_total > 0)
-        if (maa_setup_mux_mapped(plat->pins[pos].i2c) != MAA_SUCCESS)
-             return -2;
+    int pins[2] = { plat->i2c_bus[bus].sda, plat->i2c_bus[bus].scl };
+    int i;
+    for (i = 0; i < 2; i++) {
+        int pos = pins[i];
+        if (maa_claim_pin(pos, MAA_PIN_I2C) != MAA_SUCCESS) {
+            while (i-- > 0)
+                maa_release_pin(pins[i]);
+            return -2;
+        }
+        if (plat->pins[pos].i2c.mux_total > 0)
+            if (maa_setup_mux_mapped(pos, plat->pins[pos].i2c) != MAA_SUCCESS) {
+                do maa_release_pin(pins[i]); while (i-- > 0);
+                return -2;
+            }
+    }
 
     return plat->i2c_bus[bus].bus_id;
 }
@@ -209,20 +558,22 @@ maa_setup_spi(int bus)
         return NULL;
     }
 
-    int pos = plat->spi_bus[bus].sclk;
-    if (plat->pins[pos].spi.mux_total > 0)
-        if (maa_setup_mux_mapped(plat->pins[pos].spi) != MAA_SUCCESS)
-             return NULL;
-
-    pos = plat->spi_bus[bus].mosi;
-    if (plat->pins[pos].spi.mux_total > 0)
-        if (maa_setup_mux_mapped(plat->pins[pos].spi) != MAA_SUCCESS)
-             return NULL;
-
-    pos = plat->spi_bus[bus].miso;
-    if (plat->pins[pos].spi.mux_total > 0)
-        if (maa_setup_mux_mapped(plat->pins[pos].spi) != MAA_SUCCESS)
-             return NULL;
+    int pins[3] = { plat->spi_bus[bus].sclk, plat->spi_bus[bus].mosi,
+                    plat->spi_bus[bus].miso };
+    int i;
+    for (i = 0; i < 3; i++) {
+        int pos = pins[i];
+        if (maa_claim_pin(pos, MAA_PIN_SPI) != MAA_SUCCESS) {
+            while (i-- > 0)
+                maa_release_pin(pins[i]);
+            return NULL;
+        }
+        if (plat->pins[pos].spi.mux_total > 0)
+            if (maa_setup_mux_mapped(pos, plat->pins[pos].spi) != MAA_SUCCESS) {
+                do maa_release_pin(pins[i]); while (i-- > 0);
+                return NULL;
+            }
+    }
 
     maa_spi_bus_t *spi = &(plat->spi_bus[bus]);
     return spi;
@@ -237,29 +588,36 @@ maa_setup_pwm(int pin)
     if (plat->pins[pin].capabilites.pwm != 1)
         return NULL;
 
+    if (maa_claim_pin(pin, MAA_PIN_PWM) != MAA_SUCCESS)
+        return NULL;
+
     if (plat->pins[pin].capabilites.gpio == 1) {
         maa_gpio_context mux_i;
-        mux_i = maa_gpio_init_raw(plat->pins[pin].gpio.pinmap);
-        if (mux_i == NULL)
-            return NULL;
-        if (maa_gpio_dir(mux_i, MAA_GPIO_OUT) != MAA_SUCCESS)
+        mux_i = maa_gpio_init_internal(plat->pins[pin].gpio.pinmap);
+        if (mux_i == NULL) {
+            maa_release_pin(pin);
             return NULL;
+        }
         // Current REV D quirk. //TODO GEN 2
-        if (maa_gpio_write(mux_i, 1) != MAA_SUCCESS)
+        if (maa_gpio_dir(mux_i, MAA_GPIO_OUT) != MAA_SUCCESS ||
+            maa_gpio_write(mux_i, 1) != MAA_SUCCESS) {
+            maa_gpio_close(mux_i);
+            maa_release_pin(pin);
             return NULL;
-        if (maa_gpio_close(mux_i) != MAA_SUCCESS)
+        }
+        if (maa_gpio_close(mux_i) != MAA_SUCCESS) {
+            maa_release_pin(pin);
             return NULL;
+        }
     }
 
     if (plat->pins[pin].pwm.mux_total > 0)
-       if (maa_setup_mux_mapped(plat->pins[pin].pwm) != MAA_SUCCESS)
+       if (maa_setup_mux_mapped(pin, plat->pins[pin].pwm) != MAA_SUCCESS) {
+            maa_release_pin(pin);
             return NULL;
+       }
 
-    maa_pin_t *ret;
-    ret = (maa_pin_t*) malloc(sizeof(maa_pin_t));
-    ret->pinmap = plat->pins[pin].pwm.pinmap;
-    ret->parent_id = plat->pins[pin].pwm.parent_id;
-    return ret;
+    return &(plat->pins[pin].pwm);
 }
 
 void
@@ -369,10 +727,7 @@ maa_setup_mmap_gpio(int pin)
         return NULL;
 
     if (plat->pins[pin].mmap.gpio.mux_total > 0)
-       if (maa_setup_mux_mapped(plat->pins[pin].mmap.gpio) != MAA_SUCCESS)
-            return NULL;
-
-    if (maa_setup_mux_mapped(plat->pins[pin].mmap.gpio) != MAA_SUCCESS)
+       if (maa_setup_mux_mapped(pin, plat->pins[pin].mmap.gpio) != MAA_SUCCESS)
             return NULL;
     maa_mmap_pin_t *ret = &(plat->pins[pin].mmap);
     return ret;
@@ -390,9 +745,15 @@ maa_swap_complex_gpio(int pin, int out)
                 return MAA_SUCCESS;
             if (plat->pins[pin].gpio.complex_cap.output_en == 1) {
                 maa_gpio_context output_e;
-                output_e = maa_gpio_init_raw(plat->pins[pin].gpio.output_enable);
-                if (maa_gpio_dir(output_e, MAA_GPIO_OUT) != MAA_SUCCESS)
+                output_e = maa_gpio_init_internal(plat->pins[pin].gpio.output_enable);
+                if (output_e == NULL)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                // leave the line exported and set when we go away
+                maa_gpio_owner(output_e, 0);
+                if (maa_gpio_dir(output_e, MAA_GPIO_OUT) != MAA_SUCCESS) {
+                    maa_gpio_close(output_e);
                     return MAA_ERROR_INVALID_RESOURCE;
+                }
                 int output_val;
                 if (plat->pins[pin].gpio.complex_cap.output_en_high == 1)
                     output_val = out;
@@ -401,7 +762,9 @@ maa_swap_complex_gpio(int pin, int out)
                         output_val = 0;
                     else
                         output_val = 1;
-                if (maa_gpio_write(output_e, output_val) != MAA_SUCCESS)
+                maa_result_t ret = maa_gpio_write(output_e, output_val);
+                maa_gpio_close(output_e);
+                if (ret != MAA_SUCCESS)
                     return MAA_ERROR_INVALID_RESOURCE;
             }
             //if (plat->pins[pin].gpio.complex_cap.pullup_en == 1) {
@@ -419,3 +782,60 @@ maa_platform_t maa_get_platform_type()
 {
     return platform_type;
 }
+
+void
+maa_release_aio(int aio)
+{
+    if (plat == NULL || aio < 0 || aio > plat->aio_count)
+        return;
+    maa_release_pin(aio + plat->gpio_count);
+}
+
+void
+maa_release_i2c(int bus)
+{
+    if (plat == NULL || bus < 0 || bus >= plat->i2c_bus_count)
+        return;
+    maa_release_pin(plat->i2c_bus[bus].sda);
+    maa_release_pin(plat->i2c_bus[bus].scl);
+}
+
+void
+maa_release_spi(int bus)
+{
+    if (plat == NULL || bus < 0 || bus >= plat->spi_bus_count)
+        return;
+    maa_release_pin(plat->spi_bus[bus].sclk);
+    maa_release_pin(plat->spi_bus[bus].mosi);
+    maa_release_pin(plat->spi_bus[bus].miso);
+}
+
+maa_result_t
+maa_wait_for_file(const char* path, int mode, unsigned int timeout_ms)
+{
+    struct timespec now, deadline;
+    // start well under a typical udev round trip and back off from there
+    unsigned int delay_us = 50;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    for (;;) {
+        if (access(path, mode) == 0)
+            return MAA_SUCCESS;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+            fprintf(stderr, "Timed out waiting for %s\n", path);
+            return MAA_ERROR_NO_RESOURCES;
+        }
+        usleep(delay_us);
+        if (delay_us < 10000)
+            delay_us *= 2;
+    }
+}
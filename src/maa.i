@@ -16,6 +16,7 @@
     #include "i2c.hpp"
     #include "spi.hpp"
     #include "aio.hpp"
+    #include "program.hpp"
 %}
 
 %init %{
@@ -33,6 +34,39 @@
 
 %typemap(in) uint8_t = char;
 
+// byte buffers passed in, e.g. to Program.spiTransfer
+#if defined(SWIGPYTHON)
+%typemap(in) (const uint8_t* data, int length) {
+    char* bytes;
+    Py_ssize_t size;
+    if (PyByteArray_Check($input)) {
+        bytes = PyByteArray_AsString($input);
+        size = PyByteArray_Size($input);
+    } else if (PyBytes_AsStringAndSize($input, &bytes, &size) != 0) {
+        SWIG_exception_fail(SWIG_TypeError, "expected bytes or bytearray");
+    }
+    $1 = (uint8_t*) bytes;
+    $2 = (int) size;
+}
+%typemap(typecheck, precedence=SWIG_TYPECHECK_STRING) (const uint8_t* data, int length) {
+    $1 = PyBytes_Check($input) || PyByteArray_Check($input);
+}
+#elif defined(SWIGJAVASCRIPT)
+%{
+#include <node_buffer.h>
+%}
+%typemap(in) (const uint8_t* data, int length) {
+    if (!node::Buffer::HasInstance($input)) {
+        SWIG_exception_fail(SWIG_TypeError, "expected a Buffer");
+    }
+    $1 = (uint8_t*) node::Buffer::Data($input);
+    $2 = (int) node::Buffer::Length($input);
+}
+%typemap(typecheck, precedence=SWIG_TYPECHECK_STRING) (const uint8_t* data, int length) {
+    $1 = node::Buffer::HasInstance($input);
+}
+#endif
+
 %include "types.h"
 
 #### GPIO ####
@@ -54,3 +88,7 @@
 #### AIO ####
 
 %include "aio.hpp"
+
+#### Programs ####
+
+%include "program.hpp"
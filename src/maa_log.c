@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include "log.h"
+#include "maa_internal.h"
+
+static __thread maa_error_t last_error = { MAA_SUCCESS, 0, NULL, NULL };
+
+static maa_log_sink_t log_sink = NULL;
+static void* log_user = NULL;
+static volatile int log_level = MAA_LOG_ERROR;
+static volatile unsigned int log_rate = 10;
+static volatile time_t log_window = 0;
+static volatile unsigned int log_in_window = 0;
+static volatile unsigned int log_suppressed = 0;
+
+const maa_error_t*
+maa_last_error()
+{
+    return &last_error;
+}
+
+void
+maa_clear_error()
+{
+    last_error.code = MAA_SUCCESS;
+    last_error.sys_errno = 0;
+    last_error.function = NULL;
+    last_error.message = NULL;
+}
+
+maa_result_t
+maa_log_set_sink(maa_log_sink_t sink, void* user)
+{
+    log_user = user;
+    log_sink = sink;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_log_set_level(maa_log_level_t level)
+{
+    if (level < MAA_LOG_ERROR || level > MAA_LOG_DEBUG)
+        return MAA_ERROR_INVALID_PARAMETER;
+    log_level = level;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_log_set_rate(unsigned int per_second)
+{
+    log_rate = per_second;
+    return MAA_SUCCESS;
+}
+
+/*
+ * Take one message from the budget of the current second
+ */
+static int
+maa_log_admit()
+{
+    unsigned int rate = log_rate;
+    if (rate == 0)
+        return 1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    time_t window = log_window;
+    if (now.tv_sec != window && __sync_bool_compare_and_swap(&log_window, window, now.tv_sec))
+        log_in_window = 0;
+    if (__sync_fetch_and_add(&log_in_window, 1) < rate)
+        return 1;
+    __sync_fetch_and_add(&log_suppressed, 1);
+    return 0;
+}
+
+static void
+maa_vlog(maa_log_level_t level, const char* fmt, va_list ap)
+{
+    if (level > log_level || !maa_log_admit())
+        return;
+
+    char message[256];
+    int len = vsnprintf(message, sizeof(message), fmt, ap);
+    if (len < 0)
+        return;
+    if ((size_t) len >= sizeof(message))
+        len = sizeof(message) - 1;
+    unsigned int dropped = __sync_lock_test_and_set(&log_suppressed, 0);
+    if (dropped > 0)
+        snprintf(message + len, sizeof(message) - len, " (%u messages suppressed)", dropped);
+
+    maa_log_sink_t sink = log_sink;
+    if (sink != NULL)
+        sink(level, message, log_user);
+    else
+        fprintf(stderr, "libmaa: %s\n", message);
+}
+
+void
+maa_log(maa_log_level_t level, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    maa_vlog(level, fmt, ap);
+    va_end(ap);
+}
+
+maa_result_t
+maa_fail(maa_result_t code, const char* function, const char* fmt, ...)
+{
+    last_error.sys_errno = errno;
+    last_error.code = code;
+    last_error.function = function;
+    last_error.message = fmt;
+
+    va_list ap;
+    va_start(ap, fmt);
+    maa_vlog(MAA_LOG_ERROR, fmt, ap);
+    va_end(ap);
+    return code;
+}
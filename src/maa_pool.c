@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "maa_internal.h"
+#include "maa_pool.h"
+
+/* Slots start on their own cache line so contexts used by different threads
+ * do not share one */
+#define SLOT_ALIGN 64
+#define ROUND_UP(n) (((n) + SLOT_ALIGN - 1) & ~((size_t) SLOT_ALIGN - 1))
+
+typedef struct {
+    char* slots;
+    size_t slot_size;
+    unsigned int count;
+    unsigned int* free_list; /* stack of free slot indexes */
+    unsigned int free_top;
+} maa_pool_bucket_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static void* arena;
+static maa_pool_bucket_t pools[MAA_POOL_TYPES];
+
+static const char* type_names[MAA_POOL_TYPES] = {
+    "gpio",
+    "pwm",
+    "aio",
+    "i2c",
+    "spi"
+};
+
+static size_t
+context_size(maa_pool_type_t type)
+{
+    switch (type) {
+        case MAA_POOL_GPIO: return maa_gpio_context_size;
+        case MAA_POOL_PWM: return maa_pwm_context_size;
+        case MAA_POOL_AIO: return maa_aio_context_size;
+        case MAA_POOL_I2C: return maa_i2c_context_size;
+        case MAA_POOL_SPI: return maa_spi_context_size;
+        default: return 0;
+    }
+}
+
+maa_result_t
+maa_pool_init(const maa_pool_config_t* config)
+{
+    if (config == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&pool_lock);
+    if (arena != NULL) {
+        pthread_mutex_unlock(&pool_lock);
+        return MAA_ERROR_INVALID_RESOURCE;
+    }
+
+    // free lists first, then the slots of every type one after the other
+    size_t lists = 0, total;
+    int t;
+    for (t = 0; t < MAA_POOL_TYPES; t++)
+        lists += config->count[t] * sizeof(unsigned int);
+    total = ROUND_UP(lists);
+    for (t = 0; t < MAA_POOL_TYPES; t++)
+        total += config->count[t] * ROUND_UP(context_size(t));
+
+    if (posix_memalign(&arena, SLOT_ALIGN, total > 0 ? total : SLOT_ALIGN) != 0) {
+        arena = NULL;
+        pthread_mutex_unlock(&pool_lock);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    // touch every page now rather than fault them in on first use
+    memset(arena, 0, total);
+
+    unsigned int* list = (unsigned int*) arena;
+    char* slots = (char*) arena + ROUND_UP(lists);
+    for (t = 0; t < MAA_POOL_TYPES; t++) {
+        maa_pool_bucket_t* pool = &pools[t];
+        pool->slots = slots;
+        pool->slot_size = ROUND_UP(context_size(t));
+        pool->count = config->count[t];
+        pool->free_list = list;
+        for (pool->free_top = 0; pool->free_top < pool->count; pool->free_top++)
+            list[pool->free_top] = pool->count - 1 - pool->free_top;
+        list += pool->count;
+        slots += pool->count * pool->slot_size;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return MAA_SUCCESS;
+}
+
+unsigned int
+maa_pool_available(maa_pool_type_t type)
+{
+    if (type >= MAA_POOL_TYPES)
+        return 0;
+    pthread_mutex_lock(&pool_lock);
+    unsigned int available = arena != NULL ? pools[type].free_top : 0;
+    pthread_mutex_unlock(&pool_lock);
+    return available;
+}
+
+maa_result_t
+maa_pool_release()
+{
+    int t;
+    pthread_mutex_lock(&pool_lock);
+    for (t = 0; t < MAA_POOL_TYPES; t++) {
+        if (pools[t].free_top != pools[t].count) {
+            pthread_mutex_unlock(&pool_lock);
+            return MAA_ERROR_INVALID_RESOURCE;
+        }
+    }
+    free(arena);
+    arena = NULL;
+    memset(pools, 0, sizeof(pools));
+    pthread_mutex_unlock(&pool_lock);
+    return MAA_SUCCESS;
+}
+
+void*
+maa_pool_alloc(maa_pool_type_t type)
+{
+    pthread_mutex_lock(&pool_lock);
+    if (arena == NULL) {
+        pthread_mutex_unlock(&pool_lock);
+        return calloc(1, context_size(type));
+    }
+
+    maa_pool_bucket_t* pool = &pools[type];
+    if (pool->free_top == 0) {
+        pthread_mutex_unlock(&pool_lock);
+        MAA_FAIL(MAA_ERROR_NO_RESOURCES, "No %s context left in the pool", type_names[type]);
+        return NULL;
+    }
+    char* ctx = pool->slots + pool->free_list[--pool->free_top] * pool->slot_size;
+    pthread_mutex_unlock(&pool_lock);
+    memset(ctx, 0, pool->slot_size);
+    return ctx;
+}
+
+void
+maa_pool_free(maa_pool_type_t type, void* ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    maa_pool_bucket_t* pool = &pools[type];
+    char* slot = (char*) ctx;
+    if (arena != NULL && slot >= pool->slots &&
+        slot < pool->slots + pool->count * pool->slot_size) {
+        pool->free_list[pool->free_top++] = (slot - pool->slots) / pool->slot_size;
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    // opened before the pool was set up
+    free(ctx);
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <grp.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "maa_internal.h"
+#include "maa_shm.h"
+
+#define MAA_SHM_MAGIC 0x6d616132
+
+static maa_shm_t* shm = NULL;
+static pthread_mutex_t local_bus_lock[2][MAA_SHM_MAX_BUSES] = {
+    { [0 ... MAA_SHM_MAX_BUSES - 1] = PTHREAD_MUTEX_INITIALIZER },
+    { [0 ... MAA_SHM_MAX_BUSES - 1] = PTHREAD_MUTEX_INITIALIZER }
+};
+
+static void
+maa_shm_mutex_init(pthread_mutex_t* lock, int type)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutexattr_settype(&attr, type);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void
+maa_shm_init(maa_shm_t* seg)
+{
+    int i, j;
+    maa_shm_mutex_init(&seg->lock, PTHREAD_MUTEX_NORMAL);
+    // every transfer locks its bus, also inside a maa_i2c_lock() transaction
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < MAA_SHM_MAX_BUSES; j++)
+            maa_shm_mutex_init(&seg->bus_lock[i][j], PTHREAD_MUTEX_RECURSIVE);
+    for (i = 0; i < MAA_SHM_MAX_GPIOS; i++)
+        seg->gpio_shadow[i].value = -1;
+    seg->size = sizeof(maa_shm_t);
+    // publish only once everything else is in place
+    __sync_synchronize();
+    seg->magic = MAA_SHM_MAGIC;
+}
+
+/**
+ * Mode and group a new segment gets, from MAA_SHM_MODE (octal) and
+ * MAA_SHM_GROUP (name or gid). gid is left at -1 when no group is given.
+ */
+static maa_result_t
+maa_shm_access(mode_t* mode, gid_t* gid)
+{
+    char* end;
+    const char* env = getenv("MAA_SHM_MODE");
+    *mode = MAA_SHM_DEFAULT_MODE;
+    if (env != NULL) {
+        *mode = (mode_t) strtoul(env, &end, 8);
+        if (*env == '\0' || *end != '\0' || *mode > 0777)
+            return MAA_FAIL(MAA_ERROR_INVALID_PARAMETER, "Bad MAA_SHM_MODE %s", env);
+    }
+
+    *gid = (gid_t) -1;
+    env = getenv("MAA_SHM_GROUP");
+    if (env != NULL) {
+        struct group* grp = getgrnam(env);
+        if (grp != NULL) {
+            *gid = grp->gr_gid;
+        } else {
+            *gid = (gid_t) strtoul(env, &end, 10);
+            if (*env == '\0' || *end != '\0')
+                return MAA_FAIL(MAA_ERROR_INVALID_PARAMETER, "Unknown MAA_SHM_GROUP %s", env);
+        }
+    }
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_shm_open(const char* name)
+{
+    if (shm != NULL)
+        return MAA_SUCCESS;
+    if (name == NULL || name[0] == '\0')
+        name = MAA_SHM_DEFAULT_NAME;
+
+    mode_t mode;
+    gid_t gid;
+    maa_result_t ret = maa_shm_access(&mode, &gid);
+    if (ret != MAA_SUCCESS)
+        return ret;
+
+    // nobody but us until the segment has its group and mode
+    int created = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd == -1) {
+        fprintf(stderr, "Failed to open shared memory %s\n", name);
+        return MAA_ERROR_INVALID_RESOURCE;
+    }
+
+    if (created && ((gid != (gid_t) -1 && fchown(fd, (uid_t) -1, gid) == -1) ||
+                    fchmod(fd, mode) == -1)) {
+        MAA_FAIL(MAA_ERROR_NO_RESOURCES, "Failed to set the owner or mode of %s", name);
+        close(fd);
+        shm_unlink(name);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    if (created && ftruncate(fd, sizeof(maa_shm_t)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    if (!created) {
+        // the creator may still be sizing the segment
+        struct stat st;
+        int tries;
+        for (tries = 0; tries < 1000; tries++) {
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(maa_shm_t))
+                break;
+            usleep(1000);
+        }
+        if (tries == 1000) {
+            fprintf(stderr, "Shared memory %s has the wrong size\n", name);
+            close(fd);
+            return MAA_ERROR_INVALID_RESOURCE;
+        }
+    }
+
+    maa_shm_t* seg = (maa_shm_t*) mmap(NULL, sizeof(maa_shm_t), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+        return MAA_ERROR_NO_RESOURCES;
+
+    if (created) {
+        maa_shm_init(seg);
+    } else {
+        int tries;
+        for (tries = 0; tries < 1000 && seg->magic != MAA_SHM_MAGIC; tries++)
+            usleep(1000);
+        if (seg->magic != MAA_SHM_MAGIC || seg->size != sizeof(maa_shm_t)) {
+            fprintf(stderr, "Shared memory %s is not a compatible maa segment\n", name);
+            munmap(seg, sizeof(maa_shm_t));
+            return MAA_ERROR_INVALID_RESOURCE;
+        }
+    }
+
+    shm = seg;
+    // a process that died holding pins left them claimed
+    maa_shm_mutex_lock(&shm->lock);
+    maa_shm_reap();
+    pthread_mutex_unlock(&shm->lock);
+    return MAA_SUCCESS;
+}
+
+maa_shm_t*
+maa_shm_get()
+{
+    return shm;
+}
+
+void
+maa_shm_mutex_lock(pthread_mutex_t* lock)
+{
+    // a process died holding it, what it guards is still usable
+    if (pthread_mutex_lock(lock) == EOWNERDEAD)
+        pthread_mutex_consistent(lock);
+}
+
+void
+maa_shm_bus_lock(maa_shm_bus_t type, unsigned int bus)
+{
+    if (shm == NULL)
+        pthread_mutex_lock(&local_bus_lock[type][bus % MAA_SHM_MAX_BUSES]);
+    else
+        maa_shm_mutex_lock(&shm->bus_lock[type][bus % MAA_SHM_MAX_BUSES]);
+}
+
+void
+maa_shm_bus_unlock(maa_shm_bus_t type, unsigned int bus)
+{
+    if (shm == NULL)
+        pthread_mutex_unlock(&local_bus_lock[type][bus % MAA_SHM_MAX_BUSES]);
+    else
+        pthread_mutex_unlock(&shm->bus_lock[type][bus % MAA_SHM_MAX_BUSES]);
+}
+
+pthread_mutex_t*
+maa_shm_transfer_lock(maa_shm_bus_t type, unsigned int bus)
+{
+    if (shm == NULL)
+        return NULL;
+    pthread_mutex_t* lock = &shm->bus_lock[type][bus % MAA_SHM_MAX_BUSES];
+    maa_shm_mutex_lock(lock);
+    return lock;
+}
+
+void
+maa_shm_transfer_unlock(pthread_mutex_t* lock)
+{
+    if (lock != NULL)
+        pthread_mutex_unlock(lock);
+}
+
+maa_gpio_shadow_t*
+maa_shm_gpio_shadow(unsigned int gpio)
+{
+    if (shm == NULL || gpio >= MAA_SHM_MAX_GPIOS)
+        return NULL;
+    return &shm->gpio_shadow[gpio];
+}
+
+/**
+ * Processes already checked by one maa_shm_reap() pass, so each costs at
+ * most one kill()
+ */
+typedef struct {
+    pid_t pid[MAA_SHM_MAX_PINS];
+    int dead[MAA_SHM_MAX_PINS];
+    int len;
+} maa_shm_pids_t;
+
+static int
+maa_shm_pid_dead(maa_shm_pids_t* seen, pid_t pid)
+{
+    int i;
+    for (i = 0; i < seen->len; i++)
+        if (seen->pid[i] == pid)
+            return seen->dead[i];
+    // EPERM means it exists but belongs to another user
+    int dead = (kill(pid, 0) == -1 && errno == ESRCH);
+    if (seen->len < MAA_SHM_MAX_PINS) {
+        seen->pid[seen->len] = pid;
+        seen->dead[seen->len++] = dead;
+    }
+    return dead;
+}
+
+void
+maa_shm_reap()
+{
+    if (shm == NULL)
+        return;
+    maa_shm_pids_t seen;
+    pid_t self = getpid();
+    int i, j;
+
+    seen.len = 0;
+    for (i = 0; i < MAA_SHM_MAX_PINS; i++) {
+        maa_pin_claim_t* claim = &shm->claims[i];
+        for (j = 0; j < MAA_SHM_MAX_HOLDERS; j++) {
+            maa_pin_holder_t* holder = &claim->holders[j];
+            if (holder->pid == 0 || holder->pid == self || !maa_shm_pid_dead(&seen, holder->pid))
+                continue;
+            claim->users -= holder->users;
+            if (claim->users < 0)
+                claim->users = 0;
+            holder->pid = 0;
+            holder->users = 0;
+        }
+    }
+    // shadows are written without the lock, losing a race only leaves the
+    // level unknown which is always safe
+    for (i = 0; i < MAA_SHM_MAX_GPIOS; i++) {
+        pid_t pid = shm->gpio_shadow[i].pid;
+        if (pid == 0 || pid == self || !maa_shm_pid_dead(&seen, pid))
+            continue;
+        shm->gpio_shadow[i].value = -1;
+        shm->gpio_shadow[i].pid = 0;
+    }
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "maa_internal.h"
+
+volatile int maa_instrument = 0;
+__thread unsigned int maa_stats_syscalls = 0;
+
+static maa_stats_t stats[MAA_STATS_OPS];
+/* syscall count of each thread when its operation started */
+static __thread unsigned int syscalls_start;
+
+static const char* op_names[MAA_STATS_OPS] = {
+    "gpio_read",
+    "gpio_write",
+    "gpio_dir",
+    "aio_read",
+    "pwm_write",
+    "i2c_read",
+    "i2c_write",
+    "spi_transfer"
+};
+
+maa_result_t
+maa_stats_enable(maa_boolean_t enable)
+{
+    if (enable)
+        __sync_fetch_and_or(&maa_instrument, MAA_INSTRUMENT_STATS);
+    else
+        __sync_fetch_and_and(&maa_instrument, ~MAA_INSTRUMENT_STATS);
+    return MAA_SUCCESS;
+}
+
+void
+maa_stats_begin(struct timespec* start)
+{
+    syscalls_start = maa_stats_syscalls;
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void
+maa_stats_end(maa_stats_op_t op, struct timespec* start, unsigned int bytes, int failed)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (maa_instrument & MAA_INSTRUMENT_TRACE)
+        maa_trace_record(op_names[op], start, &end);
+    if ((maa_instrument & MAA_INSTRUMENT_STATS) == 0)
+        return;
+    uint64_t ns = (uint64_t) (end.tv_sec - start->tv_sec) * 1000000000ULL +
+                  end.tv_nsec - start->tv_nsec;
+
+    int bucket = 0;
+    while (bucket < MAA_STATS_BUCKETS - 1 && (ns >> (bucket + 1)) != 0)
+        bucket++;
+
+    maa_stats_t* s = &stats[op];
+    __sync_fetch_and_add(&s->ops, 1);
+    __sync_fetch_and_add(&s->syscalls, maa_stats_syscalls - syscalls_start);
+    __sync_fetch_and_add(&s->bytes, bytes);
+    if (failed)
+        __sync_fetch_and_add(&s->errors, 1);
+    __sync_fetch_and_add(&s->total_ns, ns);
+    __sync_fetch_and_add(&s->histogram[bucket], 1);
+    uint64_t max = s->max_ns;
+    while (ns > max && !__sync_bool_compare_and_swap(&s->max_ns, max, ns))
+        max = s->max_ns;
+}
+
+maa_result_t
+maa_stats_get(maa_stats_op_t op, maa_stats_t* out)
+{
+    if (op < 0 || op >= MAA_STATS_OPS || out == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+    memcpy(out, &stats[op], sizeof(maa_stats_t));
+    return MAA_SUCCESS;
+}
+
+void
+maa_stats_reset()
+{
+    memset(stats, 0, sizeof(stats));
+}
+
+static uint64_t
+maa_stats_percentile(const maa_stats_t* s, unsigned int percent)
+{
+    uint64_t wanted = (s->ops * percent + 99) / 100;
+    uint64_t seen = 0;
+    int i;
+    for (i = 0; i < MAA_STATS_BUCKETS; i++) {
+        seen += s->histogram[i];
+        if (seen >= wanted)
+            return 2ULL << i;
+    }
+    return s->max_ns;
+}
+
+maa_result_t
+maa_stats_dump(FILE* out)
+{
+    if (out == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    fprintf(out, "%-13s %10s %10s %10s %7s %10s %10s %10s %10s\n", "op", "calls",
+            "syscalls", "bytes", "errors", "avg ns", "p50 ns", "p99 ns", "max ns");
+    int i;
+    for (i = 0; i < MAA_STATS_OPS; i++) {
+        maa_stats_t s;
+        maa_stats_get(i, &s);
+        if (s.ops == 0)
+            continue;
+        fprintf(out, "%-13s %10llu %10llu %10llu %7llu %10llu %10llu %10llu %10llu\n",
+                op_names[i], (unsigned long long) s.ops, (unsigned long long) s.syscalls,
+                (unsigned long long) s.bytes, (unsigned long long) s.errors,
+                (unsigned long long) (s.total_ns / s.ops),
+                (unsigned long long) maa_stats_percentile(&s, 50),
+                (unsigned long long) maa_stats_percentile(&s, 99),
+                (unsigned long long) s.max_ns);
+    }
+    return MAA_SUCCESS;
+}
+
+void
+maa_stats_report()
+{
+    maa_stats_dump(stderr);
+}
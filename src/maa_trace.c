@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "maa_internal.h"
+
+/** Bytes of an event name kept, including the terminating nul */
+#define MAA_TRACE_NAME_SIZE 32
+
+typedef struct {
+    volatile uint32_t seq; /**< index of the event plus one, 0 while written */
+    char name[MAA_TRACE_NAME_SIZE]; /**< copied so callers can reuse theirs */
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    int tid;
+    int pin; /**< pin of an isr event, -1 otherwise */
+    char phase; /**< Chrome trace phase, X complete or i instant */
+} maa_trace_event_t;
+
+/*
+ * One recording, published as a single pointer so a recorder never pairs the
+ * capacity of one buffer with the events of another
+ */
+typedef struct {
+    uint32_t capacity; /**< power of two */
+    volatile uint32_t head; /**< index of the next event */
+    maa_trace_event_t events[]; /**< the ring */
+} maa_trace_buffer_t;
+
+static maa_trace_buffer_t* volatile trace = NULL;
+/** recorders and dumps using trace, a replaced buffer is freed once idle */
+static volatile int trace_users = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int trace_tid = 0;
+
+static maa_trace_buffer_t*
+maa_trace_acquire()
+{
+    __sync_fetch_and_add(&trace_users, 1);
+    return trace;
+}
+
+static void
+maa_trace_release()
+{
+    __sync_fetch_and_sub(&trace_users, 1);
+}
+
+static uint64_t
+maa_trace_ns(const struct timespec* t)
+{
+    return (uint64_t) t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+static void
+maa_trace_push(const char* name, uint64_t ts_ns, uint64_t dur_ns, int pin, char phase)
+{
+    maa_trace_buffer_t* buf = maa_trace_acquire();
+    if (buf == NULL) {
+        maa_trace_release();
+        return;
+    }
+    if (trace_tid == 0)
+        trace_tid = (int) syscall(SYS_gettid);
+
+    uint32_t index = __sync_fetch_and_add(&buf->head, 1);
+    maa_trace_event_t* event = &buf->events[index & (buf->capacity - 1)];
+    event->seq = 0;
+    __sync_synchronize();
+    strncpy(event->name, name, MAA_TRACE_NAME_SIZE - 1);
+    event->name[MAA_TRACE_NAME_SIZE - 1] = '\0';
+    event->ts_ns = ts_ns;
+    event->dur_ns = dur_ns;
+    event->tid = trace_tid;
+    event->pin = pin;
+    event->phase = phase;
+    __sync_synchronize();
+    event->seq = index + 1;
+    maa_trace_release();
+}
+
+maa_result_t
+maa_trace_start(unsigned int size)
+{
+    if (size == 0 || size > 0x1000000)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    uint32_t slots = 1;
+    while (slots < size)
+        slots <<= 1;
+    maa_trace_buffer_t* buf = calloc(1, sizeof(maa_trace_buffer_t) + slots * sizeof(maa_trace_event_t));
+    if (buf == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    buf->capacity = slots;
+
+    pthread_mutex_lock(&trace_lock);
+    maa_trace_buffer_t* old = __sync_lock_test_and_set(&trace, buf);
+    // whoever still uses the old buffer took it before the swap
+    while (trace_users != 0)
+        sched_yield();
+    free(old);
+    pthread_mutex_unlock(&trace_lock);
+    __sync_fetch_and_or(&maa_instrument, MAA_INSTRUMENT_TRACE);
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_trace_stop()
+{
+    __sync_fetch_and_and(&maa_instrument, ~MAA_INSTRUMENT_TRACE);
+    return MAA_SUCCESS;
+}
+
+void
+maa_trace_record(const char* name, const struct timespec* start, const struct timespec* end)
+{
+    maa_trace_push(name, maa_trace_ns(start), maa_trace_ns(end) - maa_trace_ns(start), -1, 'X');
+}
+
+void
+maa_trace_isr(int pin)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    maa_trace_push("isr", maa_trace_ns(&now), 0, pin, 'i');
+}
+
+maa_result_t
+maa_trace_mark(const char* name)
+{
+    if (name == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+    if ((maa_instrument & MAA_INSTRUMENT_TRACE) == 0)
+        return MAA_SUCCESS;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    maa_trace_push(name, maa_trace_ns(&now), 0, -1, 'i');
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_trace_span(const char* name, const struct timespec* start)
+{
+    if (name == NULL || start == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+    if ((maa_instrument & MAA_INSTRUMENT_TRACE) == 0)
+        return MAA_SUCCESS;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    maa_trace_record(name, start, &now);
+    return MAA_SUCCESS;
+}
+
+/*
+ * Write s escaped for the inside of a JSON string
+ */
+static void
+maa_trace_json_string(FILE* out, const char* s)
+{
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+}
+
+maa_result_t
+maa_trace_dump(FILE* out)
+{
+    if (out == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+
+    int pid = (int) getpid();
+    fprintf(out, "{\"traceEvents\":[");
+    // keeps a restart from freeing the buffer under us
+    maa_trace_buffer_t* buf = maa_trace_acquire();
+    uint32_t end = buf != NULL ? buf->head : 0;
+    uint32_t index = buf != NULL && end > buf->capacity ? end - buf->capacity : 0;
+    const char* sep = "\n";
+    for (; buf != NULL && index != end; index++) {
+        maa_trace_event_t event = buf->events[index & (buf->capacity - 1)];
+        // skip slots being written or already reused
+        if (event.seq != index + 1)
+            continue;
+        event.name[MAA_TRACE_NAME_SIZE - 1] = '\0';
+        // timestamps are in microseconds, keep the nanoseconds as decimals
+        fprintf(out, "%s{\"name\":\"", sep);
+        maa_trace_json_string(out, event.name);
+        fprintf(out, "\",\"cat\":\"maa\",\"ph\":\"%c\",\"ts\":%llu.%03u,"
+                "\"pid\":%d,\"tid\":%d", event.phase,
+                (unsigned long long) (event.ts_ns / 1000), (unsigned int) (event.ts_ns % 1000),
+                pid, event.tid);
+        if (event.phase == 'X')
+            fprintf(out, ",\"dur\":%llu.%03u", (unsigned long long) (event.dur_ns / 1000),
+                    (unsigned int) (event.dur_ns % 1000));
+        else
+            fprintf(out, ",\"s\":\"t\"");
+        if (event.pin >= 0)
+            fprintf(out, ",\"args\":{\"pin\":%d}", event.pin);
+        fprintf(out, "}");
+        sep = ",\n";
+    }
+    maa_trace_release();
+    fprintf(out, "\n]}\n");
+    return MAA_SUCCESS;
+}
+
+void
+maa_trace_report()
+{
+    char* path = getenv("MAA_TRACE");
+    if (path == NULL)
+        return;
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open %s for the trace\n", path);
+        return;
+    }
+    maa_trace_stop();
+    maa_trace_dump(out);
+    fclose(out);
+}
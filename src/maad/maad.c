@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * maad owns every hardware context and serves them to unprivileged clients
+ * over a unix socket, see maad_protocol.h for the messages and client.h for
+ * the client side.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "maa.h"
+#include "maad_protocol.h"
+
+#define MAAD_MAX_CLIENTS 32
+/** Permissions of the socket unless -m is given */
+#define MAAD_DEFAULT_MODE 0660
+
+typedef enum {
+    MAAD_FREE = 0,
+    MAAD_GPIO,
+    MAAD_AIO,
+    MAAD_I2C,
+    MAAD_SPI
+} maad_type_t;
+
+struct maad_client;
+
+/**
+ * A context held on behalf of a client
+ */
+typedef struct {
+    maad_type_t type;
+    void* ctx;
+    struct maad_client* client; /**< owner, handed to the isr */
+    int index; /**< handle of this slot */
+    int pin; /**< pin the gpio was opened on */
+    gpio_edge_t edge; /**< edge the isr waits for */
+    maa_ring_context ring; /**< aio samples exported to the client, or NULL */
+} maad_handle_t;
+
+/**
+ * A connected client. Slots are never freed so an isr still running while
+ * its client goes away only finds a free handle.
+ */
+typedef struct maad_client {
+    int fd;
+    maad_handle_t handles[MAAD_MAX_HANDLES];
+    pthread_mutex_t ring_lock;
+    maad_ring_t* ring;
+    int ring_fd;
+    int event_fd;
+} maad_client_t;
+
+static maad_client_t clients[MAAD_MAX_CLIENTS];
+static volatile sig_atomic_t running = 1;
+
+static void
+maad_stop(int sig)
+{
+    (void) sig;
+    running = 0;
+}
+
+static void
+maad_gpio_isr(void* args)
+{
+    maad_handle_t* handle = (maad_handle_t*) args;
+    maad_client_t* client = handle->client;
+
+    maa_gpio_event_t event;
+    clock_gettime(CLOCK_MONOTONIC, &event.timestamp);
+    event.index = handle->index;
+    event.pin = handle->pin;
+    event.edge = handle->edge;
+
+    pthread_mutex_lock(&client->ring_lock);
+    maad_ring_t* ring = client->ring;
+    if (handle->type != MAAD_GPIO || ring == NULL) {
+        pthread_mutex_unlock(&client->ring_lock);
+        return;
+    }
+    if (event.edge == MAA_GPIO_EDGE_BOTH)
+        event.edge = maa_gpio_read((maa_gpio_context) handle->ctx) == 1 ?
+                     MAA_GPIO_EDGE_RISING : MAA_GPIO_EDGE_FALLING;
+    if (ring->head - ring->tail >= MAAD_RING_SIZE) {
+        ring->dropped++;
+    } else {
+        ring->events[ring->head % MAAD_RING_SIZE] = event;
+        __sync_synchronize();
+        ring->head++;
+    }
+    pthread_mutex_unlock(&client->ring_lock);
+
+    uint64_t one = 1;
+    if (write(client->event_fd, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "maad: failed to signal client event\n");
+}
+
+static void
+maad_handle_close(maad_client_t* client, maad_handle_t* handle)
+{
+    switch (handle->type) {
+        case MAAD_GPIO:
+            maa_gpio_isr_exit((maa_gpio_context) handle->ctx);
+            pthread_mutex_lock(&client->ring_lock);
+            handle->type = MAAD_FREE;
+            pthread_mutex_unlock(&client->ring_lock);
+            maa_gpio_close((maa_gpio_context) handle->ctx);
+            break;
+        case MAAD_AIO:
+            if (handle->ring != NULL) {
+                maa_aio_export_stop((maa_aio_context) handle->ctx);
+                maa_ring_close(handle->ring);
+                handle->ring = NULL;
+            }
+            maa_aio_close((maa_aio_context) handle->ctx);
+            break;
+        case MAAD_I2C:
+            maa_i2c_stop((maa_i2c_context) handle->ctx);
+            break;
+        case MAAD_SPI:
+            maa_spi_stop((maa_spi_context) handle->ctx);
+            break;
+        default:
+            break;
+    }
+    handle->type = MAAD_FREE;
+    handle->ctx = NULL;
+}
+
+static void
+maad_client_close(maad_client_t* client)
+{
+    int i;
+    for (i = 0; i < MAAD_MAX_HANDLES; i++)
+        maad_handle_close(client, &client->handles[i]);
+
+    pthread_mutex_lock(&client->ring_lock);
+    if (client->ring != NULL)
+        munmap(client->ring, sizeof(maad_ring_t));
+    client->ring = NULL;
+    pthread_mutex_unlock(&client->ring_lock);
+    if (client->ring_fd != -1)
+        close(client->ring_fd);
+    if (client->event_fd != -1)
+        close(client->event_fd);
+    close(client->fd);
+    client->ring_fd = -1;
+    client->event_fd = -1;
+    client->fd = -1;
+}
+
+static int32_t
+maad_handle_open(maad_client_t* client, maad_type_t type, void* ctx)
+{
+    if (ctx == NULL)
+        return -MAA_ERROR_INVALID_RESOURCE;
+    int i;
+    for (i = 0; i < MAAD_MAX_HANDLES; i++) {
+        maad_handle_t* handle = &client->handles[i];
+        if (handle->type == MAAD_FREE) {
+            handle->ctx = ctx;
+            handle->client = client;
+            handle->index = i;
+            handle->type = type;
+            return i;
+        }
+    }
+    return -MAA_ERROR_NO_RESOURCES;
+}
+
+static void*
+maad_handle_get(maad_client_t* client, int index, maad_type_t type)
+{
+    if (index < 0 || index >= MAAD_MAX_HANDLES || client->handles[index].type != type)
+        return NULL;
+    return client->handles[index].ctx;
+}
+
+static int32_t
+maad_events(maad_client_t* client)
+{
+    if (client->ring != NULL)
+        return MAA_SUCCESS;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/maad-%d-%d", getpid(), client->fd);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+        return -MAA_ERROR_NO_RESOURCES;
+    shm_unlink(name);
+    if (ftruncate(fd, sizeof(maad_ring_t)) == -1) {
+        close(fd);
+        return -MAA_ERROR_NO_RESOURCES;
+    }
+    void* ring = mmap(NULL, sizeof(maad_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int event_fd = eventfd(0, EFD_NONBLOCK);
+    if (ring == MAP_FAILED || event_fd == -1) {
+        if (ring != MAP_FAILED)
+            munmap(ring, sizeof(maad_ring_t));
+        if (event_fd != -1)
+            close(event_fd);
+        close(fd);
+        return -MAA_ERROR_NO_RESOURCES;
+    }
+    client->ring_fd = fd;
+    client->event_fd = event_fd;
+    pthread_mutex_lock(&client->ring_lock);
+    client->ring = (maad_ring_t*) ring;
+    pthread_mutex_unlock(&client->ring_lock);
+    return MAA_SUCCESS;
+}
+
+/*
+ * Sample an aio into a ring named after the handle, the name is returned in
+ * the response so the client can attach to it
+ */
+static int32_t
+maad_aio_stream(maad_client_t* client, int index, unsigned int interval_us, maad_resp_t* resp)
+{
+    maad_handle_t* handle = &client->handles[index];
+    if (handle->ring != NULL)
+        return -MAA_ERROR_INVALID_RESOURCE;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/maad-%d-%d-aio%d", getpid(), client->fd, index);
+    maa_ring_context ring = maa_ring_create(name, sizeof(maa_aio_sample_t), MAAD_AIO_RING_SIZE);
+    if (ring == NULL)
+        return -MAA_ERROR_NO_RESOURCES;
+    maa_result_t ret = maa_aio_export((maa_aio_context) handle->ctx, ring, interval_us);
+    if (ret != MAA_SUCCESS) {
+        maa_ring_close(ring);
+        return -ret;
+    }
+    handle->ring = ring;
+    resp->len = strlen(name);
+    memcpy(resp->data, name, resp->len);
+    return 0;
+}
+
+static int32_t
+maad_result(maa_result_t result)
+{
+    return result == MAA_SUCCESS ? 0 : -result;
+}
+
+static void
+maad_dispatch(maad_client_t* client, const maad_req_t* req, maad_resp_t* resp)
+{
+    void* ctx = NULL;
+    resp->len = 0;
+    resp->result = -MAA_ERROR_INVALID_HANDLE;
+
+    switch (req->op) {
+        case MAAD_GPIO_INIT:
+            resp->result = maad_handle_open(client, MAAD_GPIO, maa_gpio_init(req->arg));
+            if (resp->result >= 0)
+                client->handles[resp->result].pin = req->arg;
+            break;
+        case MAAD_GPIO_DIR:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_GPIO)) != NULL)
+                resp->result = maad_result(maa_gpio_dir(ctx, (gpio_dir_t) req->arg));
+            break;
+        case MAAD_GPIO_READ:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_GPIO)) != NULL) {
+                int value = maa_gpio_read(ctx);
+                resp->result = value < 0 ? -MAA_ERROR_INVALID_RESOURCE : value;
+            }
+            break;
+        case MAAD_GPIO_WRITE:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_GPIO)) != NULL)
+                resp->result = maad_result(maa_gpio_write(ctx, req->arg));
+            break;
+        case MAAD_GPIO_ISR:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_GPIO)) == NULL)
+                break;
+            if (client->ring == NULL) {
+                resp->result = -MAA_ERROR_INVALID_RESOURCE;
+                break;
+            }
+            client->handles[req->handle].edge = (gpio_edge_t) req->arg;
+            resp->result = maad_result(maa_gpio_isr(ctx, (gpio_edge_t) req->arg,
+                                       &maad_gpio_isr, &client->handles[req->handle]));
+            break;
+        case MAAD_AIO_INIT:
+            resp->result = maad_handle_open(client, MAAD_AIO, maa_aio_init(req->arg));
+            break;
+        case MAAD_AIO_READ:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_AIO)) == NULL)
+                break;
+            // the export thread owns the input while it streams
+            if (client->handles[req->handle].ring != NULL)
+                resp->result = -MAA_ERROR_INVALID_RESOURCE;
+            else
+                resp->result = maa_aio_read(ctx);
+            break;
+        case MAAD_AIO_STREAM:
+            if (maad_handle_get(client, req->handle, MAAD_AIO) != NULL)
+                resp->result = maad_aio_stream(client, req->handle, (unsigned int) req->arg, resp);
+            break;
+        case MAAD_I2C_INIT:
+            resp->result = maad_handle_open(client, MAAD_I2C, maa_i2c_init(req->arg));
+            break;
+        case MAAD_I2C_ADDRESS:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_I2C)) != NULL)
+                resp->result = maad_result(maa_i2c_address(ctx, req->arg));
+            break;
+        case MAAD_I2C_READ:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_I2C)) == NULL)
+                break;
+            if (req->arg < 0 || req->arg > MAAD_MAX_DATA) {
+                resp->result = -MAA_ERROR_INVALID_PARAMETER;
+                break;
+            }
+            resp->result = maa_i2c_read(ctx, resp->data, req->arg);
+            resp->len = resp->result > 0 ? resp->result : 0;
+            break;
+        case MAAD_I2C_WRITE:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_I2C)) != NULL)
+                resp->result = maad_result(maa_i2c_write(ctx, req->data, req->len));
+            break;
+        case MAAD_SPI_INIT:
+            resp->result = maad_handle_open(client, MAAD_SPI, maa_spi_init(req->arg));
+            break;
+        case MAAD_SPI_TRANSFER:
+            if ((ctx = maad_handle_get(client, req->handle, MAAD_SPI)) == NULL)
+                break;
+            resp->result = maad_result(maa_spi_transfer_buf(ctx, req->data, resp->data, req->len));
+            if (resp->result == 0)
+                resp->len = req->len;
+            break;
+        case MAAD_GPIO_CLOSE:
+        case MAAD_AIO_CLOSE:
+        case MAAD_I2C_CLOSE:
+        case MAAD_SPI_CLOSE: {
+            static const maad_type_t types[] = { MAAD_GPIO, MAAD_AIO, MAAD_I2C, MAAD_SPI };
+            int kind = req->op == MAAD_GPIO_CLOSE ? 0 : req->op == MAAD_AIO_CLOSE ? 1 :
+                       req->op == MAAD_I2C_CLOSE ? 2 : 3;
+            if (maad_handle_get(client, req->handle, types[kind]) != NULL) {
+                maad_handle_close(client, &client->handles[req->handle]);
+                resp->result = 0;
+            }
+            break;
+        }
+        case MAAD_EVENTS:
+            resp->result = maad_events(client);
+            break;
+        default:
+            resp->result = -MAA_ERROR_FEATURE_NOT_SUPPORTED;
+            break;
+    }
+}
+
+/*
+ * Serve one message of a client, returns -1 when the client went away
+ */
+static int
+maad_serve(maad_client_t* client)
+{
+    static maad_req_msg_t req;
+    static maad_resp_msg_t resp;
+
+    ssize_t got = recv(client->fd, &req, sizeof(req), 0);
+    if (got < (ssize_t) offsetof(maad_req_msg_t, req))
+        return -1;
+    if (req.count > MAAD_MAX_BATCH ||
+        got < (ssize_t) (offsetof(maad_req_msg_t, req) + req.count * sizeof(maad_req_t)))
+        return -1;
+
+    int send_fds = 0;
+    uint32_t i;
+    for (i = 0; i < req.count; i++) {
+        if (req.req[i].len > MAAD_MAX_DATA)
+            req.req[i].len = MAAD_MAX_DATA;
+        maad_dispatch(client, &req.req[i], &resp.resp[i]);
+        if (req.req[i].op == MAAD_EVENTS && resp.resp[i].result == 0)
+            send_fds = 1;
+    }
+    resp.count = req.count;
+
+    struct iovec iov = { &resp, offsetof(maad_resp_msg_t, resp) + resp.count * sizeof(maad_resp_t) };
+    struct msghdr msg;
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (send_fds) {
+        int fds[2] = { client->ring_fd, client->event_fd };
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    }
+    if (sendmsg(client->fd, &msg, MSG_NOSIGNAL) == -1)
+        return -1;
+    return 0;
+}
+
+/*
+ * Create the socket with mode and, unless gid is -1, owned by that group.
+ * The umask keeps the socket closed to others until it has both.
+ */
+static int
+maad_listen(const char* path, mode_t mode, gid_t gid)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "maad: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd == -1)
+        return -1;
+    unlink(path);
+    mode_t mask = umask(0777 & ~mode);
+    int bound = bind(fd, (struct sockaddr*) &addr, sizeof(addr));
+    umask(mask);
+    if (bound == -1) {
+        fprintf(stderr, "maad: failed to bind %s\n", path);
+        close(fd);
+        return -1;
+    }
+    if ((gid != (gid_t) -1 && chown(path, (uid_t) -1, gid) == -1) ||
+        chmod(path, mode) == -1 || listen(fd, 8) == -1) {
+        fprintf(stderr, "maad: failed to listen on %s\n", path);
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+static void
+maad_usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-g group] [-m mode] [socket]\n", name);
+}
+
+int
+main(int argc, char** argv)
+{
+    const char* path = getenv("MAAD_SOCKET");
+    mode_t mode = MAAD_DEFAULT_MODE;
+    gid_t gid = (gid_t) -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:m:")) != -1) {
+        char* end;
+        switch (opt) {
+            case 'g': {
+                struct group* grp = getgrnam(optarg);
+                if (grp != NULL) {
+                    gid = grp->gr_gid;
+                    break;
+                }
+                gid = (gid_t) strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0') {
+                    fprintf(stderr, "maad: unknown group %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'm':
+                mode = (mode_t) strtoul(optarg, &end, 8);
+                if (*optarg == '\0' || *end != '\0' || mode > 0777) {
+                    fprintf(stderr, "maad: bad mode %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                maad_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc)
+        path = argv[optind];
+    if (path == NULL)
+        path = MAAD_DEFAULT_SOCKET;
+
+    int i;
+    for (i = 0; i < MAAD_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].ring_fd = -1;
+        clients[i].event_fd = -1;
+        pthread_mutex_init(&clients[i].ring_lock, NULL);
+    }
+
+    int listen_fd = maad_listen(path, mode, gid);
+    if (listen_fd == -1)
+        return 1;
+    signal(SIGINT, maad_stop);
+    signal(SIGTERM, maad_stop);
+
+    struct pollfd fds[MAAD_MAX_CLIENTS + 1];
+    while (running) {
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (i = 0; i < MAAD_MAX_CLIENTS; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        if (poll(fds, MAAD_MAX_CLIENTS + 1, -1) == -1)
+            continue;
+
+        for (i = 0; i < MAAD_MAX_CLIENTS; i++) {
+            if (clients[i].fd != -1 && fds[i + 1].revents != 0 &&
+                maad_serve(&clients[i]) == -1)
+                maad_client_close(&clients[i]);
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd == -1)
+                continue;
+            for (i = 0; i < MAAD_MAX_CLIENTS && clients[i].fd != -1; i++)
+                ;
+            if (i == MAAD_MAX_CLIENTS) {
+                fprintf(stderr, "maad: too many clients\n");
+                close(fd);
+                continue;
+            }
+            clients[i].fd = fd;
+        }
+    }
+
+    for (i = 0; i < MAAD_MAX_CLIENTS; i++)
+        if (clients[i].fd != -1)
+            maad_client_close(&clients[i]);
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "program.h"
+#include "maa_internal.h"
+
+#define MAA_PROGRAM_SPIN_US 100
+/* Largest result buffer a program may need */
+#define MAA_PROGRAM_MAX_RESULTS (16 * 1024 * 1024)
+
+typedef enum {
+    MAA_PROGRAM_OP_GPIO_WRITE   = 0,
+    MAA_PROGRAM_OP_GPIO_READ    = 1,
+    MAA_PROGRAM_OP_WAIT_US      = 2,
+    MAA_PROGRAM_OP_SPI_TRANSFER = 3,
+    MAA_PROGRAM_OP_I2C_WRITE    = 4,
+    MAA_PROGRAM_OP_I2C_READ     = 5,
+    MAA_PROGRAM_OP_LOOP         = 6,
+    MAA_PROGRAM_OP_BRANCH       = 7
+} maa_program_opcode_t;
+
+/**
+ * A single operation, the meaning of a and b depends on the opcode
+ */
+typedef struct {
+    /*@{*/
+    maa_program_opcode_t code; /**< what to do */
+    int slot; /**< device slot */
+    int a; /**< value, wait time, length or jump target */
+    int b; /**< loop count or value to compare */
+    int data_off; /**< offset of inline data in the data pool */
+    unsigned int counter; /**< loop iterations done, runtime only */
+    /*@}*/
+} maa_program_op_t;
+
+struct _program {
+    /*@{*/
+    maa_program_op_t* ops; /**< operations */
+    int ops_len; /**< number of operations */
+    int ops_cap; /**< allocated operations */
+    uint8_t* data; /**< inline data pool */
+    int data_len; /**< bytes used in the data pool */
+    int data_cap; /**< allocated bytes in the data pool */
+    uint8_t* results; /**< result buffer, sized while the program is built */
+    int results_len; /**< bytes used in the result buffer */
+    int results_cap; /**< allocated bytes in the result buffer */
+    maa_gpio_context gpio[MAA_PROGRAM_MAX_DEVICES];
+    int gpio_count;
+    maa_spi_context spi[MAA_PROGRAM_MAX_DEVICES];
+    int spi_count;
+    maa_i2c_context i2c[MAA_PROGRAM_MAX_DEVICES];
+    int i2c_count;
+    maa_result_t status; /**< result of the last run */
+    /*@}*/
+};
+
+maa_program_context
+maa_program_init()
+{
+    maa_program_context prog = (maa_program_context) malloc(sizeof(struct _program));
+    if (prog == NULL)
+        return NULL;
+    memset(prog, 0, sizeof(struct _program));
+    return prog;
+}
+
+int
+maa_program_add_gpio(maa_program_context prog, maa_gpio_context dev)
+{
+    if (prog == NULL || dev == NULL || prog->gpio_count >= MAA_PROGRAM_MAX_DEVICES)
+        return -1;
+    prog->gpio[prog->gpio_count] = dev;
+    return prog->gpio_count++;
+}
+
+int
+maa_program_add_spi(maa_program_context prog, maa_spi_context dev)
+{
+    if (prog == NULL || dev == NULL || prog->spi_count >= MAA_PROGRAM_MAX_DEVICES)
+        return -1;
+    prog->spi[prog->spi_count] = dev;
+    return prog->spi_count++;
+}
+
+int
+maa_program_add_i2c(maa_program_context prog, maa_i2c_context dev)
+{
+    if (prog == NULL || dev == NULL || prog->i2c_count >= MAA_PROGRAM_MAX_DEVICES)
+        return -1;
+    prog->i2c[prog->i2c_count] = dev;
+    return prog->i2c_count++;
+}
+
+int
+maa_program_size(maa_program_context prog)
+{
+    if (prog == NULL)
+        return -1;
+    return prog->ops_len;
+}
+
+static maa_program_op_t*
+maa_program_append(maa_program_context prog, maa_program_opcode_t code)
+{
+    if (prog->ops_len == prog->ops_cap) {
+        int cap = prog->ops_cap == 0 ? 16 : prog->ops_cap * 2;
+        maa_program_op_t* ops = realloc(prog->ops, cap * sizeof(maa_program_op_t));
+        if (ops == NULL)
+            return NULL;
+        prog->ops = ops;
+        prog->ops_cap = cap;
+    }
+    maa_program_op_t* op = &prog->ops[prog->ops_len++];
+    memset(op, 0, sizeof(maa_program_op_t));
+    op->code = code;
+    return op;
+}
+
+static int
+maa_program_store(maa_program_context prog, const uint8_t* data, int length)
+{
+    if (prog->data_len + length > prog->data_cap) {
+        int cap = prog->data_cap == 0 ? 64 : prog->data_cap;
+        while (cap < prog->data_len + length)
+            cap *= 2;
+        uint8_t* pool = realloc(prog->data, cap);
+        if (pool == NULL)
+            return -1;
+        prog->data = pool;
+        prog->data_cap = cap;
+    }
+    int off = prog->data_len;
+    memcpy(prog->data + off, data, length);
+    prog->data_len += length;
+    return off;
+}
+
+/*
+ * Grow the result buffer to what a run can produce, so that running never
+ * allocates. Each operation runs once, times the count of every loop around
+ * it. Only a branch jumping backwards can make a run read more, in which case
+ * the run stops with MAA_ERROR_NO_RESOURCES once the buffer is full.
+ * On failure the last operation appended is dropped again.
+ */
+static maa_result_t
+maa_program_size_results(maa_program_context prog)
+{
+    uint64_t* runs = malloc(prog->ops_len * sizeof(uint64_t));
+    if (runs == NULL) {
+        prog->ops_len--;
+        return MAA_ERROR_NO_RESOURCES;
+    }
+
+    int i, j;
+    for (i = 0; i < prog->ops_len; i++)
+        runs[i] = 1;
+    for (i = 0; i < prog->ops_len; i++) {
+        if (prog->ops[i].code != MAA_PROGRAM_OP_LOOP)
+            continue;
+        for (j = prog->ops[i].a; j <= i; j++) {
+            runs[j] *= (unsigned int) prog->ops[i].b;
+            if (runs[j] > MAA_PROGRAM_MAX_RESULTS)
+                runs[j] = MAA_PROGRAM_MAX_RESULTS + 1;
+        }
+    }
+
+    uint64_t need = 0;
+    for (i = 0; i < prog->ops_len && need <= MAA_PROGRAM_MAX_RESULTS; i++) {
+        switch (prog->ops[i].code) {
+            case MAA_PROGRAM_OP_GPIO_READ:
+                need += runs[i];
+                break;
+            case MAA_PROGRAM_OP_SPI_TRANSFER:
+            case MAA_PROGRAM_OP_I2C_READ:
+                need += runs[i] * prog->ops[i].a;
+                break;
+            default:
+                break;
+        }
+    }
+    free(runs);
+
+    if (need > MAA_PROGRAM_MAX_RESULTS) {
+        prog->ops_len--;
+        return MAA_ERROR_NO_RESOURCES;
+    }
+    if (need > (uint64_t) prog->results_cap) {
+        uint8_t* res = realloc(prog->results, need);
+        if (res == NULL) {
+            prog->ops_len--;
+            return MAA_ERROR_NO_RESOURCES;
+        }
+        prog->results = res;
+        prog->results_cap = (int) need;
+    }
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_program_gpio_write(maa_program_context prog, int slot, int value)
+{
+    if (prog == NULL || slot < 0 || slot >= prog->gpio_count)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_GPIO_WRITE);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->slot = slot;
+    op->a = value;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_program_gpio_read(maa_program_context prog, int slot)
+{
+    if (prog == NULL || slot < 0 || slot >= prog->gpio_count)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_GPIO_READ);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->slot = slot;
+    return maa_program_size_results(prog);
+}
+
+maa_result_t
+maa_program_wait_us(maa_program_context prog, unsigned int us)
+{
+    if (prog == NULL)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_WAIT_US);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->a = us;
+    return MAA_SUCCESS;
+}
+
+static maa_result_t
+maa_program_transfer(maa_program_context prog, maa_program_opcode_t code, int slot, const uint8_t* data, int length)
+{
+    if (data == NULL || length <= 0)
+        return MAA_ERROR_INVALID_PARAMETER;
+    int off = maa_program_store(prog, data, length);
+    if (off < 0)
+        return MAA_ERROR_NO_RESOURCES;
+    maa_program_op_t* op = maa_program_append(prog, code);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->slot = slot;
+    op->a = length;
+    op->data_off = off;
+    if (code != MAA_PROGRAM_OP_SPI_TRANSFER)
+        return MAA_SUCCESS;
+    maa_result_t ret = maa_program_size_results(prog);
+    if (ret != MAA_SUCCESS)
+        prog->data_len = off;
+    return ret;
+}
+
+maa_result_t
+maa_program_spi_transfer(maa_program_context prog, int slot, const uint8_t* data, int length)
+{
+    if (prog == NULL || slot < 0 || slot >= prog->spi_count)
+        return MAA_ERROR_INVALID_PARAMETER;
+    return maa_program_transfer(prog, MAA_PROGRAM_OP_SPI_TRANSFER, slot, data, length);
+}
+
+maa_result_t
+maa_program_i2c_write(maa_program_context prog, int slot, const uint8_t* data, int length)
+{
+    if (prog == NULL || slot < 0 || slot >= prog->i2c_count)
+        return MAA_ERROR_INVALID_PARAMETER;
+    return maa_program_transfer(prog, MAA_PROGRAM_OP_I2C_WRITE, slot, data, length);
+}
+
+maa_result_t
+maa_program_i2c_read(maa_program_context prog, int slot, int length)
+{
+    if (prog == NULL || slot < 0 || slot >= prog->i2c_count || length <= 0)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_I2C_READ);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->slot = slot;
+    op->a = length;
+    return maa_program_size_results(prog);
+}
+
+maa_result_t
+maa_program_loop(maa_program_context prog, int target, unsigned int count)
+{
+    // a loop can only jump backwards, to itself excluded
+    if (prog == NULL || target < 0 || target >= prog->ops_len || count == 0)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_LOOP);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->a = target;
+    op->b = count;
+    return maa_program_size_results(prog);
+}
+
+maa_result_t
+maa_program_branch(maa_program_context prog, int target, int value)
+{
+    // forward targets are checked when the program is run
+    if (prog == NULL || target < 0)
+        return MAA_ERROR_INVALID_PARAMETER;
+    maa_program_op_t* op = maa_program_append(prog, MAA_PROGRAM_OP_BRANCH);
+    if (op == NULL)
+        return MAA_ERROR_NO_RESOURCES;
+    op->a = target;
+    op->b = value;
+    return MAA_SUCCESS;
+}
+
+static uint8_t*
+maa_program_result_reserve(maa_program_context prog, int length)
+{
+    if (prog->results_len + length > prog->results_cap)
+        return NULL;
+    uint8_t* ret = prog->results + prog->results_len;
+    prog->results_len += length;
+    return ret;
+}
+
+static void
+maa_program_wait(struct timespec* deadline, unsigned int us)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_nsec += (long) (us % 1000000) * 1000;
+    deadline->tv_sec += us / 1000000 + deadline->tv_nsec / 1000000000;
+    deadline->tv_nsec %= 1000000000;
+
+    // the scheduler wakes us up too late for very short waits, spin instead
+    if (us > MAA_PROGRAM_SPIN_US) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR);
+        return;
+    }
+    struct timespec now;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (now.tv_sec < deadline->tv_sec ||
+             (now.tv_sec == deadline->tv_sec && now.tv_nsec < deadline->tv_nsec));
+}
+
+static maa_result_t
+maa_program_execute(maa_program_context prog)
+{
+    struct timespec deadline;
+    int last = 0;
+    int pc = 0;
+    uint8_t* out;
+
+    while (pc < prog->ops_len) {
+        maa_program_op_t* op = &prog->ops[pc];
+        pc++;
+        switch (op->code) {
+            case MAA_PROGRAM_OP_GPIO_WRITE:
+                if (maa_gpio_write(prog->gpio[op->slot], op->a) != MAA_SUCCESS)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                break;
+            case MAA_PROGRAM_OP_GPIO_READ:
+                last = maa_gpio_read(prog->gpio[op->slot]);
+                if (last < 0)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                if ((out = maa_program_result_reserve(prog, 1)) == NULL)
+                    return MAA_ERROR_NO_RESOURCES;
+                *out = (uint8_t) last;
+                break;
+            case MAA_PROGRAM_OP_WAIT_US:
+                maa_program_wait(&deadline, op->a);
+                break;
+            case MAA_PROGRAM_OP_SPI_TRANSFER:
+                if ((out = maa_program_result_reserve(prog, op->a)) == NULL)
+                    return MAA_ERROR_NO_RESOURCES;
+                if (maa_spi_transfer_buf(prog->spi[op->slot], prog->data + op->data_off, out, op->a) != MAA_SUCCESS)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                last = out[op->a - 1];
+                break;
+            case MAA_PROGRAM_OP_I2C_WRITE:
+                if (maa_i2c_write(prog->i2c[op->slot], prog->data + op->data_off, op->a) != MAA_SUCCESS)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                break;
+            case MAA_PROGRAM_OP_I2C_READ:
+                if ((out = maa_program_result_reserve(prog, op->a)) == NULL)
+                    return MAA_ERROR_NO_RESOURCES;
+                if (maa_i2c_read(prog->i2c[op->slot], out, op->a) != op->a)
+                    return MAA_ERROR_INVALID_RESOURCE;
+                last = out[op->a - 1];
+                break;
+            case MAA_PROGRAM_OP_LOOP:
+                if (++op->counter < (unsigned int) op->b) {
+                    pc = op->a;
+                } else {
+                    op->counter = 0;
+                }
+                break;
+            case MAA_PROGRAM_OP_BRANCH:
+                if (last == op->b) {
+                    if (op->a > prog->ops_len)
+                        return MAA_ERROR_INVALID_PARAMETER;
+                    pc = op->a;
+                }
+                break;
+            default:
+                return MAA_ERROR_FEATURE_NOT_IMPLEMENTED;
+        }
+    }
+    return MAA_SUCCESS;
+}
+
+static void*
+maa_program_thread(void* arg)
+{
+    maa_program_context prog = (maa_program_context) arg;
+    prog->status = maa_program_execute(prog);
+    return NULL;
+}
+
+maa_result_t
+maa_program_run(maa_program_context prog, unsigned int priority)
+{
+    if (prog == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+
+    int i;
+    for (i = 0; i < prog->ops_len; i++) {
+        prog->ops[i].counter = 0;
+    }
+    prog->results_len = 0;
+    prog->status = MAA_ERROR_UNSPECIFIED;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(struct sched_param));
+        param.sched_priority = priority;
+        if (param.sched_priority > sched_get_priority_max(SCHED_FIFO))
+            param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+
+    int err = pthread_create(&thread, &attr, maa_program_thread, (void *) prog);
+    if (err == EPERM) {
+        // not allowed to use realtime scheduling, run with normal priority
+        fprintf(stderr, "Program: no permission for SCHED_FIFO, running unprivileged\n");
+        pthread_attr_destroy(&attr);
+        pthread_attr_init(&attr);
+        err = pthread_create(&thread, &attr, maa_program_thread, (void *) prog);
+    }
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+        return MAA_ERROR_NO_RESOURCES;
+
+    pthread_join(thread, NULL);
+    return prog->status;
+}
+
+const uint8_t*
+maa_program_results(maa_program_context prog, int* length)
+{
+    if (prog == NULL)
+        return NULL;
+    if (length != NULL)
+        *length = prog->results_len;
+    return prog->results;
+}
+
+maa_result_t
+maa_program_close(maa_program_context prog)
+{
+    if (prog == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    free(prog->ops);
+    free(prog->data);
+    free(prog->results);
+    free(prog);
+    return MAA_SUCCESS;
+}
@@ -28,8 +28,9 @@
 
 #include "pwm.h"
 #include "maa_internal.h"
+#include "maa_pool.h"
 
-#define MAX_SIZE 64
+#define MAX_SIZE 128
 #define SYSFS_PWM "/sys/class/pwm"
 
 /**
@@ -41,16 +42,20 @@ struct _pwm {
     int chipid; /**< the chip id, which the pwm resides */
     int duty_fp; /**< File pointer to duty file */
     maa_boolean_t owner; /**< Owner of pwm context*/
+    int phy_pin; /**< board pin it was set up for, -1 when raw */
     /*@}*/
 };
 
+const size_t maa_pwm_context_size = sizeof(struct _pwm);
+
 static int
 maa_pwm_setup_duty_fp(maa_pwm_context dev)
 {
     char bu[MAX_SIZE];
-    snprintf(bu,MAX_SIZE, "/sys/class/pwm/pwmchip%d/pwm%d/duty_cycle", dev->chipid, dev->pin);
+    snprintf(bu,MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/pwm%d/duty_cycle", maa_sysfs_root(), dev->chipid, dev->pin);
 
     dev->duty_fp = open(bu, O_RDWR);
+    MAA_STATS_SYSCALL(1);
     if (dev->duty_fp == -1) {
         return 1;
     }
@@ -61,21 +66,21 @@ static maa_result_t
 maa_pwm_write_period(maa_pwm_context dev, int period)
 {
     char bu[MAX_SIZE];
-    snprintf(bu,MAX_SIZE ,"/sys/class/pwm/pwmchip%d/pwm%d/period", dev->chipid, dev->pin);
+    snprintf(bu,MAX_SIZE ,"%s" SYSFS_PWM "/pwmchip%d/pwm%d/period", maa_sysfs_root(), dev->chipid, dev->pin);
 
     int period_f = open(bu, O_RDWR);
+    MAA_STATS_SYSCALL(1);
     if (period_f == -1) {
         fprintf(stderr, "Failed to open period for writing!\n");
         return MAA_ERROR_INVALID_RESOURCE;
     }
     char out[MAX_SIZE];
     int length = snprintf(out, MAX_SIZE, "%d", period);
-    if (write(period_f, out, length*sizeof(char)) == -1) {
-        close(period_f);
-        return MAA_ERROR_INVALID_RESOURCE;
-    }
-
+    ssize_t written = write(period_f, out, length*sizeof(char));
     close(period_f);
+    MAA_STATS_SYSCALL(2);
+    if (written == -1)
+        return MAA_ERROR_INVALID_RESOURCE;
     return MAA_SUCCESS;
 }
 
@@ -87,7 +92,9 @@ maa_pwm_write_duty(maa_pwm_context dev, int duty)
     }
     char bu[64];
     int length = sprintf(bu, "%d", duty);
-    if (write(dev->duty_fp, bu, length * sizeof(char)) == -1)
+    ssize_t written = write(dev->duty_fp, bu, length * sizeof(char));
+    MAA_STATS_SYSCALL(1);
+    if (written == -1)
         return MAA_ERROR_INVALID_RESOURCE;
     return MAA_SUCCESS;
 }
@@ -97,9 +104,10 @@ maa_pwm_get_period(maa_pwm_context dev)
 {
     char bu[MAX_SIZE];
     char output[MAX_SIZE];
-    snprintf(bu,MAX_SIZE, "/sys/class/pwm/pwmchip%d/pwm%d/period", dev->chipid, dev->pin);
+    snprintf(bu,MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/pwm%d/period", maa_sysfs_root(), dev->chipid, dev->pin);
 
     int period_f = open(bu, O_RDWR);
+    MAA_STATS_SYSCALL(1);
     if (period_f == -1) {
         fprintf(stderr, "Failed to open period for reading!\n");
         return 0;
@@ -109,6 +117,7 @@ maa_pwm_get_period(maa_pwm_context dev)
 
     read(period_f, output, size + 1);
     close(period_f);
+    MAA_STATS_SYSCALL(4);
     int ret = strtol(output, NULL, 10);
 
     return ret;
@@ -121,11 +130,13 @@ maa_pwm_get_duty(maa_pwm_context dev)
         maa_pwm_setup_duty_fp(dev);
     } else {
         lseek(dev->duty_fp, 0, SEEK_SET);
+        MAA_STATS_SYSCALL(1);
     }
     off_t size = lseek(dev->duty_fp, 0, SEEK_END);
     lseek(dev->duty_fp, 0, SEEK_SET);
     char output[MAX_SIZE];
     read(dev->duty_fp, output, size+1);
+    MAA_STATS_SYSCALL(3);
 
     int ret = strtol(output, NULL, 10);
     return ret;
@@ -138,33 +149,39 @@ maa_pwm_init(int pin) {
         return NULL;
     int chip = pinm->parent_id;
     int pinn = pinm->pinmap;
-    free(pinm);
-    return maa_pwm_init_raw(chip,pinn);
+    maa_pwm_context dev = maa_pwm_init_raw(chip,pinn);
+    if (dev == NULL) {
+        maa_release_pin(pin);
+        return NULL;
+    }
+    dev->phy_pin = pin;
+    return dev;
 }
 
 maa_pwm_context
 maa_pwm_init_raw(int chipin, int pin)
 {
-    maa_pwm_context dev = (maa_pwm_context) malloc(sizeof(struct _pwm));
+    maa_pwm_context dev = (maa_pwm_context) maa_pool_alloc(MAA_POOL_PWM);
     if (dev == NULL)
         return NULL;
     dev->duty_fp = -1;
+    dev->phy_pin = -1;
     dev->chipid = chipin;
     dev->pin = pin;
 
     char directory[MAX_SIZE];
-    snprintf(directory, MAX_SIZE, SYSFS_PWM "/pwmchip%d/pwm%d", dev->chipid, dev->pin);
+    snprintf(directory, MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/pwm%d", maa_sysfs_root(), dev->chipid, dev->pin);
     struct stat dir;
     if (stat(directory, &dir) == 0 && S_ISDIR(dir.st_mode)) {
-        fprintf(stderr, "PWM Pin already exporting, continuing.\n");
+        maa_log(MAA_LOG_INFO, "PWM Pin already exporting, continuing.");
         dev->owner = 0; // Not Owner
     } else {
         char buffer[MAX_SIZE];
-        snprintf(buffer, MAX_SIZE, "/sys/class/pwm/pwmchip%d/export", dev->chipid);
+        snprintf(buffer, MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/export", maa_sysfs_root(), dev->chipid);
         int export_f = open(buffer, O_WRONLY);
         if (export_f == -1) {
             fprintf(stderr, "Failed to open export for writing!\n");
-            free(dev);
+            maa_pool_free(MAA_POOL_PWM, dev);
             return NULL;
         }
 
@@ -173,10 +190,18 @@ maa_pwm_init_raw(int chipin, int pin)
         if (write(export_f, out, size*sizeof(char)) == -1) {
             fprintf(stderr, "Failed to write to export! Potentially already enabled\n");
             close(export_f);
+            maa_pool_free(MAA_POOL_PWM, dev);
             return NULL;
         }
         dev->owner = 1;
         close(export_f);
+
+        // udev may still be creating or chmod'ing the attributes
+        snprintf(buffer, MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/pwm%d/duty_cycle", maa_sysfs_root(), dev->chipid, dev->pin);
+        if (maa_wait_for_file(buffer, R_OK | W_OK, MAA_SYSFS_READY_TIMEOUT_MS) != MAA_SUCCESS) {
+            maa_pwm_close(dev);
+            return NULL;
+        }
     }
     maa_pwm_setup_duty_fp(dev);
     return dev;
@@ -185,7 +210,10 @@ maa_pwm_init_raw(int chipin, int pin)
 maa_result_t
 maa_pwm_write(maa_pwm_context dev, float percentage)
 {
-    return maa_pwm_write_duty(dev, percentage * maa_pwm_get_period(dev));
+    MAA_STATS_BEGIN(start);
+    maa_result_t ret = maa_pwm_write_duty(dev, percentage * maa_pwm_get_period(dev));
+    MAA_STATS_END(start, MAA_STATS_PWM_WRITE, 0, ret != MAA_SUCCESS);
+    return ret;
 }
 
 float
@@ -241,7 +269,7 @@ maa_pwm_enable(maa_pwm_context dev, int enable)
         status = enable;
     }
     char bu[MAX_SIZE];
-    snprintf(bu,MAX_SIZE, "/sys/class/pwm/pwmchip%d/pwm%d/enable", dev->chipid, dev->pin);
+    snprintf(bu,MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/pwm%d/enable", maa_sysfs_root(), dev->chipid, dev->pin);
 
     int enable_f = open(bu, O_RDWR);
 
@@ -264,7 +292,7 @@ maa_result_t
 maa_pwm_unexport_force(maa_pwm_context dev)
 {
     char filepath[MAX_SIZE];
-    snprintf(filepath, MAX_SIZE, "/sys/class/pwm/pwmchip%d/unexport", dev->chipid);
+    snprintf(filepath, MAX_SIZE, "%s" SYSFS_PWM "/pwmchip%d/unexport", maa_sysfs_root(), dev->chipid);
 
     int unexport_f = open(filepath, O_WRONLY);
     if (unexport_f == -1) {
@@ -298,7 +326,9 @@ maa_result_t
 maa_pwm_close(maa_pwm_context dev)
 {
     maa_pwm_unexport(dev);
-    free(dev);
+    if (dev->phy_pin >= 0)
+        maa_release_pin(dev->phy_pin);
+    maa_pool_free(MAA_POOL_PWM, dev);
     return MAA_SUCCESS;
 }
 
@@ -2,5 +2,12 @@
 
 %feature("autodoc", "3");
 
+%init %{
+    // isr callbacks take the GIL from the isr thread
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads();
+#endif
+%}
+
 %include ../maa.i
 
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief Hand written python fast paths for the hottest gpio calls
+ *
+ * The swig generated Gpio proxy parses a tuple of arguments, converts enums
+ * and dispatches through the shadow class on every call. This module exposes
+ * a small extension type that wraps maa_gpio_context directly, read() is a
+ * METH_NOARGS and write() a METH_O call so no argument tuple is built.
+ */
+
+#include <Python.h>
+
+#include "gpio.h"
+
+typedef struct {
+    PyObject_HEAD
+    maa_gpio_context gpio;
+} FastGpio;
+
+static int
+FastGpio_init(FastGpio* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = {"pin", "owner", "raw", NULL};
+    int pin;
+    int owner = 1;
+    int raw = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|ii", kwlist, &pin, &owner, &raw))
+        return -1;
+
+    // __init__ may be called again on the same object
+    if (self->gpio != NULL) {
+        maa_gpio_close(self->gpio);
+        self->gpio = NULL;
+    }
+    if (raw)
+        self->gpio = maa_gpio_init_raw(pin);
+    else
+        self->gpio = maa_gpio_init(pin);
+    if (self->gpio == NULL) {
+        PyErr_Format(PyExc_ValueError, "Failed to initialise gpio %d", pin);
+        return -1;
+    }
+    if (!owner)
+        maa_gpio_owner(self->gpio, 0);
+    return 0;
+}
+
+static void
+FastGpio_dealloc(FastGpio* self)
+{
+    if (self->gpio != NULL)
+        maa_gpio_close(self->gpio);
+    Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+/*
+ * tp_new leaves gpio NULL and a failed __init__ does too, the C api would
+ * only report that as an error code
+ */
+static int
+FastGpio_check(FastGpio* self)
+{
+    if (self->gpio == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Gpio is not initialised");
+        return 0;
+    }
+    return 1;
+}
+
+static PyObject*
+FastGpio_write(FastGpio* self, PyObject* value)
+{
+    if (!FastGpio_check(self))
+        return NULL;
+    long v = PyLong_AsLong(value);
+    if (v == -1 && PyErr_Occurred())
+        return NULL;
+    return PyLong_FromLong(maa_gpio_write(self->gpio, (int) v));
+}
+
+static PyObject*
+FastGpio_read(FastGpio* self, PyObject* unused)
+{
+    if (!FastGpio_check(self))
+        return NULL;
+    return PyLong_FromLong(maa_gpio_read(self->gpio));
+}
+
+static PyObject*
+FastGpio_dir(FastGpio* self, PyObject* value)
+{
+    if (!FastGpio_check(self))
+        return NULL;
+    long v = PyLong_AsLong(value);
+    if (v == -1 && PyErr_Occurred())
+        return NULL;
+    return PyLong_FromLong(maa_gpio_dir(self->gpio, (gpio_dir_t) v));
+}
+
+static PyObject*
+FastGpio_use_mmaped(FastGpio* self, PyObject* value)
+{
+    if (!FastGpio_check(self))
+        return NULL;
+    int v = PyObject_IsTrue(value);
+    if (v == -1)
+        return NULL;
+    return PyLong_FromLong(maa_gpio_use_mmaped(self->gpio, (maa_boolean_t) v));
+}
+
+static PyMethodDef FastGpio_methods[] = {
+    {"write", (PyCFunction) FastGpio_write, METH_O, "Write value to the Gpio"},
+    {"read", (PyCFunction) FastGpio_read, METH_NOARGS, "Read value from the Gpio"},
+    {"dir", (PyCFunction) FastGpio_dir, METH_O, "Change Gpio direction, 0 out 1 in"},
+    {"useMmaped", (PyCFunction) FastGpio_use_mmaped, METH_O, "Use memory mapped io instead of sysfs"},
+    {NULL}
+};
+
+static PyTypeObject FastGpioType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "pymaa_fast.Gpio",         /* tp_name */
+    sizeof(FastGpio),          /* tp_basicsize */
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef pymaa_fast_module = {
+    PyModuleDef_HEAD_INIT,
+    "pymaa_fast",
+    "Low overhead python fast paths for libmaa gpio",
+    -1,
+    NULL
+};
+#endif
+
+static PyObject*
+pymaa_fast_setup(void)
+{
+    PyObject* m;
+
+    FastGpioType.tp_flags = Py_TPFLAGS_DEFAULT;
+    FastGpioType.tp_doc = "Gpio with low overhead read() and write()";
+    FastGpioType.tp_new = PyType_GenericNew;
+    FastGpioType.tp_init = (initproc) FastGpio_init;
+    FastGpioType.tp_dealloc = (destructor) FastGpio_dealloc;
+    FastGpioType.tp_methods = FastGpio_methods;
+    if (PyType_Ready(&FastGpioType) < 0)
+        return NULL;
+
+#if PY_MAJOR_VERSION >= 3
+    m = PyModule_Create(&pymaa_fast_module);
+#else
+    m = Py_InitModule3("pymaa_fast", NULL, "Low overhead python fast paths for libmaa gpio");
+#endif
+    if (m == NULL)
+        return NULL;
+
+    Py_INCREF(&FastGpioType);
+    PyModule_AddObject(m, "Gpio", (PyObject*) &FastGpioType);
+    PyModule_AddIntConstant(m, "DIR_OUT", MAA_GPIO_OUT);
+    PyModule_AddIntConstant(m, "DIR_IN", MAA_GPIO_IN);
+    return m;
+}
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC
+PyInit_pymaa_fast(void)
+{
+    return pymaa_fast_setup();
+}
+#else
+PyMODINIT_FUNC
+initpymaa_fast(void)
+{
+    pymaa_fast_setup();
+}
+#endif
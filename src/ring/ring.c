@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ring.h"
+#include "maa_internal.h"
+
+#define MAA_RING_MAGIC 0x6d616172
+/* slots start on their own cache line */
+#define MAA_RING_HEADER_SIZE 64
+
+/*
+ * Layout of the shared memory object. Sequence numbers are 32 bit so they
+ * can be read atomically on the 32 bit Quark. A slot holds the sequence
+ * number of its record plus one, or 0 while the producer writes it.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t record_size;
+    uint32_t capacity; /**< power of two */
+    uint32_t stride; /**< bytes between slots */
+    volatile uint32_t head; /**< sequence number of the next record */
+} maa_ring_header_t;
+
+struct _ring {
+    /*@{*/
+    char name[64]; /**< shared memory object name */
+    maa_ring_header_t* hdr; /**< the mapping */
+    size_t size; /**< bytes mapped */
+    maa_boolean_t producer; /**< created the ring */
+    uint32_t cursor; /**< next record this reader wants */
+    uint64_t lost; /**< records this reader missed */
+    /*@}*/
+};
+
+static volatile uint32_t*
+maa_ring_slot(maa_ring_context ring, uint32_t seq)
+{
+    uint8_t* slots = (uint8_t*) ring->hdr + MAA_RING_HEADER_SIZE;
+    return (volatile uint32_t*) (slots + (seq & (ring->hdr->capacity - 1)) * ring->hdr->stride);
+}
+
+maa_ring_context
+maa_ring_create(const char* name, unsigned int record_size, unsigned int capacity)
+{
+    if (name == NULL || strlen(name) >= 64 || record_size == 0 || capacity == 0 ||
+        capacity > 0x10000000)
+        return NULL;
+
+    uint32_t slots = 1;
+    while (slots < capacity)
+        slots <<= 1;
+    uint32_t stride = sizeof(uint32_t) + ((record_size + 7) & ~7u);
+    size_t size = MAA_RING_HEADER_SIZE + (size_t) slots * stride;
+
+    maa_ring_context ring = calloc(1, sizeof(struct _ring));
+    if (ring == NULL)
+        return NULL;
+
+    // a ring of the same name may still have a producer, leave it alone
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        int err = errno;
+        fprintf(stderr, "ring: Failed to create %s: %s\n", name, strerror(err));
+        free(ring);
+        errno = err;
+        return NULL;
+    }
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        shm_unlink(name);
+        free(ring);
+        return NULL;
+    }
+    void* hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        shm_unlink(name);
+        free(ring);
+        return NULL;
+    }
+
+    strcpy(ring->name, name);
+    ring->hdr = (maa_ring_header_t*) hdr;
+    ring->size = size;
+    ring->producer = 1;
+    ring->hdr->record_size = record_size;
+    ring->hdr->capacity = slots;
+    ring->hdr->stride = stride;
+    ring->hdr->head = 0;
+    __sync_synchronize();
+    ring->hdr->magic = MAA_RING_MAGIC;
+    return ring;
+}
+
+maa_ring_context
+maa_ring_attach(const char* name)
+{
+    if (name == NULL || strlen(name) >= 64)
+        return NULL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size < MAA_RING_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    void* hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED)
+        return NULL;
+
+    // the slot arithmetic relies on all of this, the object may not be ours
+    maa_ring_header_t* header = (maa_ring_header_t*) hdr;
+    uint32_t capacity = header->capacity;
+    uint32_t stride = header->stride;
+    if (header->magic != MAA_RING_MAGIC || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        header->record_size == 0 || (uint64_t) header->record_size + sizeof(uint32_t) > stride ||
+        stride % sizeof(uint32_t) != 0 ||
+        MAA_RING_HEADER_SIZE + (uint64_t) capacity * stride > (uint64_t) st.st_size) {
+        fprintf(stderr, "ring: %s is not a ring\n", name);
+        munmap(hdr, st.st_size);
+        return NULL;
+    }
+
+    maa_ring_context ring = calloc(1, sizeof(struct _ring));
+    if (ring == NULL) {
+        munmap(hdr, st.st_size);
+        return NULL;
+    }
+    strcpy(ring->name, name);
+    ring->hdr = header;
+    ring->size = st.st_size;
+    uint32_t head = header->head;
+    ring->cursor = head < header->capacity ? 0 : head - header->capacity;
+    return ring;
+}
+
+maa_result_t
+maa_ring_publish(maa_ring_context ring, const void* record)
+{
+    if (ring == NULL || !ring->producer)
+        return MAA_ERROR_INVALID_HANDLE;
+
+    uint32_t seq = ring->hdr->head;
+    volatile uint32_t* slot = maa_ring_slot(ring, seq);
+    *slot = 0;
+    __sync_synchronize();
+    memcpy((void*) (slot + 1), record, ring->hdr->record_size);
+    __sync_synchronize();
+    *slot = seq + 1;
+    __sync_synchronize();
+    ring->hdr->head = seq + 1;
+    return MAA_SUCCESS;
+}
+
+int
+maa_ring_read(maa_ring_context ring, void* records, int max, uint32_t* seq)
+{
+    if (ring == NULL || records == NULL || max < 0)
+        return -1;
+
+    maa_ring_header_t* hdr = ring->hdr;
+    uint32_t head = hdr->head;
+    __sync_synchronize();
+    if (head - ring->cursor > hdr->capacity) {
+        ring->lost += head - ring->cursor - hdr->capacity;
+        ring->cursor = head - hdr->capacity;
+    }
+
+    uint8_t* out = (uint8_t*) records;
+    int n = 0;
+    while (n < max && ring->cursor != head) {
+        volatile uint32_t* slot = maa_ring_slot(ring, ring->cursor);
+        uint32_t before = *slot;
+        __sync_synchronize();
+        memcpy(out + (size_t) n * hdr->record_size, (const void*) (slot + 1), hdr->record_size);
+        __sync_synchronize();
+        if (before != ring->cursor + 1 || *slot != before) {
+            // overwritten while we looked, keep what we have consecutive
+            if (n > 0)
+                break;
+            ring->lost++;
+            ring->cursor++;
+            continue;
+        }
+        if (n == 0 && seq != NULL)
+            *seq = ring->cursor;
+        ring->cursor++;
+        n++;
+    }
+    return n;
+}
+
+uint64_t
+maa_ring_lost(maa_ring_context ring)
+{
+    if (ring == NULL)
+        return 0;
+    return ring->lost;
+}
+
+unsigned int
+maa_ring_record_size(maa_ring_context ring)
+{
+    if (ring == NULL)
+        return 0;
+    return ring->hdr->record_size;
+}
+
+void
+maa_ring_gpio_event(const maa_gpio_event_t* event, void* ring)
+{
+    maa_ring_context dest = (maa_ring_context) ring;
+    if (dest != NULL && dest->hdr->record_size == sizeof(maa_gpio_event_t))
+        maa_ring_publish(dest, event);
+}
+
+maa_result_t
+maa_ring_close(maa_ring_context ring)
+{
+    if (ring == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    if (ring->producer)
+        shm_unlink(ring->name);
+    munmap(ring->hdr, ring->size);
+    free(ring);
+    return MAA_SUCCESS;
+}
@@ -32,8 +32,10 @@
 
 #include "spi.h"
 #include "maa_internal.h"
+#include "maa_pool.h"
+#include "maa_shm.h"
 
-#define MAX_SIZE 64
+#define MAX_SIZE 128
 #define SPI_MAX_LENGTH 4096
 
 /**
@@ -46,27 +48,37 @@ struct _spi {
     int clock; /**< clock to run transactions at */
     maa_boolean_t lsb; /**< least significant bit mode */
     unsigned int bpw; /**< Bits per word */
+    int bus; /**< board bus it was set up for */
+    unsigned int bus_id; /**< number of the /dev/spidev* bus */
     /*@}*/
 };
 
+const size_t maa_spi_context_size = sizeof(struct _spi);
+
 maa_spi_context
 maa_spi_init(int bus)
 {
     maa_spi_bus_t *spi = maa_setup_spi(bus);
-    if(bus < 0) {
+    if (spi == NULL) {
         fprintf(stderr, "Failed. SPI platform Error\n");
         return NULL;
     }
-    maa_spi_context dev = (maa_spi_context) malloc(sizeof(struct _spi));
-    memset(dev, 0, sizeof(struct _spi));
+    maa_spi_context dev = (maa_spi_context) maa_pool_alloc(MAA_POOL_SPI);
+    if (dev == NULL) {
+        maa_release_spi(bus);
+        return NULL;
+    }
+    dev->bus = bus;
+    dev->bus_id = spi->bus_id;
 
     char path[MAX_SIZE];
-    sprintf(path, "/dev/spidev%u.%u", spi->bus_id, spi->slave_s);
+    snprintf(path, MAX_SIZE, "%s/dev/spidev%u.%u", maa_sysfs_root(), spi->bus_id, spi->slave_s);
 
     dev->devfd = open(path, O_RDWR);
     if (dev->devfd < 0) {
         fprintf(stderr, "Failed opening SPI Device. bus:%s\n", path);
-        free(dev);
+        maa_release_spi(bus);
+        maa_pool_free(MAA_POOL_SPI, dev);
         return NULL;
     }
     dev->bpw = 8;
@@ -128,8 +140,14 @@ maa_spi_write(maa_spi_context dev, uint8_t data)
     msg.bits_per_word = dev->bpw;
     msg.delay_usecs = 0;
     msg.len = length;
-    if (ioctl(dev->devfd, SPI_IOC_MESSAGE(1), &msg) < 0) {
-        fprintf(stderr, "Failed to perform dev transfer\n");
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_SPI, dev->bus_id);
+    int failed = ioctl(dev->devfd, SPI_IOC_MESSAGE(1), &msg) < 0;
+    maa_shm_transfer_unlock(bus);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_SPI_TRANSFER, 1, failed);
+    if (failed) {
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to transfer on spi");
         return -1;
     }
     return recv;
@@ -137,28 +155,65 @@ maa_spi_write(maa_spi_context dev, uint8_t data)
 
 uint8_t*
 maa_spi_write_buf(maa_spi_context dev, uint8_t* data, int length)
+{
+    uint8_t* recv = malloc(sizeof(uint8_t) * length);
+    if (recv == NULL)
+        return NULL;
+
+    if (maa_spi_transfer_buf(dev, data, recv, length) != MAA_SUCCESS) {
+        free(recv);
+        return NULL;
+    }
+    return recv;
+}
+
+maa_result_t
+maa_spi_transfer_buf(maa_spi_context dev, const uint8_t* data, uint8_t* rxbuf, int length)
 {
     struct spi_ioc_transfer msg;
     memset(&msg, 0, sizeof(msg));
 
-    uint8_t* recv = malloc(sizeof(uint8_t) * length);
-
     msg.tx_buf = (unsigned long) data;
-    msg.rx_buf = (unsigned long) recv;
+    msg.rx_buf = (unsigned long) rxbuf;
     msg.speed_hz = dev->clock;
     msg.bits_per_word = dev->bpw;
     msg.delay_usecs = 0;
     msg.len = length;
-    if (ioctl(dev->devfd, SPI_IOC_MESSAGE(1), &msg) < 0) {
-        fprintf(stderr, "Failed to perform dev transfer\n");
-        return NULL;
+    MAA_STATS_BEGIN(start);
+    pthread_mutex_t* bus = maa_shm_transfer_lock(MAA_SHM_BUS_SPI, dev->bus_id);
+    int failed = ioctl(dev->devfd, SPI_IOC_MESSAGE(1), &msg) < 0;
+    maa_shm_transfer_unlock(bus);
+    MAA_STATS_SYSCALL(1);
+    MAA_STATS_END(start, MAA_STATS_SPI_TRANSFER, length, failed);
+    if (failed) {
+        return MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "Failed to transfer on spi");
     }
-    return recv;
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_spi_lock(maa_spi_context dev)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    maa_shm_bus_lock(MAA_SHM_BUS_SPI, dev->bus_id);
+    return MAA_SUCCESS;
+}
+
+maa_result_t
+maa_spi_unlock(maa_spi_context dev)
+{
+    if (dev == NULL)
+        return MAA_ERROR_INVALID_HANDLE;
+    maa_shm_bus_unlock(MAA_SHM_BUS_SPI, dev->bus_id);
+    return MAA_SUCCESS;
 }
 
 maa_result_t
 maa_spi_stop(maa_spi_context dev)
 {
     close(dev->devfd);
+    maa_release_spi(dev->bus);
+    maa_pool_free(MAA_POOL_SPI, dev);
     return MAA_SUCCESS;
 }
@@ -1,6 +1,108 @@
 #include <maa.h>
+#include "maa/fast_gpio.hpp"
+#include "maa/gpio_fast.h"
+#include "maa/gpio.hpp"
+#include "maa/spi.hpp"
+#include "maa/program.hpp"
+#include "maa/span.hpp"
 #include "gtest/gtest.h"
 #include "version.h"
+#include <type_traits>
+#include <string>
+#include <vector>
+extern "C" {
+#include "intel_galileo_rev_d.h"
+#include "maa_internal.h"
+#include "maa_shm.h"
+#include "maad_protocol.h"
+}
+#include "sim_root.hpp"
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+/**
+ * Point libmaa at a fresh simulated sysfs tree for the lifetime of the object
+ */
+struct SimRoot {
+    std::string root;
+    std::string prev;
+
+    SimRoot() : root(maa_bench::createSimRoot()), prev(maa_sysfs_root())
+    {
+        maa_set_sysfs_root(root.c_str());
+    }
+
+    ~SimRoot()
+    {
+        maa_set_sysfs_root(prev.c_str());
+        maa_bench::removeSimRoot(root);
+    }
+
+    std::string gpio(int pin, const char* attr) const
+    {
+        return root + "/sys/class/gpio/gpio" + std::to_string(pin) + "/" + attr;
+    }
+};
+
+static void
+writeFile(const std::string& path, const char* content)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+    if (fd >= 0) {
+        ssize_t n = write(fd, content, strlen(content));
+        (void) n;
+        close(fd);
+    }
+}
+
+static std::string
+readFile(const std::string& path)
+{
+    char buf[64] = {};
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return "";
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    return n > 0 ? std::string(buf, n) : "";
+}
+
+/**
+ * Replace the value file of a gpio in the simulated tree with a FIFO, the
+ * returned descriptor writes one level per edge
+ */
+static int
+edgeFifo(const SimRoot& sim, int pin)
+{
+    std::string value = sim.gpio(pin, "value");
+    unlink(value.c_str());
+    if (mkfifo(value.c_str(), 0644) != 0)
+        return -1;
+    return open(value.c_str(), O_RDWR | O_NONBLOCK);
+}
+
+/**
+ * Wait for whoever reads the FIFO behind fd to drain it
+ */
+static bool
+fifoDrained(int fd)
+{
+    int pending = 1;
+    for (int i = 0; i < 1000 && pending > 0; i++) {
+        if (ioctl(fd, FIONREAD, &pending) != 0)
+            return false;
+        if (pending > 0)
+            usleep(1000);
+    }
+    // the level is stored right after the read
+    usleep(1000);
+    return pending == 0;
+}
 
 /* Careful, this test will only attempt to check the returned version is valid,
  * it doesn't try to check the version is a release one.
@@ -10,3 +112,1114 @@ TEST (basic, maa_get_version) {
     strcpy(bar, maa_get_version());
     ASSERT_STREQ(maa_get_version(), gVERSION);
 }
+
+TEST (program, loop_and_branch) {
+    maa_program_context prog = maa_program_init();
+    ASSERT_TRUE(prog != NULL);
+    ASSERT_EQ(maa_program_size(prog), 0);
+    ASSERT_EQ(maa_program_wait_us(prog, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_program_loop(prog, 0, 3), MAA_SUCCESS);
+    // nothing has been read so the last value is 0 and the branch is taken
+    ASSERT_EQ(maa_program_branch(prog, 3, 0), MAA_SUCCESS);
+    ASSERT_EQ(maa_program_size(prog), 3);
+    ASSERT_EQ(maa_program_run(prog, 0), MAA_SUCCESS);
+
+    int length = -1;
+    maa_program_results(prog, &length);
+    ASSERT_EQ(length, 0);
+    maa_program_close(prog);
+}
+
+TEST (program, invalid_operations) {
+    maa_program_context prog = maa_program_init();
+    ASSERT_EQ(maa_program_gpio_write(prog, 0, 1), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_program_i2c_read(prog, 0, 1), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_program_loop(prog, 0, 1), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_program_add_gpio(prog, NULL), -1);
+    ASSERT_EQ(maa_program_branch(prog, 10, 0), MAA_SUCCESS);
+    ASSERT_EQ(maa_program_run(prog, 0), MAA_ERROR_INVALID_PARAMETER);
+    maa_program_close(prog);
+}
+
+TEST (program, results_sized_when_built) {
+    ASSERT_FALSE(std::is_copy_constructible<maa::Program>::value);
+    ASSERT_TRUE(std::is_nothrow_move_assignable<maa::Program>::value);
+
+    maa_program_context prog = maa_program_init();
+    // never run, the slot only has to be registered
+    int slot = maa_program_add_i2c(prog, (maa_i2c_context) prog);
+    ASSERT_EQ(maa_program_i2c_read(prog, slot, 1024), MAA_SUCCESS);
+    ASSERT_EQ(maa_program_loop(prog, 0, 4), MAA_SUCCESS);
+    ASSERT_EQ(maa_program_loop(prog, 0, 1 << 20), MAA_ERROR_NO_RESOURCES);
+    ASSERT_EQ(maa_program_size(prog), 2);
+    maa_program_close(prog);
+}
+
+template <int Pin>
+static void
+check_fast_gpio_table(maa_board_t* b)
+{
+    typedef maa::board::GalileoGen1::pin<Pin> info;
+    maa_mmap_pin_t* mmp = &b->pins[Pin].mmap;
+    ASSERT_EQ(b->pins[Pin].capabilites.fast_gpio, 1);
+    ASSERT_EQ((unsigned int) info::pinmap, mmp->gpio.pinmap);
+    ASSERT_EQ((unsigned int) info::bit_pos, mmp->bit_pos);
+    ASSERT_EQ((unsigned int) maa::board::GalileoGen1::mem_sz, mmp->mem_sz);
+    ASSERT_STREQ(maa::board::GalileoGen1::memDev(), mmp->mem_dev);
+    ASSERT_EQ((unsigned int) info::mux::total, mmp->gpio.mux_total);
+}
+
+/* The compile time FastGpio tables duplicate the runtime board definition */
+TEST (fast_gpio, galileo_gen1_table) {
+    maa_board_t* b = maa_intel_galileo_rev_d();
+    check_fast_gpio_table<2>(b);
+    check_fast_gpio_table<3>(b);
+    static_assert(maa::FastGpio<maa::board::GalileoGen1, 3>::mask == (1u << 7), "IO3 is bit 7");
+    free(b->pins);
+    free(b);
+}
+
+TEST (cxx, span_views) {
+    uint8_t arr[4] = { 1, 2, 3, 4 };
+    maa::Span<uint8_t> a(arr);
+    ASSERT_EQ(a.size(), 4u);
+    ASSERT_EQ(a.data(), arr);
+
+    const std::vector<uint8_t> vec(3, 7);
+    maa::Span<const uint8_t> v(vec);
+    ASSERT_EQ(v.size(), 3u);
+    ASSERT_EQ(v.data(), &vec[0]);
+
+    maa::Span<uint8_t> p(arr + 1, 2);
+    ASSERT_EQ(p.data()[0], 2);
+}
+
+TEST (cxx, move_only_handles) {
+    ASSERT_FALSE(std::is_copy_constructible<maa::Gpio>::value);
+    ASSERT_FALSE(std::is_copy_assignable<maa::Spi>::value);
+    ASSERT_TRUE(std::is_nothrow_move_constructible<maa::Gpio>::value);
+    ASSERT_TRUE(std::is_nothrow_move_assignable<maa::Spi>::value);
+
+    // no gpio exists here, the handle and anything moved from it is empty
+    maa::Gpio a(-1);
+    maa::Gpio b(std::move(a));
+    a = std::move(b);
+}
+
+TEST (gpio_fast, inline_helpers) {
+    maa_gpio_fast_t fast;
+    ASSERT_EQ(maa_gpio_get_fast(NULL, &fast), MAA_ERROR_INVALID_RESOURCE);
+
+    // point the handle at plain memory standing in for the data register
+    volatile uint32_t reg = 0x1;
+    fast.reg = &reg;
+    fast.mask = 1 << 6;
+    maa_gpio_fast_set(&fast);
+    ASSERT_EQ(reg, 0x41u);
+    ASSERT_EQ(maa_gpio_fast_read(&fast), 1);
+    maa_gpio_fast_toggle(&fast);
+    ASSERT_EQ(reg, 0x1u);
+    maa_gpio_fast_toggle(&fast);
+    maa_gpio_fast_clear(&fast);
+    ASSERT_EQ(maa_gpio_fast_read(&fast), 0);
+    ASSERT_EQ(reg, 0x1u);
+}
+
+TEST (gpio_fast, atomic_update) {
+    volatile uint32_t reg = 0xf0;
+    maa_gpio_fast_update(&reg, 0x3, 0x30);
+    ASSERT_EQ(reg, 0xc3u);
+
+    // two threads each hammering their own bit must not lose writes
+    struct hammer {
+        static void* run(void* arg) {
+            maa_gpio_fast_t* fast = (maa_gpio_fast_t*) arg;
+            for (int i = 0; i < 100001; i++)
+                maa_gpio_fast_toggle(fast);
+            return NULL;
+        }
+    };
+    reg = 0;
+    maa_gpio_fast_t a = { &reg, 1u << 6 };
+    maa_gpio_fast_t b = { &reg, 1u << 7 };
+    pthread_t ta, tb;
+    pthread_create(&ta, NULL, hammer::run, &a);
+    pthread_create(&tb, NULL, hammer::run, &b);
+    pthread_join(ta, NULL);
+    pthread_join(tb, NULL);
+    ASSERT_EQ(reg, 0xc0u);
+}
+
+TEST (gpio, invalid_context) {
+    ASSERT_EQ(maa_gpio_shadow(NULL, 1), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_gpio_input_cache(NULL, 1), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_gpio_isr_mode(NULL, MAA_GPIO_ISR_UIO), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_gpio_busy_poll_config(NULL, -1, 0), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_gpio_isr_multi_exit(NULL), MAA_ERROR_INVALID_RESOURCE);
+
+    maa_gpio_context devs[2] = { NULL, NULL };
+    ASSERT_TRUE(maa_gpio_isr_multi(devs, 2, MAA_GPIO_EDGE_BOTH, NULL, NULL) == NULL);
+}
+
+TEST (gpio, mmap_enable_disable) {
+    SimRoot sim;
+    ASSERT_FALSE(sim.root.empty());
+    maa_gpio_context dev = maa_gpio_init(2);
+    ASSERT_TRUE(dev != NULL);
+    ASSERT_EQ(maa_gpio_use_mmaped(dev, 0), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_gpio_use_mmaped(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_use_mmaped(dev, 1), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_gpio_use_mmaped(dev, 0), MAA_SUCCESS);
+
+    // back on sysfs once the mapping is gone
+    ASSERT_EQ(maa_gpio_dir(dev, MAA_GPIO_OUT), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_write(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(32, "value")), "1\n");
+    ASSERT_EQ(maa_gpio_close(dev), MAA_SUCCESS);
+}
+
+TEST (gpio, shadowed_writes) {
+    SimRoot sim;
+    maa_gpio_context dev = maa_gpio_init_raw(40);
+    ASSERT_TRUE(dev != NULL);
+    ASSERT_EQ(maa_gpio_dir(dev, MAA_GPIO_OUT), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_shadow(dev, 1), MAA_SUCCESS);
+
+    ASSERT_EQ(maa_gpio_write(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(40, "value")), "1\n");
+
+    // a write of the level already set never reaches sysfs
+    writeFile(sim.gpio(40, "value"), "0\n");
+    ASSERT_EQ(maa_gpio_write(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(40, "value")), "0\n");
+    ASSERT_EQ(maa_gpio_read(dev), 1);
+
+    ASSERT_EQ(maa_gpio_write(dev, 0), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(40, "value")), "0\n");
+    ASSERT_EQ(maa_gpio_read(dev), 0);
+
+    // without the shadow every write and read goes through
+    ASSERT_EQ(maa_gpio_shadow(dev, 0), MAA_SUCCESS);
+    writeFile(sim.gpio(40, "value"), "1\n");
+    ASSERT_EQ(maa_gpio_read(dev), 1);
+    ASSERT_EQ(maa_gpio_write(dev, 0), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(40, "value")), "0\n");
+    ASSERT_EQ(maa_gpio_close(dev), MAA_SUCCESS);
+}
+
+TEST (gpio, input_cache_follows_edges) {
+    SimRoot sim;
+    int edges = edgeFifo(sim, 41);
+    ASSERT_GE(edges, 0);
+    maa_gpio_context dev = maa_gpio_init_raw(41);
+    ASSERT_TRUE(dev != NULL);
+    ASSERT_EQ(maa_gpio_input_cache(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(41, "edge")), "both\n");
+
+    ASSERT_EQ(write(edges, "1", 1), 1);
+    ASSERT_TRUE(fifoDrained(edges));
+    ASSERT_EQ(maa_gpio_read(dev), 1);
+    ASSERT_EQ(write(edges, "0", 1), 1);
+    ASSERT_TRUE(fifoDrained(edges));
+    ASSERT_EQ(maa_gpio_read(dev), 0);
+
+    // stopping the cache also stops the edge watcher
+    ASSERT_EQ(maa_gpio_input_cache(dev, 0), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(41, "edge")), "none\n");
+    ASSERT_EQ(write(edges, "1", 1), 1);
+    usleep(10000);
+    int pending = 0;
+    ASSERT_EQ(ioctl(edges, FIONREAD, &pending), 0);
+    ASSERT_EQ(pending, 1);
+    close(edges);
+    ASSERT_EQ(maa_gpio_close(dev), MAA_SUCCESS);
+}
+
+/**
+ * Interrupt of a simulated register page, the isr acknowledges it in
+ * INTSTATUS itself as nothing else clears the bit
+ */
+struct SimIrq {
+    volatile uint32_t* regs;
+    uint32_t mask;
+    maa_gpio_context dev;
+    bool exit_self;
+    volatile int count;
+};
+
+static void
+simIrqIsr(void* arg)
+{
+    SimIrq* irq = (SimIrq*) arg;
+    __sync_fetch_and_and(&irq->regs[0x40 / 4], ~irq->mask);
+    __sync_fetch_and_add(&irq->count, 1);
+    if (irq->exit_self)
+        maa_gpio_isr_exit(irq->dev);
+}
+
+static bool
+waitCount(volatile int* count, int value)
+{
+    for (int i = 0; i < 1000 && *count < value; i++)
+        usleep(1000);
+    return *count >= value;
+}
+
+TEST (gpio, uio_dispatch_to_several_pins) {
+    SimRoot sim;
+    // reads of /dev/zero return at once, so the dispatcher keeps looking at
+    // INTSTATUS and every bit set there is delivered
+    std::string uio = sim.root + "/dev/uio0";
+    unlink(uio.c_str());
+    ASSERT_EQ(symlink("/dev/zero", uio.c_str()), 0);
+
+    SimIrq irq[2] = {};
+    maa_gpio_context devs[2];
+    for (int i = 0; i < 2; i++) {
+        devs[i] = maa_gpio_init(2 + i);
+        ASSERT_TRUE(devs[i] != NULL);
+        ASSERT_EQ(maa_gpio_use_mmaped(devs[i], 1), MAA_SUCCESS);
+        ASSERT_EQ(maa_gpio_isr_mode(devs[i], MAA_GPIO_ISR_UIO), MAA_SUCCESS);
+        maa_gpio_fast_t fast;
+        ASSERT_EQ(maa_gpio_get_fast(devs[i], &fast), MAA_SUCCESS);
+        irq[i].regs = fast.reg;
+        irq[i].mask = fast.mask;
+        irq[i].dev = devs[i];
+    }
+    // IO3 leaves from inside its own isr
+    irq[1].exit_self = true;
+    ASSERT_EQ(maa_gpio_isr(devs[0], MAA_GPIO_EDGE_RISING, simIrqIsr, &irq[0]), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_isr(devs[1], MAA_GPIO_EDGE_BOTH, simIrqIsr, &irq[1]), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_isr(devs[1], MAA_GPIO_EDGE_BOTH, simIrqIsr, &irq[1]), MAA_ERROR_NO_RESOURCES);
+
+    volatile uint32_t* regs = irq[0].regs;
+    ASSERT_TRUE(regs[0x30 / 4] & irq[0].mask);
+    ASSERT_TRUE(regs[0x30 / 4] & irq[1].mask);
+
+    __sync_fetch_and_or(&regs[0x40 / 4], irq[0].mask | irq[1].mask);
+    ASSERT_TRUE(waitCount(&irq[0].count, 1));
+    ASSERT_TRUE(waitCount(&irq[1].count, 1));
+    ASSERT_FALSE(regs[0x30 / 4] & irq[1].mask);
+
+    // IO3 is gone, IO2 keeps firing
+    __sync_fetch_and_or(&regs[0x40 / 4], irq[0].mask | irq[1].mask);
+    ASSERT_TRUE(waitCount(&irq[0].count, 2));
+    usleep(10000);
+    ASSERT_EQ(irq[1].count, 1);
+
+    ASSERT_EQ(maa_gpio_isr_exit(devs[0]), MAA_SUCCESS);
+    ASSERT_FALSE(regs[0x30 / 4] & irq[0].mask);
+    for (int i = 0; i < 2; i++)
+        ASSERT_EQ(maa_gpio_close(devs[i]), MAA_SUCCESS);
+}
+
+static void
+closeFromIsr(void* arg)
+{
+    SimIrq* irq = (SimIrq*) arg;
+    __sync_fetch_and_add(&irq->count, 1);
+    maa_gpio_close(irq->dev);
+}
+
+TEST (gpio, busy_poll_start_stop) {
+    SimRoot sim;
+    int edges = edgeFifo(sim, 32);
+    ASSERT_GE(edges, 0);
+    maa_gpio_context dev = maa_gpio_init(2);
+    ASSERT_TRUE(dev != NULL);
+    ASSERT_EQ(maa_gpio_isr_mode(dev, MAA_GPIO_ISR_BUSY_POLL), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_isr(dev, MAA_GPIO_EDGE_RISING, simIrqIsr, NULL), MAA_ERROR_FEATURE_NOT_SUPPORTED);
+    ASSERT_EQ(maa_gpio_use_mmaped(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_busy_poll_config(dev, -1, 16), MAA_SUCCESS);
+
+    SimIrq irq = {};
+    maa_gpio_fast_t fast;
+    ASSERT_EQ(maa_gpio_get_fast(dev, &fast), MAA_SUCCESS);
+    volatile uint32_t* porta = fast.reg + 0x50 / 4;
+    irq.regs = fast.reg;
+    irq.dev = dev;
+    ASSERT_EQ(maa_gpio_isr(dev, MAA_GPIO_EDGE_RISING, simIrqIsr, &irq), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_busy_poll_config(dev, -1, 0), MAA_ERROR_NO_RESOURCES);
+
+    __sync_fetch_and_or(porta, fast.mask);
+    ASSERT_TRUE(waitCount(&irq.count, 1));
+    __sync_fetch_and_and(porta, ~fast.mask);
+    usleep(10000);
+    ASSERT_EQ(irq.count, 1);
+    __sync_fetch_and_or(porta, fast.mask);
+    ASSERT_TRUE(waitCount(&irq.count, 2));
+    ASSERT_EQ(maa_gpio_isr_exit(dev), MAA_SUCCESS);
+    __sync_fetch_and_and(porta, ~fast.mask);
+    usleep(10000);
+    ASSERT_EQ(irq.count, 2);
+
+    // the input cache uses the edge watcher even in busy poll mode and
+    // must be stopped as such
+    ASSERT_EQ(maa_gpio_input_cache(dev, 1), MAA_SUCCESS);
+    ASSERT_EQ(write(edges, "1", 1), 1);
+    ASSERT_TRUE(fifoDrained(edges));
+    ASSERT_EQ(maa_gpio_read(dev), 1);
+    ASSERT_EQ(maa_gpio_input_cache(dev, 0), MAA_SUCCESS);
+
+    // an isr may close its own context
+    irq.count = 0;
+    ASSERT_EQ(maa_gpio_isr(dev, MAA_GPIO_EDGE_BOTH, closeFromIsr, &irq), MAA_SUCCESS);
+    __sync_fetch_and_or(porta, fast.mask);
+    ASSERT_TRUE(waitCount(&irq.count, 1));
+    usleep(10000);
+    ASSERT_EQ(irq.count, 1);
+    close(edges);
+}
+
+struct SimGroup {
+    maa_gpio_multi_context multi;
+    bool exit_self;
+    volatile int count;
+    unsigned int index[4];
+    gpio_edge_t edge[4];
+};
+
+static void
+simGroupIsr(const maa_gpio_event_t* event, void* user)
+{
+    SimGroup* group = (SimGroup*) user;
+    int n = group->count;
+    if (n < 4) {
+        group->index[n] = event->index;
+        group->edge[n] = event->edge;
+    }
+    __sync_fetch_and_add(&group->count, 1);
+    if (group->exit_self)
+        maa_gpio_isr_multi_exit(group->multi);
+}
+
+TEST (gpio, multi_pin_group) {
+    SimRoot sim;
+    int edges[2];
+    maa_gpio_context devs[2];
+    for (int i = 0; i < 2; i++) {
+        edges[i] = edgeFifo(sim, 42 + i);
+        ASSERT_GE(edges[i], 0);
+        devs[i] = maa_gpio_init_raw(42 + i);
+        ASSERT_TRUE(devs[i] != NULL);
+    }
+
+    SimGroup group = {};
+    group.multi = maa_gpio_isr_multi(devs, 2, MAA_GPIO_EDGE_BOTH, simGroupIsr, &group);
+    ASSERT_TRUE(group.multi != NULL);
+    ASSERT_TRUE(maa_gpio_isr_multi(devs, 2, MAA_GPIO_EDGE_BOTH, simGroupIsr, &group) == NULL);
+    ASSERT_EQ(maa_gpio_input_cache(devs[0], 1), MAA_ERROR_NO_RESOURCES);
+    ASSERT_EQ(readFile(sim.gpio(43, "edge")), "both\n");
+
+    ASSERT_EQ(write(edges[1], "1", 1), 1);
+    ASSERT_TRUE(waitCount(&group.count, 1));
+    ASSERT_EQ(write(edges[0], "0", 1), 1);
+    ASSERT_TRUE(waitCount(&group.count, 2));
+    ASSERT_EQ(group.index[0], 1u);
+    ASSERT_EQ(group.edge[0], MAA_GPIO_EDGE_RISING);
+    ASSERT_EQ(group.index[1], 0u);
+    ASSERT_EQ(group.edge[1], MAA_GPIO_EDGE_FALLING);
+
+    ASSERT_EQ(maa_gpio_isr_multi_exit(group.multi), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(42, "edge")), "none\n");
+    ASSERT_EQ(readFile(sim.gpio(43, "edge")), "none\n");
+
+    // a group leaving from its own callback is freed by its thread
+    group = {};
+    group.exit_self = true;
+    group.multi = maa_gpio_isr_multi(devs, 2, MAA_GPIO_EDGE_RISING, simGroupIsr, &group);
+    ASSERT_TRUE(group.multi != NULL);
+    ASSERT_EQ(write(edges[0], "1", 1), 1);
+    ASSERT_TRUE(waitCount(&group.count, 1));
+    bool released = false;
+    for (int i = 0; i < 1000 && !released; i++) {
+        // sysfs replaces the attribute, the simulated file is overwritten
+        released = readFile(sim.gpio(43, "edge")).compare(0, 4, "none") == 0;
+        usleep(1000);
+    }
+    ASSERT_TRUE(released);
+    ASSERT_EQ(write(edges[1], "1", 1), 1);
+    usleep(10000);
+    ASSERT_EQ(group.count, 1);
+
+    // the pins are free for another isr again
+    ASSERT_EQ(maa_gpio_input_cache(devs[0], 1), MAA_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(maa_gpio_close(devs[i]), MAA_SUCCESS);
+        close(edges[i]);
+    }
+}
+
+TEST (gpio, mux_cache_and_shared_pins) {
+    SimRoot sim;
+    maa_gpio_context a = maa_gpio_init(2);
+    ASSERT_TRUE(a != NULL);
+    ASSERT_EQ(readFile(sim.gpio(31, "value")), "1\n");
+
+    // a second context on the pin skips the mux write, and closing the
+    // first one leaves the pin exported for it
+    writeFile(sim.gpio(31, "value"), "0\n");
+    maa_gpio_context b = maa_gpio_init(2);
+    ASSERT_TRUE(b != NULL);
+    ASSERT_EQ(readFile(sim.gpio(31, "value")), "0\n");
+    ASSERT_EQ(maa_gpio_owner(a, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_owner(b, 1), MAA_SUCCESS);
+    std::string unexport = sim.root + "/sys/class/gpio/unexport";
+    ASSERT_EQ(maa_gpio_close(a), MAA_SUCCESS);
+    ASSERT_EQ(readFile(unexport), "");
+    ASSERT_EQ(maa_gpio_close(b), MAA_SUCCESS);
+    ASSERT_EQ(readFile(unexport), "32");
+
+    // writing the mux line directly invalidates the cached value
+    maa_gpio_context line = maa_gpio_init_raw(31);
+    ASSERT_TRUE(line != NULL);
+    ASSERT_EQ(maa_gpio_dir(line, MAA_GPIO_OUT), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_write(line, 0), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_close(line), MAA_SUCCESS);
+    a = maa_gpio_init(2);
+    ASSERT_TRUE(a != NULL);
+    ASSERT_EQ(readFile(sim.gpio(31, "value")), "1\n");
+
+    // so does the fast path of IO2, gpio 14 is also one of its mux lines
+    ASSERT_EQ(maa_gpio_use_mmaped(a, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(14, "value")), "0\n");
+    writeFile(sim.gpio(14, "value"), "1\n");
+    ASSERT_EQ(maa_gpio_write(a, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_use_mmaped(a, 0), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_use_mmaped(a, 1), MAA_SUCCESS);
+    ASSERT_EQ(readFile(sim.gpio(14, "value")), "0\n");
+    ASSERT_EQ(maa_gpio_close(a), MAA_SUCCESS);
+}
+
+TEST (sysfs, wait_for_file) {
+    ASSERT_EQ(maa_wait_for_file("/", R_OK, 0), MAA_SUCCESS);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT_EQ(maa_wait_for_file("/nonexistent/maa", R_OK, 20), MAA_ERROR_NO_RESOURCES);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long waited_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    ASSERT_GE(waited_ms, 20);
+}
+
+TEST (client, batches_calls) {
+    ASSERT_TRUE(maa_client_connect("/nonexistent/maad.sock") == NULL);
+
+    char path[] = "/tmp/maad-test.sock";
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ASSERT_EQ(bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(listen_fd, 1), 0);
+
+    // answers each message with the op of every request as its result
+    std::vector<uint32_t> counts;
+    std::thread daemon([&]() {
+        int fd = accept(listen_fd, NULL, NULL);
+        static maad_req_msg_t req;
+        static maad_resp_msg_t resp;
+        while (recv(fd, &req, sizeof(req), 0) > 0) {
+            counts.push_back(req.count);
+            resp.count = req.count;
+            for (uint32_t i = 0; i < req.count; i++)
+                resp.resp[i].result = req.req[i].op == MAAD_GPIO_WRITE ? -MAA_ERROR_INVALID_PARAMETER
+                                                                     : req.req[i].op;
+            send(fd, &resp, sizeof(resp), 0);
+        }
+        close(fd);
+    });
+
+    maa_client_context client = maa_client_connect(path);
+    ASSERT_TRUE(client != NULL);
+    ASSERT_EQ(maa_client_gpio_read(client, 0), MAAD_GPIO_READ);
+    ASSERT_EQ(maa_client_batch_begin(client), MAA_SUCCESS);
+    ASSERT_EQ(maa_client_gpio_dir(client, 0, MAA_GPIO_OUT), MAA_SUCCESS);
+    ASSERT_EQ(maa_client_gpio_write(client, 0, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_client_gpio_read(client, 0), MAAD_GPIO_READ);
+    ASSERT_EQ(maa_client_batch_flush(client), MAA_ERROR_INVALID_PARAMETER);
+
+    // a full batch goes out before the events request is appended
+    ASSERT_EQ(maa_client_batch_begin(client), MAA_SUCCESS);
+    for (int i = 0; i < MAAD_MAX_BATCH; i++)
+        ASSERT_EQ(maa_client_gpio_dir(client, 0, MAA_GPIO_OUT), MAA_SUCCESS);
+    // this daemon passes no ring
+    ASSERT_EQ(maa_client_gpio_isr(client, 0, MAA_GPIO_EDGE_BOTH), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_client_batch_flush(client), MAA_SUCCESS);
+    maa_client_close(client);
+    daemon.join();
+    close(listen_fd);
+    unlink(path);
+
+    ASSERT_EQ(counts.size(), 4u);
+    ASSERT_EQ(counts[0], 1u);
+    ASSERT_EQ(counts[1], 3u);
+    ASSERT_EQ(counts[2], (uint32_t) MAAD_MAX_BATCH);
+    ASSERT_EQ(counts[3], 1u);
+}
+
+TEST (ring, readers_keep_up_or_count_losses) {
+    maa_ring_context producer = maa_ring_create("/maa-test-ring", sizeof(uint32_t), 5);
+    ASSERT_TRUE(producer != NULL);
+    // a live ring is never replaced
+    errno = 0;
+    ASSERT_TRUE(maa_ring_create("/maa-test-ring", sizeof(uint32_t), 5) == NULL);
+    ASSERT_EQ(errno, EEXIST);
+    ASSERT_EQ(maa_ring_publish(producer, "\0\0\0\0"), MAA_SUCCESS);
+    maa_ring_context reader = maa_ring_attach("/maa-test-ring");
+    ASSERT_TRUE(reader != NULL);
+    ASSERT_EQ(maa_ring_publish(reader, "\0\0\0\0"), MAA_ERROR_INVALID_HANDLE);
+
+    // capacity rounds up to 8, the first record is still there
+    uint32_t i, records[16], seq = 99;
+    for (i = 1; i < 4; i++)
+        maa_ring_publish(producer, &i);
+    ASSERT_EQ(maa_ring_read(reader, records, 16, &seq), 4);
+    ASSERT_EQ(seq, 0u);
+    ASSERT_EQ(records[3], 3u);
+    ASSERT_EQ(maa_ring_read(reader, records, 16, &seq), 0);
+
+    for (i = 4; i < 24; i++)
+        maa_ring_publish(producer, &i);
+    ASSERT_EQ(maa_ring_read(reader, records, 16, &seq), 8);
+    ASSERT_EQ(seq, 16u);
+    ASSERT_EQ(records[0], 16u);
+    ASSERT_EQ(maa_ring_lost(reader), 12u);
+
+    maa_ring_close(reader);
+    maa_ring_close(producer);
+    ASSERT_TRUE(maa_ring_attach("/maa-test-ring") == NULL);
+}
+
+TEST (ring, attach_rejects_bad_headers) {
+    maa_ring_context producer = maa_ring_create("/maa-test-bad", sizeof(uint32_t), 8);
+    ASSERT_TRUE(producer != NULL);
+    int fd = shm_open("/maa-test-bad", O_RDWR, 0);
+    ASSERT_GE(fd, 0);
+    // magic, record_size, capacity, stride
+    uint32_t* hdr = (uint32_t*) mmap(NULL, 64, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ASSERT_TRUE(hdr != MAP_FAILED);
+    const uint32_t good[4] = { hdr[0], hdr[1], hdr[2], hdr[3] };
+    const struct { int field; uint32_t value; } bad[] = {
+        { 2, 0 }, { 2, 6 }, { 1, 0 }, { 1, good[3] }, { 3, good[3] - 2 }
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        memcpy(hdr, good, sizeof(good));
+        hdr[bad[i].field] = bad[i].value;
+        EXPECT_TRUE(maa_ring_attach("/maa-test-bad") == NULL) << "case " << i;
+    }
+    memcpy(hdr, good, sizeof(good));
+    maa_ring_context reader = maa_ring_attach("/maa-test-bad");
+    ASSERT_TRUE(reader != NULL);
+    maa_ring_close(reader);
+    munmap(hdr, 64);
+    maa_ring_close(producer);
+}
+
+TEST (aio, export_flags_failed_reads) {
+    SimRoot sim;
+    maa_aio_context dev = maa_aio_init(0);
+    ASSERT_TRUE(dev != NULL);
+    maa_ring_context producer = maa_ring_create("/maa-test-aio", sizeof(maa_aio_sample_t), 64);
+    ASSERT_TRUE(producer != NULL);
+    maa_ring_context reader = maa_ring_attach("/maa-test-aio");
+    ASSERT_TRUE(reader != NULL);
+    ASSERT_EQ(maa_aio_export(dev, producer, 0), MAA_ERROR_INVALID_PARAMETER);
+
+    ASSERT_EQ(maa_aio_export(dev, producer, 1000), MAA_SUCCESS);
+    maa_aio_sample_t samples[64];
+    int n = 0;
+    for (int i = 0; i < 200 && n == 0; i++) {
+        usleep(1000);
+        n = maa_ring_read(reader, samples, 64, NULL);
+    }
+    ASSERT_GT(n, 0);
+    ASSERT_EQ(samples[0].failed, 0);
+
+    // an empty file reads as a failure rather than as 0 V
+    writeFile(sim.root + "/sys/bus/iio/devices/iio:device0/in_voltage0_raw", "");
+    usleep(5000);
+    n = maa_ring_read(reader, samples, 64, NULL);
+    ASSERT_EQ(maa_aio_export_stop(dev), MAA_SUCCESS);
+    n += maa_ring_read(reader, samples + n, 64 - n, NULL);
+    ASSERT_GT(n, 0);
+    ASSERT_NE(samples[n - 1].failed, 0);
+
+    maa_ring_close(reader);
+    maa_ring_close(producer);
+    maa_aio_close(dev);
+}
+
+TEST (stats, counts_operations) {
+    maa_stats_reset();
+    {
+        MAA_STATS_BEGIN(off);
+        ASSERT_LT(off.tv_nsec, 0);
+    }
+
+    ASSERT_EQ(maa_stats_enable(1), MAA_SUCCESS);
+    for (int i = 0; i < 10; i++) {
+        MAA_STATS_BEGIN(start);
+        MAA_STATS_SYSCALL(2);
+        MAA_STATS_END(start, MAA_STATS_I2C_WRITE, 4, i == 0);
+    }
+    maa_stats_enable(0);
+
+    maa_stats_t stats;
+    ASSERT_EQ(maa_stats_get(MAA_STATS_OPS, &stats), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_stats_get(MAA_STATS_I2C_WRITE, &stats), MAA_SUCCESS);
+    ASSERT_EQ(stats.ops, 10u);
+    ASSERT_EQ(stats.syscalls, 20u);
+    ASSERT_EQ(stats.bytes, 40u);
+    ASSERT_EQ(stats.errors, 1u);
+    uint64_t total = 0;
+    for (int i = 0; i < MAA_STATS_BUCKETS; i++)
+        total += stats.histogram[i];
+    ASSERT_EQ(total, 10u);
+    ASSERT_LE(stats.max_ns, stats.total_ns);
+
+    char report[1024] = "";
+    FILE* out = fmemopen(report, sizeof(report), "w");
+    ASSERT_EQ(maa_stats_dump(out), MAA_SUCCESS);
+    fclose(out);
+    ASSERT_TRUE(strstr(report, "i2c_write") != NULL);
+    ASSERT_TRUE(strstr(report, "gpio_read") == NULL);
+    maa_stats_reset();
+}
+
+static uint64_t
+statsSyscalls(maa_stats_op_t op)
+{
+    maa_stats_t stats;
+    return maa_stats_get(op, &stats) == MAA_SUCCESS ? stats.syscalls : 0;
+}
+
+TEST (stats, counts_issued_syscalls) {
+    SimRoot sim;
+    maa_gpio_context gpio = maa_gpio_init_raw(42);
+    ASSERT_TRUE(gpio != NULL);
+    maa_pwm_context pwm = maa_pwm_init_raw(0, 1);
+    ASSERT_TRUE(pwm != NULL);
+    maa_stats_reset();
+    ASSERT_EQ(maa_stats_enable(1), MAA_SUCCESS);
+
+    // open, read and rewind, then seek, read and rewind
+    ASSERT_GE(maa_gpio_read(gpio), 0);
+    ASSERT_EQ(statsSyscalls(MAA_STATS_GPIO_READ), 3u);
+    ASSERT_GE(maa_gpio_read(gpio), 0);
+    ASSERT_EQ(statsSyscalls(MAA_STATS_GPIO_READ), 6u);
+    // a failed read stops after the read
+    writeFile(sim.gpio(42, "value"), "");
+    ASSERT_EQ(maa_gpio_read(gpio), -1);
+    ASSERT_EQ(statsSyscalls(MAA_STATS_GPIO_READ), 8u);
+
+    // period open, two seeks, read and close, then the duty cycle write
+    ASSERT_EQ(maa_pwm_write(pwm, 0.5f), MAA_SUCCESS);
+    ASSERT_EQ(statsSyscalls(MAA_STATS_PWM_WRITE), 6u);
+    std::string period = sim.root + "/sys/class/pwm/pwmchip0/pwm1/period";
+    unlink(period.c_str());
+    maa_pwm_write(pwm, 0.5f);
+    ASSERT_EQ(statsSyscalls(MAA_STATS_PWM_WRITE), 8u);
+
+    maa_stats_enable(0);
+    maa_stats_reset();
+    maa_pwm_close(pwm);
+    maa_gpio_close(gpio);
+}
+
+TEST (trace, chrome_json) {
+    ASSERT_EQ(maa_trace_start(0), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_trace_start(4), MAA_SUCCESS);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < 6; i++) {
+        MAA_STATS_BEGIN(op);
+        MAA_STATS_END(op, MAA_STATS_SPI_TRANSFER, 1, 0);
+    }
+    maa_trace_isr(7);
+    ASSERT_EQ(maa_trace_span("work", &start), MAA_SUCCESS);
+    maa_trace_stop();
+    ASSERT_EQ(maa_trace_mark("ignored"), MAA_SUCCESS);
+
+    char json[4096] = "";
+    FILE* out = fmemopen(json, sizeof(json), "w");
+    ASSERT_EQ(maa_trace_dump(out), MAA_SUCCESS);
+    fclose(out);
+
+    // the ring kept the last four events
+    ASSERT_EQ(strncmp(json, "{\"traceEvents\":[", 16), 0);
+    int spans = 0;
+    for (char* p = json; (p = strstr(p, "\"spi_transfer\"")) != NULL; p++)
+        spans++;
+    ASSERT_EQ(spans, 2);
+    ASSERT_TRUE(strstr(json, "\"args\":{\"pin\":7}") != NULL);
+    ASSERT_TRUE(strstr(json, "\"name\":\"work\",\"cat\":\"maa\",\"ph\":\"X\"") != NULL);
+    ASSERT_TRUE(strstr(json, "ignored") == NULL);
+}
+
+TEST (trace, names_copied_and_escaped) {
+    ASSERT_EQ(maa_trace_start(8), MAA_SUCCESS);
+    char name[64] = "say \"hi\"\n";
+    ASSERT_EQ(maa_trace_mark(name), MAA_SUCCESS);
+    memset(name, 'x', sizeof(name) - 1);
+    ASSERT_EQ(maa_trace_mark(name), MAA_SUCCESS);
+    strcpy(name, "gone");
+    maa_trace_stop();
+
+    char json[4096] = "";
+    FILE* out = fmemopen(json, sizeof(json), "w");
+    ASSERT_EQ(maa_trace_dump(out), MAA_SUCCESS);
+    fclose(out);
+    ASSERT_TRUE(strstr(json, "\"name\":\"say \\\"hi\\\"\\u000a\"") != NULL);
+    ASSERT_TRUE(strstr(json, ("\"name\":\"" + std::string(31, 'x') + "\"").c_str()) != NULL);
+    ASSERT_TRUE(strstr(json, "gone") == NULL);
+}
+
+TEST (trace, restart_while_recording) {
+    ASSERT_EQ(maa_trace_start(16), MAA_SUCCESS);
+    volatile bool done = false;
+    std::thread recorder([&]() {
+        while (!done)
+            maa_trace_mark("tick");
+    });
+    // each restart swaps and frees the buffer the recorder writes into
+    for (unsigned int i = 0; i < 200; i++)
+        ASSERT_EQ(maa_trace_start(4 + (i % 3) * 60), MAA_SUCCESS);
+    done = true;
+    recorder.join();
+    maa_trace_stop();
+}
+
+static std::vector<std::string> logged;
+
+static void
+collect(maa_log_level_t level, const char* message, void* user)
+{
+    logged.push_back(message);
+}
+
+TEST (log, last_error_and_rate_limit) {
+    maa_clear_error();
+    ASSERT_EQ(maa_last_error()->code, MAA_SUCCESS);
+    maa_log_set_sink(collect, NULL);
+
+    errno = ENODEV;
+    ASSERT_EQ(MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "pin %d", 3), MAA_ERROR_INVALID_RESOURCE);
+    const maa_error_t* err = maa_last_error();
+    ASSERT_EQ(err->code, MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(err->sys_errno, ENODEV);
+    ASSERT_STREQ(err->message, "pin %d");
+    ASSERT_EQ(logged.back(), "pin 3");
+
+    // the record is per thread
+    std::thread other([]() { ASSERT_EQ(maa_last_error()->code, MAA_SUCCESS); });
+    other.join();
+
+    maa_log_set_level(MAA_LOG_WARNING);
+    maa_log(MAA_LOG_INFO, "dropped by level");
+    ASSERT_EQ(logged.back(), "pin 3");
+
+    // a burst can straddle a second boundary, so two windows at most
+    logged.clear();
+    maa_log_set_rate(2);
+    for (int i = 0; i < 20; i++)
+        MAA_FAIL(MAA_ERROR_INVALID_RESOURCE, "burst");
+    ASSERT_LE(logged.size(), 4u);
+
+    maa_log_set_rate(10);
+    maa_log_set_level(MAA_LOG_ERROR);
+    maa_log_set_sink(NULL, NULL);
+    maa_clear_error();
+}
+
+TEST (sysfs, root_prefix) {
+    // MAA_SYSFS_ROOT may have set one already
+    std::string prev = maa_sysfs_root();
+    ASSERT_EQ(maa_set_sysfs_root("/tmp/sim/"), MAA_SUCCESS);
+    ASSERT_STREQ(maa_sysfs_root(), "/tmp/sim");
+    ASSERT_EQ(maa_set_sysfs_root(std::string(100, 'x').c_str()), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_STREQ(maa_sysfs_root(), "/tmp/sim");
+    ASSERT_EQ(maa_set_sysfs_root(NULL), MAA_SUCCESS);
+    ASSERT_STREQ(maa_sysfs_root(), "");
+    ASSERT_EQ(maa_set_sysfs_root(prev.c_str()), MAA_SUCCESS);
+    ASSERT_STREQ(maa_sysfs_root(), prev.c_str());
+}
+
+TEST (loopback, simulated_wire) {
+    maa_loopback_result_t result;
+    ASSERT_EQ(maa_gpio_loopback_sim(2, MAA_GPIO_ISR_SYSFS, 0, 0, &result), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_gpio_loopback(NULL, NULL, MAA_GPIO_ISR_SYSFS, 10, 0, &result), MAA_ERROR_INVALID_HANDLE);
+
+    SimRoot sim;
+    std::string uio = sim.root + "/dev/uio0";
+    for (int mode = MAA_GPIO_ISR_SYSFS; mode <= MAA_GPIO_ISR_BUSY_POLL; mode++) {
+        ASSERT_EQ(maa_gpio_loopback_sim(2, (gpio_isr_mode_t) mode, 50, 0, &result), MAA_SUCCESS);
+        // edges can only be lost to a 100ms timeout
+        ASSERT_EQ(result.samples + result.missed, 50u);
+        ASSERT_GT(result.samples, 45u);
+        ASSERT_EQ(result.bucket_ns, 1000u);
+        ASSERT_LE(result.min_ns, result.p50_ns);
+        ASSERT_LE(result.p50_ns, result.p99_ns);
+        ASSERT_LE(result.p999_ns, result.max_ns);
+        uint32_t total = 0;
+        for (int i = 0; i < MAA_LOOPBACK_BUCKETS; i++)
+            total += result.histogram[i];
+        ASSERT_EQ(total, result.samples);
+
+        // the replaced files are back
+        struct stat st;
+        ASSERT_EQ(stat(sim.gpio(32, "value").c_str(), &st), 0);
+        ASSERT_TRUE(S_ISREG(st.st_mode));
+        ASSERT_EQ(stat(uio.c_str(), &st), 0);
+        ASSERT_TRUE(S_ISREG(st.st_mode));
+    }
+}
+
+TEST (loopback, restores_mmap_of_the_input) {
+    SimRoot sim;
+    maa_gpio_context out = maa_gpio_init(3);
+    ASSERT_TRUE(out != NULL);
+    maa_gpio_context in = maa_gpio_init(2);
+    ASSERT_TRUE(in != NULL);
+    maa_loopback_result_t result;
+    maa_gpio_fast_t fast;
+
+    // nothing drives the input here, the one sample times out
+    ASSERT_EQ(maa_gpio_loopback(out, in, MAA_GPIO_ISR_BUSY_POLL, 1, 0, &result), MAA_SUCCESS);
+    ASSERT_EQ(result.missed, 1u);
+    ASSERT_EQ(maa_gpio_get_fast(in, &fast), MAA_ERROR_INVALID_RESOURCE);
+
+    ASSERT_EQ(maa_gpio_use_mmaped(in, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_loopback(out, in, MAA_GPIO_ISR_BUSY_POLL, 1, 0, &result), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_get_fast(in, &fast), MAA_SUCCESS);
+
+    ASSERT_EQ(maa_gpio_close(in), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_close(out), MAA_SUCCESS);
+}
+
+TEST (pool, contexts_without_heap) {
+    SimRoot sim;
+    maa_pool_config_t config = {};
+    config.count[MAA_POOL_I2C] = 2;
+    config.count[MAA_POOL_GPIO] = 1;
+    ASSERT_EQ(maa_pool_init(NULL), MAA_ERROR_INVALID_PARAMETER);
+    ASSERT_EQ(maa_pool_init(&config), MAA_SUCCESS);
+    ASSERT_EQ(maa_pool_init(&config), MAA_ERROR_INVALID_RESOURCE);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_I2C), 2u);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_GPIO), 1u);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_SPI), 0u);
+
+    maa_i2c_context a = maa_i2c_init_raw(0);
+    maa_i2c_context b = maa_i2c_init_raw(0);
+    ASSERT_TRUE(a != NULL && b != NULL && a != b);
+    ASSERT_EQ((uintptr_t) a % 64, 0u);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_I2C), 0u);
+    ASSERT_TRUE(maa_i2c_init_raw(0) == NULL);
+    ASSERT_EQ(maa_last_error()->code, MAA_ERROR_NO_RESOURCES);
+    ASSERT_EQ(maa_pool_release(), MAA_ERROR_INVALID_RESOURCE);
+
+    // a closed context goes back to the pool and is handed out again
+    maa_i2c_stop(b);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_I2C), 1u);
+    ASSERT_TRUE(maa_i2c_init_raw(0) == b);
+    maa_i2c_stop(b);
+    maa_i2c_stop(a);
+
+    // IO2 sets a mux line, the library's context on it is not the pool's
+    maa_gpio_context io2 = maa_gpio_init(2);
+    ASSERT_TRUE(io2 != NULL);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_GPIO), 0u);
+    ASSERT_TRUE(maa_gpio_init(3) == NULL);
+    ASSERT_EQ(maa_last_error()->code, MAA_ERROR_NO_RESOURCES);
+    ASSERT_EQ(maa_gpio_close(io2), MAA_SUCCESS);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_GPIO), 1u);
+    io2 = maa_gpio_init(2);
+    ASSERT_TRUE(io2 != NULL);
+    ASSERT_EQ(maa_gpio_close(io2), MAA_SUCCESS);
+
+    // the mux line contexts stay open and do not hold the pool
+    ASSERT_EQ(maa_pool_release(), MAA_SUCCESS);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_I2C), 0u);
+    maa_i2c_stop(maa_i2c_init_raw(0));
+}
+
+TEST (pool, pwm_setup_without_gpio_contexts) {
+    SimRoot sim;
+    maa_pool_config_t config = {};
+    config.count[MAA_POOL_PWM] = 1;
+    ASSERT_EQ(maa_pool_init(&config), MAA_SUCCESS);
+
+    // IO3 drives its gpio during setup, that context is the library's
+    maa_pwm_context pwm = maa_pwm_init(3);
+    ASSERT_TRUE(pwm != NULL);
+    ASSERT_EQ(maa_pool_available(MAA_POOL_PWM), 0u);
+    ASSERT_EQ(maa_pwm_close(pwm), MAA_SUCCESS);
+    ASSERT_EQ(maa_pool_release(), MAA_SUCCESS);
+}
+
+TEST (registry, pin_claims) {
+    maa_pinmodes_t mode;
+    ASSERT_EQ(maa_pin_claims(-1, &mode), -1);
+    ASSERT_EQ(maa_pin_claims(10, &mode), 0);
+
+    ASSERT_EQ(maa_claim_pin(10, MAA_PIN_SPI), MAA_SUCCESS);
+    ASSERT_EQ(maa_claim_pin(10, MAA_PIN_SPI), MAA_SUCCESS);
+    ASSERT_EQ(maa_claim_pin(10, MAA_PIN_GPIO), MAA_ERROR_NO_RESOURCES);
+    ASSERT_EQ(maa_pin_claims(10, &mode), 2);
+    ASSERT_EQ(mode, MAA_PIN_SPI);
+
+    maa_release_pin(10);
+    maa_release_pin(10);
+    ASSERT_EQ(maa_pin_claims(10, &mode), 0);
+    ASSERT_EQ(maa_claim_pin(10, MAA_PIN_GPIO), MAA_SUCCESS);
+    maa_release_pin(10);
+}
+
+TEST (registry, repeated_init_reuses_mux_lines) {
+    SimRoot sim;
+    maa_gpio_context first = maa_gpio_init(2);
+    ASSERT_TRUE(first != NULL);
+    // setting the mux line up again would overwrite this
+    writeFile(sim.gpio(31, "value"), "x");
+    maa_gpio_context second = maa_gpio_init(2);
+    ASSERT_TRUE(second != NULL);
+    ASSERT_EQ(readFile(sim.gpio(31, "value")), "x");
+
+    // each init still gets a context of its own
+    ASSERT_NE(first, second);
+    maa_pinmodes_t mode;
+    ASSERT_EQ(maa_pin_claims(2, &mode), 2);
+    ASSERT_EQ(maa_gpio_close(first), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_write(second, 1), MAA_SUCCESS);
+    ASSERT_EQ(maa_gpio_close(second), MAA_SUCCESS);
+    ASSERT_EQ(maa_pin_claims(2, &mode), 0);
+}
+
+/**
+ * Mode of a segment created by a child with MAA_SHM_MODE set to mode, or
+ * left unset for NULL. -1 when the child failed to attach.
+ */
+static int
+shmCreateMode(const char* name, const char* mode)
+{
+    pid_t child = fork();
+    if (child == 0) {
+        if (mode != NULL)
+            setenv("MAA_SHM_MODE", mode, 1);
+        else
+            unsetenv("MAA_SHM_MODE");
+        umask(022);
+        _exit(maa_shm_attach(name) == MAA_SUCCESS ? 0 : 1);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    if (WEXITSTATUS(status) != 0)
+        return -1;
+    struct stat st;
+    int fd = shm_open(name, O_RDONLY, 0);
+    int ret = (fd >= 0 && fstat(fd, &st) == 0) ? (int) (st.st_mode & 0777) : -1;
+    if (fd >= 0)
+        close(fd);
+    shm_unlink(name);
+    return ret;
+}
+
+TEST (registry, shared_segment_mode) {
+    char name[32];
+    snprintf(name, sizeof(name), "/maa_mode_%d", (int) getpid());
+    ASSERT_EQ(shmCreateMode(name, NULL), 0660);
+    ASSERT_EQ(shmCreateMode(name, "0600"), 0600);
+    ASSERT_EQ(shmCreateMode(name, "0999"), -1);
+}
+
+// attaches for the rest of the run, keep it last
+TEST (registry, shared_between_processes) {
+    SimRoot sim;
+    char name[32];
+    snprintf(name, sizeof(name), "/maa_test_%d", (int) getpid());
+    ASSERT_EQ(maa_shm_attach(name), MAA_SUCCESS);
+    shm_unlink(name);
+    ASSERT_TRUE(maa_shm_get() != NULL);
+
+    int ready[2], done[2];
+    ASSERT_EQ(pipe(ready), 0);
+    ASSERT_EQ(pipe(done), 0);
+    pid_t child = fork();
+    if (child == 0) {
+        // a claim and a level left by another process
+        char c = maa_claim_pin(11, MAA_PIN_PWM) == MAA_SUCCESS ? 0 : 1;
+        maa_gpio_context dev = maa_gpio_init_raw(40);
+        if (dev == NULL || maa_gpio_shadow(dev, 1) != MAA_SUCCESS || maa_gpio_write(dev, 1) != MAA_SUCCESS)
+            c = 1;
+        if (write(ready[1], &c, 1) != 1 || read(done[0], &c, 1) != 1)
+            _exit(1);
+        _exit(0);
+    }
+    char c = 1;
+    ASSERT_EQ(read(ready[0], &c, 1), 1);
+    ASSERT_EQ(c, 0);
+
+    maa_pinmodes_t mode;
+    ASSERT_EQ(maa_pin_claims(11, &mode), 1);
+    ASSERT_EQ(mode, MAA_PIN_PWM);
+    ASSERT_EQ(maa_claim_pin(11, MAA_PIN_GPIO), MAA_ERROR_NO_RESOURCES);
+    // only the process that made a claim can release it
+    ASSERT_EQ(maa_release_pin(11), 1);
+    ASSERT_EQ(maa_shm_gpio_shadow(40)->value, 1);
+
+    // once the owner has exited what it left is reaped
+    ASSERT_EQ(write(done[1], &c, 1), 1);
+    int status;
+    waitpid(child, &status, 0);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    close(ready[0]);
+    close(ready[1]);
+    close(done[0]);
+    close(done[1]);
+
+    ASSERT_EQ(maa_pin_claims(11, &mode), 0);
+    ASSERT_EQ(maa_shm_gpio_shadow(40)->value, -1);
+    ASSERT_EQ(maa_claim_pin(11, MAA_PIN_GPIO), MAA_SUCCESS);
+    ASSERT_EQ(maa_release_pin(11), 0);
+
+    // a transfer waits for a transaction of another process on its bus
+    maa_i2c_context i2c = maa_i2c_init_raw(0);
+    ASSERT_TRUE(i2c != NULL);
+    ASSERT_EQ(pipe(ready), 0);
+    ASSERT_EQ(pipe(done), 0);
+    child = fork();
+    if (child == 0) {
+        maa_i2c_lock(i2c);
+        if (write(ready[1], &c, 1) != 1 || read(done[0], &c, 1) != 1)
+            _exit(1);
+        maa_i2c_unlock(i2c);
+        _exit(0);
+    }
+    ASSERT_EQ(read(ready[0], &c, 1), 1);
+    volatile bool transferred = false;
+    std::thread reader([&] {
+        uint8_t data[2];
+        transferred = maa_i2c_read(i2c, data, sizeof(data)) == (int) sizeof(data);
+    });
+    usleep(50000);
+    EXPECT_FALSE(transferred);
+    ASSERT_EQ(write(done[1], &c, 1), 1);
+    reader.join();
+    EXPECT_TRUE(transferred);
+    waitpid(child, &status, 0);
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    close(ready[0]);
+    close(ready[1]);
+    close(done[0]);
+    close(done[1]);
+
+    // and nests inside a transaction of our own
+    uint8_t data[2];
+    ASSERT_EQ(maa_i2c_lock(i2c), MAA_SUCCESS);
+    ASSERT_EQ(maa_i2c_read(i2c, data, sizeof(data)), (int) sizeof(data));
+    ASSERT_EQ(maa_i2c_unlock(i2c), MAA_SUCCESS);
+    ASSERT_EQ(maa_i2c_stop(i2c), MAA_SUCCESS);
+}